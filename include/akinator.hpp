@@ -2,8 +2,13 @@
 #define AKINATOR_HPP_
 
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "tree.hpp"
+#include "akinator_history.hpp"
+#include "name_index.hpp"
+#include "radix_trie.hpp"
 
 #define MAX_NAME_LEN 128
 #define MAX_ATTRIBUTE_LEN 128
@@ -12,6 +17,9 @@
 #define MAX_ANSWER_LEN 8
 #define MAX_FILE_NAME_LEN 256
 #define MAX_PRINT_COMMAND_SIZE 256
+#define MAX_COMPLETION_COUNT 3
+/// Глубже отступ в текстовой базе не растет, иначе размер файла длинной цепочки квадратичен по глубине
+#define MAX_INDENT_DEPTH 16
 
 static const char* AKINATOR_STD_DATABASE_FILE_NAME = "database.aki";
 static const char AKINATOR_VOID_DATABASE[] = "{\n\tничего\n\t{nil}\n\t{nil}\n}\n";
@@ -21,7 +29,55 @@ enum AkinatorError {
     AKINATOR_TREE_ERROR                 =  1,
     AKINATOR_NODE_ALLOC_ERROR           =  2,
     AKINATOR_DATABASE_FILE_CREATE_ERROR =  3,
-    AKINATOR_DATABASE_FILE_OPEN_ERROR   =  4
+    AKINATOR_DATABASE_FILE_OPEN_ERROR   =  4,
+    AKINATOR_NAME_INDEX_ERROR           =  5,
+    AKINATOR_RADIX_TRIE_ERROR           =  6,
+    AKINATOR_DATABASE_PARSE_ERROR       =  7,
+    AKINATOR_RELOAD_ERROR               =  8,
+    AKINATOR_MERGE_ERROR                =  9,
+    AKINATOR_HISTORY_ERROR              = 10,
+    AKINATOR_SHARD_ERROR                = 11,
+    AKINATOR_EMBEDDED_ERROR             = 12,
+    AKINATOR_BENCH_ERROR                = 13,
+    AKINATOR_EVAL_ERROR                 = 14,
+    AKINATOR_SIMILARITY_ERROR           = 15,
+    AKINATOR_SESSION_ERROR              = 16,
+    AKINATOR_SIMILARITY_CHECK_ERROR     = 17
+};
+
+enum AkinatorDatabaseFormat {
+    AKINATOR_FORMAT_TEXT       =  0,
+    AKINATOR_FORMAT_JSON       =  1,
+    AKINATOR_FORMAT_JSON_LINES =  2,
+    AKINATOR_FORMAT_COMPRESSED =  3,
+    AKINATOR_FORMAT_MANIFEST   =  4
+};
+
+struct AkinatorLazy;
+struct AkinatorShards;
+
+struct Akinator {
+    Tree tree;
+
+    NameIndex name_index;
+
+    RadixTrie value_trie;
+
+    AkinatorHistory history;
+
+    /// Не NULL, пока база читается по требованию (см. akinator_lazy.hpp)
+    AkinatorLazy* lazy;
+
+    /// Не NULL, если база собрана из шардов по манифесту (см. akinator_shards.hpp)
+    AkinatorShards* shards;
+
+    /// Индексы еще не построены: встроенная база стартует без них (см. akinator_embedded.hpp)
+    bool is_index_pending;
+
+    /// Файл, с которым дерево совпадало при последней загрузке или сохранении
+    char synced_file_name[MAX_FILE_NAME_LEN + 1];
+    uint64_t synced_hash;
+    struct timespec synced_mtime;
 };
 
 const char* AkinatorStrError(AkinatorError error);
@@ -30,19 +86,63 @@ void AkinatorPrintError(AkinatorError error, const char* file, int line);
 
 #define AKINATOR_PRINT_ERROR(error) AkinatorPrintError(error, __FILE__, __LINE__)
 
-AkinatorError AkinatorTreeInit(Tree* akinator_tree);
+AkinatorError AkinatorTreeInit(Akinator* akinator);
+
+AkinatorError AkinatorTreeDestroy(Akinator* akinator);
+
+/// Строит индекс имен и префиксное дерево значений, если их построение было отложено
+AkinatorError AkinatorEnsureIndexes(Akinator* akinator);
+
+AkinatorError AkinatorRequest(Akinator* akinator);
+
+/// Формат выбирается по расширению: .json, .jsonl, .akz, манифест шардов .akm, иначе текстовый формат .aki
+AkinatorDatabaseFormat AkinatorGetDatabaseFormat(const char* database_file_name);
+
+/// Пропускает запись, если файл не менялся с последней загрузки или сохранения и хеш корня тот же
+AkinatorError AkinatorTreeSaveFile(Akinator* akinator, const char* database_file_name);
+
+/// true, если файл уже содержит ровно это дерево
+bool AkinatorIsFileUpToDate(Akinator* akinator, const char* database_file_name);
+
+AkinatorError AkinatorTreeSave(Akinator* akinator);
+
+/// Разбирает файл в дерево tree без хешей и индексов; манифест шардов так не читается
+AkinatorError AkinatorTreeReadFile(Tree* tree, const char* database_file_name);
+
+/// Разбирает файл в только что инициализированный akinator и строит индексы, ничего не спрашивая у пользователя
+AkinatorError AkinatorTreeLoadFile(Akinator* akinator, const char* database_file_name);
+
+void AkinatorAskDatabaseFileName(char database_file_name[MAX_FILE_NAME_LEN + 1]);
+
+/// Загружает базу во второе дерево и заменяет им текущее только при успехе, имя файла записывается в database_file_name.
+/// С is_lazy текстовая база не читается целиком, а вершины создаются по мере того, как до них доходит игра или поиск
+AkinatorError AkinatorTreeLoad(Akinator* akinator, bool is_fast_load, bool is_lazy, char database_file_name[MAX_FILE_NAME_LEN + 1]);
+
+/// Шаг игры после ответа на вопрос node: "да" ведет в правое поддерево, любой другой ответ - в левое
+TreeNode* AkinatorNextNode(TreeNode* node, bool is_yes);
+
+/// Выделяет в *ans_list строку ответов ('n' - нет, 'y' - да) на пути от first_node до leaf длиной во всю глубину листа,
+/// поднимаясь по родителям; строку освобождает вызывающий
+AkinatorError AkinatorGetAnswerList(TreeNode* first_node, TreeNode* leaf, char** ans_list, size_t* ans_list_len);
+
+/// Возвращает лист с точно таким именем, иначе ближайший по триграммам или NULL, если похожих нет
+TreeNode* AkinatorResolveName(Akinator* akinator, const char* name);
 
-AkinatorError AkinatorTreeDestroy(Tree* akinator_tree);
+AkinatorError AkinatorFind(Akinator* akinator);
 
-AkinatorError AkinatorRequest(Tree* akinator_tree);
+AkinatorError AkinatorCompare(Akinator* akinator);
 
-AkinatorError AkinatorTreeSave(Tree* akinator_tree);
+/// Отменяет последний шаг обучения
+AkinatorError AkinatorUndo(Akinator* akinator);
 
-AkinatorError AkinatorTreeLoad(Tree* akinator_tree, bool is_fast_load, char database_file_name[MAX_FILE_NAME_LEN + 1]);
+/// Повторяет последний отмененный шаг обучения
+AkinatorError AkinatorRedo(Akinator* akinator);
 
-AkinatorError AkinatorFind(Tree* akinator_tree);
+/// Спрашивает имя и запоминает под ним текущее состояние дерева
+AkinatorError AkinatorSnapshotSave(Akinator* akinator);
 
-AkinatorError AkinatorCompare(Tree* akinator_tree);
+/// Спрашивает имя снимка и возвращает дерево в его состояние
+AkinatorError AkinatorSnapshotRestore(Akinator* akinator);
 
 AkinatorError AkinatorPrintf(const char* format, ...);
 
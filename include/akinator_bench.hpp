@@ -0,0 +1,34 @@
+#ifndef AKINATOR_BENCH_HPP_
+#define AKINATOR_BENCH_HPP_
+
+#include <stdint.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_BENCH_SAMPLE_COUNT = 1024;
+static const size_t AKINATOR_BENCH_MAX_DUMP_NODES = 1 << 15;
+static const size_t AKINATOR_BENCH_START_CAPACITY = 64;
+static const size_t AKINATOR_BENCH_BUFFER_SIZE = 1 << 20;
+static const uint64_t AKINATOR_BENCH_SEED = 0x2545F4914F6CDD1Dull;
+static const char AKINATOR_BENCH_SAVE_SUFFIX[] = ".bench.aki";
+
+/// Форма синтетической базы: поровну листьев в поддеревьях, цепочка (каждый вопрос отделяет один лист)
+/// или перекос, как у обученной базы: от 5% до 50% листьев в случайную сторону
+enum AkinatorBenchShape {
+    AKINATOR_BENCH_BALANCED = 0,
+    AKINATOR_BENCH_CHAIN    = 1,
+    AKINATOR_BENCH_SKEWED   = 2
+};
+
+/// "balanced", "chain" или "skewed"; false, если форма неизвестна
+bool AkinatorBenchParseShape(const char* shape_name, AkinatorBenchShape* shape);
+
+/// Пишет текстовую базу из leaf_count листьев без построения дерева в памяти; значения дополняются до value_len байт.
+/// Генератор детерминирован, поэтому одинаковые параметры дают одинаковый файл
+AkinatorError AkinatorBenchGenerate(const char* database_file_name, size_t leaf_count, AkinatorBenchShape shape, size_t value_len);
+
+/// Меряет загрузку, проверку, поиск, сравнение, спуск до листа, сохранение, дамп и удаление дерева;
+/// первые warmup_count повторов не учитываются, по остальным в csv_file_name дописываются минимум, медиана, среднее и максимум
+AkinatorError AkinatorBenchRun(const char* database_file_name, const char* csv_file_name, size_t repeat_count, size_t warmup_count);
+
+#endif // AKINATOR_BENCH_HPP_
@@ -0,0 +1,23 @@
+#ifndef AKINATOR_COMPRESSED_HPP_
+#define AKINATOR_COMPRESSED_HPP_
+
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const char AKINATOR_COMPRESSED_MAGIC[] = "AKZ1";
+static const size_t AKINATOR_COMPRESSED_MAGIC_LEN = sizeof(AKINATOR_COMPRESSED_MAGIC) - 1;
+static const size_t AKINATOR_COMPRESSED_MAX_VARINT_LEN = 10;
+static const size_t AKINATOR_COMPRESSED_START_CAPACITY = 64;
+
+/// Сжатый формат .akz, все числа - varint (по 7 бит, старший бит - продолжение):
+/// "AKZ1", число вершин, число строк;
+/// словарь уникальных строк в порядке strcmp с фронтальным кодированием: длина общего префикса с предыдущей, длина остатка, остаток;
+/// форма дерева: по 2 бита на вершину в прямом порядке обхода (есть левый ребенок, есть правый);
+/// номера строк словаря для вершин в том же порядке
+AkinatorError AkinatorCompressedSave(TreeNode* first_node, FILE* compressed_file);
+
+/// Строит дерево под корнем tree из файла .akz
+AkinatorError AkinatorCompressedLoad(Tree* tree, FILE* compressed_file);
+
+#endif // AKINATOR_COMPRESSED_HPP_
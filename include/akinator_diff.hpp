@@ -0,0 +1,22 @@
+#ifndef AKINATOR_DIFF_HPP_
+#define AKINATOR_DIFF_HPP_
+
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_DIFF_START_STACK_CAPACITY = 64;
+
+struct AkinatorDiffStats {
+    size_t changed_count;
+    size_t added_count;
+    size_t removed_count;
+
+    size_t visited_count;
+};
+
+/// Печатает отличия new_akinator от old_akinator, спускаясь только в поддеревья с разными хешами.
+/// Путь к вершине записывается ответами от первого вопроса: n - нет, y - да, "." - первый вопрос
+AkinatorError AkinatorDiff(Akinator* old_akinator, Akinator* new_akinator, FILE* stream, AkinatorDiffStats* stats);
+
+#endif // AKINATOR_DIFF_HPP_
@@ -0,0 +1,22 @@
+#ifndef AKINATOR_EMBEDDED_HPP_
+#define AKINATOR_EMBEDDED_HPP_
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_EMBEDDED_START_CAPACITY = 64;
+
+/// Таблица вершин из сгенерированного akinator_embedded_database.cpp (make embed); нулевая вершина - корень дерева.
+/// Строки заимствуют литералы, ссылки и хеши посчитаны генератором, поэтому таблица готова к игре без разбора и выделения памяти
+extern TreeNode akinator_embedded_nodes[];
+extern const size_t akinator_embedded_node_count;
+extern const char akinator_embedded_source_name[];
+
+/// Подставляет встроенную базу в akinator вместо AkinatorTreeInit и загрузки; индексы строятся при первом поиске или обучении.
+/// Таблица одна на процесс, поэтому использовать ее можно только один раз
+AkinatorError AkinatorEmbeddedLoad(Akinator* akinator);
+
+/// Пишет дерево akinator исходником C++ со статической таблицей вершин в порядке обхода в ширину.
+/// Размер массива указан явно: иначе GCC не считает адреса его элементов константами и инициализирует таблицу при запуске
+AkinatorError AkinatorEmbeddedGenerate(Akinator* akinator, const char* database_file_name, const char* source_file_name);
+
+#endif // AKINATOR_EMBEDDED_HPP_
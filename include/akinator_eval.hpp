@@ -0,0 +1,54 @@
+#ifndef AKINATOR_EVAL_HPP_
+#define AKINATOR_EVAL_HPP_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_EVAL_CHUNK_SIZE = 4096;
+static const size_t AKINATOR_EVAL_WORST_COUNT = 10;
+static const size_t AKINATOR_EVAL_START_CAPACITY = 64;
+static const uint64_t AKINATOR_EVAL_SEED = 0x9E3779B97F4A7C15ull;
+
+struct AkinatorEvalGame {
+    TreeNode* leaf;
+    size_t leaf_i;
+
+    size_t question_count;
+    bool is_guessed;
+};
+
+/// Итоги самоигры: по партии на каждый лист, оракул отвечает по истинному пути листа и ошибается с долей error_rate,
+/// а после первой ошибки, сойдя с пути, отвечает наугад;
+/// question_histogram[i] - число партий из i вопросов; партия угадана, если спуск закончился в загаданном листе
+struct AkinatorEvalResult {
+    double error_rate;
+
+    size_t game_count;
+    size_t guessed_count;
+    size_t questions_sum;
+    size_t max_questions;
+
+    size_t* question_histogram;
+    size_t histogram_size;
+
+    AkinatorEvalGame worst[AKINATOR_EVAL_WORST_COUNT];
+    size_t worst_count;
+
+    size_t thread_count;
+    uint64_t elapsed_ns;
+};
+
+/// Играет за каждый лист теми же шагами, что и AkinatorRequest, но без ввода и озвучки; листья раздаются потокам кусками.
+/// Ошибки оракула зависят только от номера листа, поэтому результат не зависит от числа потоков
+AkinatorError AkinatorEvalRun(Akinator* akinator, double error_rate, AkinatorEvalResult* result);
+
+AkinatorError AkinatorEvalDestroy(AkinatorEvalResult* result);
+
+/// Наименьшее число вопросов, которого хватает доле share партий (от 0 до 1)
+size_t AkinatorEvalPercentile(const AkinatorEvalResult* result, double share);
+
+void AkinatorEvalPrint(const AkinatorEvalResult* result, FILE* stream);
+
+#endif // AKINATOR_EVAL_HPP_
@@ -0,0 +1,76 @@
+#ifndef AKINATOR_HISTORY_HPP_
+#define AKINATOR_HISTORY_HPP_
+
+#include <stdlib.h>
+
+#include "tree.hpp"
+
+#define AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN 64
+
+static const size_t AKINATOR_HISTORY_START_CAPACITY = 16;
+
+enum AkinatorHistoryError {
+    AKINATOR_HISTORY_OK               =  0,
+    AKINATOR_HISTORY_ALLOC_ERROR      =  1,
+    AKINATOR_HISTORY_INDEX_ERROR      =  2,
+    AKINATOR_HISTORY_UNKNOWN_SNAPSHOT =  3
+};
+
+const char* AkinatorHistoryStrError(AkinatorHistoryError error);
+
+void AkinatorHistoryPrintError(AkinatorHistoryError error, const char* file, int line);
+
+#define AKINATOR_HISTORY_PRINT_ERROR(error) AkinatorHistoryPrintError(error, __FILE__, __LINE__)
+
+/// Один шаг обучения: лист old_answer заменен вопросом question, у которого слева old_answer, справа new_answer
+struct AkinatorHistoryStep {
+    TreeNode* question;
+    TreeNode* old_answer;
+    TreeNode* new_answer;
+};
+
+/// Именованный снимок - это просто число примененных шагов журнала
+struct AkinatorHistorySnapshot {
+    char name[1 + AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN];
+    size_t position;
+};
+
+/// Журнал обучения: шаги [0, position) применены к дереву, шаги [position, size) отменены
+/// и держат свои отцепленные вершины до повтора или до следующего обучения
+struct AkinatorHistory {
+    AkinatorHistoryStep* steps;
+    size_t size;
+    size_t position;
+    size_t capacity;
+
+    AkinatorHistorySnapshot* snapshots;
+    size_t snapshots_size;
+    size_t snapshots_capacity;
+};
+
+struct Akinator;
+
+AkinatorHistoryError AkinatorHistoryInit(AkinatorHistory* history);
+
+/// Освобождает журнал и вершины отмененных шагов; вершины примененных шагов принадлежат дереву
+AkinatorHistoryError AkinatorHistoryDestroy(AkinatorHistory* history);
+
+/// Запоминает уже выполненный шаг обучения и выбрасывает отмененные шаги вместе с их вершинами
+AkinatorHistoryError AkinatorHistoryRecord(AkinatorHistory* history, TreeNode* question, TreeNode* old_answer, TreeNode* new_answer);
+
+size_t AkinatorHistoryUndoCount(AkinatorHistory* history);
+
+size_t AkinatorHistoryRedoCount(AkinatorHistory* history);
+
+/// Возвращает старый лист на место вопроса: три перестановки указателей, пересчет хешей пути и правка индексов
+AkinatorHistoryError AkinatorHistoryUndo(Akinator* akinator);
+
+AkinatorHistoryError AkinatorHistoryRedo(Akinator* akinator);
+
+/// Запоминает текущее состояние под именем name, перезаписывая снимок с тем же именем
+AkinatorHistoryError AkinatorHistorySnapshotSave(AkinatorHistory* history, const char* name);
+
+/// Отменяет или повторяет шаги, пока дерево не придет в состояние снимка name
+AkinatorHistoryError AkinatorHistorySnapshotRestore(Akinator* akinator, const char* name);
+
+#endif // AKINATOR_HISTORY_HPP_
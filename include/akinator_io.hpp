@@ -0,0 +1,86 @@
+#ifndef AKINATOR_IO_HPP_
+#define AKINATOR_IO_HPP_
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_IO_MAX_VALUE_LEN = MAX_FILE_NAME_LEN;
+static const size_t AKINATOR_IO_MAX_INT_LEN = 32;
+static const size_t AKINATOR_IO_MAX_EVENT_LINE_LEN = AKINATOR_IO_MAX_VALUE_LEN + 128;
+static const size_t AKINATOR_IO_START_CAPACITY = 64;
+static const size_t AKINATOR_IO_MAX_PRINT_VALUE_LEN = 24;
+static const uint64_t AKINATOR_IO_HASH_OFFSET = 0xcbf29ce484222325ull;
+static const uint64_t AKINATOR_IO_HASH_PRIME = 0x100000001b3ull;
+
+enum AkinatorIoMode {
+    AKINATOR_IO_LIVE   = 0,
+    AKINATOR_IO_RECORD = 1,
+    AKINATOR_IO_REPLAY = 2
+};
+
+/// Вид чтения повторяет шаблон scanf, которым раньше читался ввод; значение - буква в файле сессии
+enum AkinatorIoReadKind {
+    /// "%s"
+    AKINATOR_IO_WORD     = 'w',
+    /// "\n%[^\n]"
+    AKINATOR_IO_LINE     = 'l',
+    /// "%[^\n]"
+    AKINATOR_IO_RAW_LINE = 'r',
+    /// "%d" и остаток строки
+    AKINATOR_IO_INT      = 'i',
+    /// Конец сессии: работа и вывод после последнего чтения
+    AKINATOR_IO_END      = 'e'
+};
+
+/// Одно чтение сессии; work_ns и output_hash относятся к шагу перед ним - от прошлого чтения до этого
+struct AkinatorIoEvent {
+    AkinatorIoReadKind kind;
+    bool is_read;
+
+    /// Сколько пользователь думал над ответом
+    uint64_t wait_ns;
+    uint64_t work_ns;
+    /// FNV-1a всего напечатанного за шаг
+    uint64_t output_hash;
+
+    char value[1 + AKINATOR_IO_MAX_VALUE_LEN];
+};
+
+/// Шаг воспроизведения, сверяемый с записанным событием с тем же номером
+struct AkinatorIoStep {
+    uint64_t work_ns;
+    bool is_output_same;
+};
+
+/// Дальше каждое чтение ввода пишется в session_file_name вместе с ожиданием, временем работы и хешем вывода
+AkinatorError AkinatorIoRecordStart(const char* session_file_name);
+
+/// Дальше ввод берется из записанной сессии, озвучка отключается; с is_paced между вводами выдерживаются
+/// записанные паузы, иначе сессия проигрывается с полной скоростью
+AkinatorError AkinatorIoReplayStart(const char* session_file_name, bool is_paced);
+
+/// Закрывает запись или печатает в report_stream задержки шагов воспроизведения;
+/// возвращает AKINATOR_SESSION_ERROR, если вывод или порядок чтений разошелся с записью
+AkinatorError AkinatorIoStop(FILE* report_stream);
+
+AkinatorIoMode AkinatorIoGetMode();
+
+void AkinatorIoSetSpeech(bool is_enabled);
+bool AkinatorIoIsSpeechEnabled();
+
+/// Читает как scanf("%<max_len>s"); при конце ввода оставляет пустую строку и возвращает false
+bool AkinatorIoReadWord(char* word, size_t max_len);
+
+/// Читает как scanf("\n%<max_len>[^\n]") или, без is_skip_spaces, как scanf("%<max_len>[^\n]")
+bool AkinatorIoReadLine(char* line, size_t max_len, bool is_skip_spaces);
+
+/// Читает как scanf("%d") и отбрасывает остаток строки; не число дает 0, false - только при конце ввода
+bool AkinatorIoReadInt(int* value);
+
+/// Печатает в stdout и добавляет напечатанное к хешу вывода текущего шага
+void AkinatorIoVPrintf(const char* format, va_list args) __attribute__((format(printf, 1, 0)));
+
+#endif // AKINATOR_IO_HPP_
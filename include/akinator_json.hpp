@@ -0,0 +1,24 @@
+#ifndef AKINATOR_JSON_HPP_
+#define AKINATOR_JSON_HPP_
+
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_JSON_BUFFER_SIZE = 1 << 16;
+static const size_t AKINATOR_JSON_MAX_STRING_LEN = 4096;
+static const size_t AKINATOR_JSON_START_STACK_CAPACITY = 64;
+
+/// Вложенный JSON: {"text": "...", "no": {...} | null, "yes": {...} | null}
+AkinatorError AkinatorJsonSave(TreeNode* first_node, FILE* json_file);
+
+/// JSON Lines в прямом порядке обхода: {"id": 0, "parent": null, "side": "root", "text": "..."}
+AkinatorError AkinatorJsonLinesSave(TreeNode* first_node, FILE* json_lines_file);
+
+/// Строит дерево под корнем tree из вложенного JSON
+AkinatorError AkinatorJsonLoad(Tree* tree, FILE* json_file);
+
+/// Строит дерево под корнем tree из JSON Lines, родитель должен идти раньше детей
+AkinatorError AkinatorJsonLinesLoad(Tree* tree, FILE* json_lines_file);
+
+#endif // AKINATOR_JSON_HPP_
@@ -0,0 +1,77 @@
+#ifndef AKINATOR_LAZY_HPP_
+#define AKINATOR_LAZY_HPP_
+
+#include <stdint.h>
+
+#include "akinator.hpp"
+
+static const char AKINATOR_LAZY_INDEX_EXTENSION[] = ".idx";
+static const uint64_t AKINATOR_LAZY_INDEX_MAGIC = 0x3158444955414B41ull;
+static const uint32_t AKINATOR_LAZY_NIL = UINT32_MAX;
+static const size_t AKINATOR_LAZY_START_CAPACITY = 64;
+
+/// Заголовок файла-спутника <база>.idx: по размеру и времени изменения базы видно, что индекс устарел
+struct AkinatorLazyIndexHeader {
+    uint64_t magic;
+    uint64_t node_count;
+    uint64_t database_size;
+    int64_t database_mtime_sec;
+    int64_t database_mtime_nsec;
+};
+
+/// Вершина в индексе: где в файле базы лежит ее текст и номера соседей в прямом порядке обхода
+struct AkinatorLazyIndexRecord {
+    uint64_t value_offset;
+    uint32_t value_len;
+    uint32_t left;
+    uint32_t right;
+    uint32_t parent;
+};
+
+struct AkinatorLazyMapEntry {
+    uint64_t key;
+    uint64_t value;
+};
+
+/// Хеш-таблица с открытой адресацией без удаления, ключ 0 означает пустую ячейку
+struct AkinatorLazyMap {
+    AkinatorLazyMapEntry* entries;
+    size_t size;
+    size_t capacity;
+};
+
+/// Отображенные в память база и индекс плюс соответствие уже созданных вершин номерам в индексе
+struct AkinatorLazy {
+    char* database;
+    size_t database_size;
+
+    const AkinatorLazyIndexRecord* records;
+    size_t node_count;
+
+    void* index_map;
+    size_t index_map_size;
+    AkinatorLazyIndexRecord* index_buffer;
+
+    /// Вершина -> номер; у раскрытых вершин выставлен AKINATOR_LAZY_EXPANDED
+    AkinatorLazyMap node_ids;
+    /// Номер + 1 -> вершина
+    AkinatorLazyMap id_nodes;
+
+    size_t loaded_count;
+};
+
+/// Открывает текстовую базу, строя индекс при первом открытии, и создает только первый вопрос
+AkinatorError AkinatorLazyLoadFile(Akinator* akinator, const char* database_file_name);
+
+AkinatorError AkinatorLazyDestroy(Akinator* akinator);
+
+/// Создает детей node из файла, если они еще не созданы; для обычной базы ничего не делает
+AkinatorError AkinatorLazyExpand(Akinator* akinator, TreeNode* node);
+
+/// Дочитывает все дерево, строит хеши и индексы и превращает базу в обычную
+AkinatorError AkinatorLazyExpandAll(Akinator* akinator);
+
+/// Ищет лист с точно таким именем перебором индекса и создает путь до него; NULL, если такого нет
+TreeNode* AkinatorLazyFind(Akinator* akinator, const char* name);
+
+#endif // AKINATOR_LAZY_HPP_
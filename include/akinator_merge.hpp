@@ -0,0 +1,28 @@
+#ifndef AKINATOR_MERGE_HPP_
+#define AKINATOR_MERGE_HPP_
+
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+/// Лист в текстовом формате - это 4 лексемы: вершина, {nil}, {nil}, }
+static const size_t AKINATOR_MERGE_LOOKAHEAD = 4;
+static const size_t AKINATOR_MERGE_START_STACK_CAPACITY = 64;
+static const size_t AKINATOR_MERGE_BUFFER_SIZE = 1 << 16;
+
+struct AkinatorMergeStats {
+    size_t first_change_count;
+    size_t second_change_count;
+
+    size_t conflict_count;
+};
+
+/// Трехстороннее слияние текстовых баз за один проход по трем файлам с памятью O(глубины дерева).
+/// Разделения листа, сделанные только в одной базе, переносятся как есть; одинаковые изменения в обеих
+/// берутся один раз без конфликта; если лист разделен в обеих по-разному, поддерево первой базы берется
+/// целиком, а место листа в нем занимает поддерево второй.
+/// Конфликты и изменения, которые нельзя объяснить обучением, пишутся в report
+AkinatorError AkinatorMerge(const char* base_file_name, const char* first_file_name, const char* second_file_name,
+                            const char* merged_file_name, FILE* report, AkinatorMergeStats* stats);
+
+#endif // AKINATOR_MERGE_HPP_
@@ -0,0 +1,52 @@
+#ifndef AKINATOR_RELOAD_HPP_
+#define AKINATOR_RELOAD_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "akinator.hpp"
+
+static const int AKINATOR_WATCH_POLL_TIMEOUT_MS = 200;
+
+/// Фоновая перезагрузка базы: новое дерево разбирается в отдельном потоке и подменяет текущее только при успехе
+struct AkinatorReloader {
+    char database_file_name[MAX_FILE_NAME_LEN + 1];
+
+    std::mutex mutex;
+
+    std::thread loader;
+    bool is_loading;
+    bool is_reload_requested;
+    /// Следующий разбор запрошен пользователем (загрузка из меню), а не событием наблюдателя
+    bool is_user_requested;
+    /// Готовое дерево прочитано по запросу пользователя и подменяет текущее, даже если файл не менялся
+    bool is_ready_user_requested;
+
+    std::atomic<Akinator*> ready;
+    std::atomic<AkinatorError> last_error;
+
+    std::thread watcher;
+    std::atomic<bool> is_watching;
+};
+
+AkinatorError AkinatorReloaderInit(AkinatorReloader* reloader, const char* database_file_name);
+
+AkinatorError AkinatorReloaderDestroy(AkinatorReloader* reloader);
+
+/// Запускает фоновый разбор файла базы, если он еще не идет, иначе просит разобрать файл еще раз по окончании;
+/// is_user_requested - загрузка из меню, ее результат подменяет дерево всегда, а не только при изменении файла
+AkinatorError AkinatorReloaderRequest(AkinatorReloader* reloader, const char* database_file_name, bool is_user_requested);
+
+/// Ждет окончания фонового разбора
+AkinatorError AkinatorReloaderWait(AkinatorReloader* reloader);
+
+/// Если новое дерево готово, подменяет им akinator, освобождает старое и возвращает true. Дерево, прочитанное по
+/// событию наблюдателя из файла с тем же содержимым (например, после собственного сохранения), выбрасывается,
+/// чтобы не потерять журнал и снимки; загрузка из меню подменяет дерево всегда
+bool AkinatorReloaderPoll(AkinatorReloader* reloader, Akinator* akinator);
+
+/// Следит за файлом базы через inotify и перезагружает его после каждой записи или подмены
+AkinatorError AkinatorReloaderWatch(AkinatorReloader* reloader);
+
+#endif // AKINATOR_RELOAD_HPP_
@@ -0,0 +1,52 @@
+#ifndef AKINATOR_SHARDS_HPP_
+#define AKINATOR_SHARDS_HPP_
+
+#include <stdint.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_SHARD_MAX_PATH_LEN = MAX_ANSWER_LIST_LEN;
+static const size_t AKINATOR_SHARD_MAX_LINE_LEN = AKINATOR_SHARD_MAX_PATH_LEN + MAX_FILE_NAME_LEN + 2;
+static const size_t AKINATOR_SHARD_START_CAPACITY = 8;
+static const size_t AKINATOR_SHARD_BUFFER_SIZE = 1 << 16;
+
+/// Шард - текстовая база, подвешенная на место листа-заглушки в родительском шарде
+struct AkinatorShard {
+    /// Ответы n/y от первого вопроса до точки монтирования, пустая строка у корневого шарда
+    char path[1 + AKINATOR_SHARD_MAX_PATH_LEN];
+    char file_name[1 + MAX_FILE_NAME_LEN];
+
+    /// Дерево шарда до монтирования
+    Tree tree;
+
+    /// Вершина на месте точки монтирования, пересчитывается перед сохранением
+    TreeNode* mount_node;
+
+    /// Хеш содержимого шарда без вложенных шардов и текста их заглушек на момент последней загрузки или записи
+    uint64_t saved_hash;
+    uint64_t hash;
+
+    AkinatorError error;
+};
+
+/// Манифест .akm: строки "<путь> <файл>", путь - "." для корня или ответы n/y; '#' начинает комментарий.
+/// Пути файлов считаются от папки манифеста
+struct AkinatorShards {
+    char manifest_file_name[1 + MAX_FILE_NAME_LEN];
+
+    AkinatorShard* shards;
+    size_t count;
+
+    /// Вершины точек монтирования по возрастанию адреса, чтобы обход шарда останавливался на вложенных
+    TreeNode** mount_nodes;
+};
+
+/// Разбирает шарды параллельно и собирает из них дерево akinator
+AkinatorError AkinatorShardsLoad(Akinator* akinator, const char* manifest_file_name);
+
+/// Перезаписывает только те шарды, хеш содержимого которых изменился; шарды пишутся параллельно
+AkinatorError AkinatorShardsSave(Akinator* akinator, const char* manifest_file_name);
+
+AkinatorError AkinatorShardsDestroy(Akinator* akinator);
+
+#endif // AKINATOR_SHARDS_HPP_
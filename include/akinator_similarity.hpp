@@ -0,0 +1,63 @@
+#ifndef AKINATOR_SIMILARITY_HPP_
+#define AKINATOR_SIMILARITY_HPP_
+
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_SIMILARITY_START_CAPACITY = 64;
+static const size_t AKINATOR_SIMILARITY_MAX_TOP = 64;
+static const size_t AKINATOR_SIMILARITY_TILE_ROWS = 1 << 14;
+static const size_t AKINATOR_SIMILARITY_CHUNK_ROWS = 256;
+static const size_t AKINATOR_SIMILARITY_MAX_CHECK_LEAVES = 4096;
+
+/// Все пары "строка из [row_begin, col_begin) x столбец из [col_begin, col_end)" имеют одинаковое сходство
+struct AkinatorSimilarityBlock {
+    size_t similarity;
+
+    size_t row_begin;
+    size_t col_begin;
+    size_t col_end;
+};
+
+/// Сходство двух объектов - число общих отвеченных вопросов, то есть глубина их общего предка от первого вопроса.
+/// Листья пронумерованы в порядке обхода (сначала "нет"), поэтому любое поддерево занимает отрезок номеров,
+/// и матрица сходства складывается из блоков "левое поддерево x правое поддерево", по одному на вопрос
+struct AkinatorSimilarity {
+    TreeNode** leaves;
+    size_t* leaf_depths;
+    /// neighbour_similarities[i] - сходство листьев i и i + 1; сходство i < j - минимум на отрезке [i, j)
+    size_t* neighbour_similarities;
+    size_t leaf_count;
+    size_t leaf_capacity;
+
+    AkinatorSimilarityBlock* blocks;
+    size_t block_count;
+    size_t block_capacity;
+
+    /// pair_counts[s] - число пар со сходством s
+    size_t* pair_counts;
+    size_t level_count;
+};
+
+/// Строит блоки за один обход дерева без рекурсии
+AkinatorError AkinatorSimilarityBuild(Akinator* akinator, AkinatorSimilarity* similarity);
+
+AkinatorError AkinatorSimilarityDestroy(AkinatorSimilarity* similarity);
+
+/// Записывает top_count самых похожих на leaf_i объектов по убыванию сходства, расходясь от leaf_i в обе стороны
+/// по порядку обхода; возвращает, сколько записано
+size_t AkinatorSimilarityTop(const AkinatorSimilarity* similarity, size_t leaf_i, size_t top_count,
+                             size_t* top_leaves, size_t* top_similarities);
+
+/// Пишет объекты, блоки и, если top_count не 0, списки ближайших объектов; списки считаются на потоках полосами
+/// по AKINATOR_SIMILARITY_TILE_ROWS строк, поэтому память не растет с размером базы
+AkinatorError AkinatorSimilarityWrite(const AkinatorSimilarity* similarity, size_t top_count, FILE* stream);
+
+/// Сверяет блоки и списки top_count ближайших с перебором общих предков по всем парам; для баз
+/// до AKINATOR_SIMILARITY_MAX_CHECK_LEAVES объектов, расхождение дает AKINATOR_SIMILARITY_CHECK_ERROR
+AkinatorError AkinatorSimilarityCheck(const AkinatorSimilarity* similarity, size_t top_count);
+
+void AkinatorSimilarityPrint(const AkinatorSimilarity* similarity, FILE* stream);
+
+#endif // AKINATOR_SIMILARITY_HPP_
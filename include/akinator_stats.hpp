@@ -0,0 +1,62 @@
+#ifndef AKINATOR_STATS_HPP_
+#define AKINATOR_STATS_HPP_
+
+#include <stdio.h>
+
+#include "akinator.hpp"
+
+static const size_t AKINATOR_STATS_TASKS_PER_THREAD = 8;
+static const size_t AKINATOR_STATS_MAX_REPORTED_DUPLICATES = 16;
+
+struct AkinatorStatsLevel {
+    size_t node_count;
+    size_t leaf_count;
+
+    size_t internal_count;
+    size_t imbalance_sum;
+    size_t max_imbalance;
+};
+
+struct AkinatorStatsDuplicates {
+    size_t group_count;
+    size_t extra_count;
+
+    const char* examples[AKINATOR_STATS_MAX_REPORTED_DUPLICATES];
+    size_t example_counts[AKINATOR_STATS_MAX_REPORTED_DUPLICATES];
+    size_t example_count;
+};
+
+/// Статистика формы дерева; уровни считаются от первого вопроса, глубина листа - число вопросов до ответа
+struct AkinatorStats {
+    size_t node_count;
+    size_t leaf_count;
+    size_t internal_count;
+
+    AkinatorStatsLevel* levels;
+    size_t level_count;
+
+    size_t questions_sum;
+    size_t max_questions;
+
+    AkinatorStatsDuplicates duplicate_leaves;
+    AkinatorStatsDuplicates duplicate_questions;
+
+    size_t node_bytes;
+    size_t string_bytes;
+    size_t heap_string_bytes;
+
+    RadixTrieMemoryStats trie;
+
+    size_t thread_count;
+};
+
+/// Считает статистику за один обход, раздавая поддеревья потокам
+AkinatorError AkinatorStatsCollect(Akinator* akinator, AkinatorStats* stats);
+
+AkinatorError AkinatorStatsDestroy(AkinatorStats* stats);
+
+void AkinatorStatsPrint(const AkinatorStats* stats, FILE* stream);
+
+void AkinatorStatsPrintJson(const AkinatorStats* stats, FILE* stream);
+
+#endif // AKINATOR_STATS_HPP_
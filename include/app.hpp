@@ -9,7 +9,12 @@ enum AkinatorAppMode {
     COMPARE   =  2,
     SAVE      =  3,
     LOAD      =  4,
-    QUIT      =  5
+    QUIT      =  5,
+    METRICS   =  6,
+    UNDO      =  7,
+    REDO      =  8,
+    SNAPSHOT  =  9,
+    RESTORE   = 10
 };
 
 AkinatorError AkinatorApp(int argc, const char** argv);
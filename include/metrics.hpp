@@ -0,0 +1,89 @@
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+/// Гистограмма как в HDR: 2^METRICS_SUB_BUCKET_BITS линейных корзин на каждую степень двойки, ошибка не больше 1/16
+static const size_t METRICS_SUB_BUCKET_BITS = 4;
+static const size_t METRICS_SUB_BUCKET_COUNT = (size_t)1 << METRICS_SUB_BUCKET_BITS;
+static const size_t METRICS_BUCKET_COUNT = (64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKET_COUNT;
+
+enum MetricsError {
+    METRICS_OK              =  0,
+    METRICS_FILE_OPEN_ERROR =  1
+};
+
+const char* MetricsStrError(MetricsError error);
+
+void MetricsPrintError(MetricsError error, const char* file, int line);
+
+#define METRICS_PRINT_ERROR(error) MetricsPrintError(error, __FILE__, __LINE__)
+
+enum MetricsOperation {
+    METRICS_LOAD     =  0,
+    METRICS_SAVE     =  1,
+    METRICS_FIND     =  2,
+    METRICS_COMPARE  =  3,
+    METRICS_QUESTION =  4,
+    METRICS_DUMP     =  5,
+    METRICS_SPEECH   =  6,
+
+    METRICS_OPERATION_COUNT
+};
+
+/// Пишет только поток-владелец, поэтому атомики нужны лишь для чтения снимка из другого потока
+struct MetricsHistogram {
+    std::atomic<uint64_t> buckets[METRICS_BUCKET_COUNT];
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> max_ns;
+};
+
+/// Счетчики одного потока; регистрируются при первой записи и живут до MetricsDestroy
+struct MetricsThread {
+    MetricsHistogram histograms[METRICS_OPERATION_COUNT];
+
+    MetricsThread* next;
+};
+
+struct MetricsSummary {
+    uint64_t count;
+    uint64_t mean_ns;
+    uint64_t max_ns;
+
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+};
+
+struct MetricsReport {
+    MetricsSummary operations[METRICS_OPERATION_COUNT];
+
+    size_t thread_count;
+};
+
+const char* MetricsStrOperation(MetricsOperation operation);
+
+/// Монотонное время в наносекундах
+uint64_t MetricsNow();
+
+/// Добавляет длительность операции в гистограмму текущего потока
+void MetricsRecord(MetricsOperation operation, uint64_t duration_ns);
+
+/// Сливает гистограммы всех потоков и считает перцентили
+void MetricsCollect(MetricsReport* report);
+
+void MetricsPrint(const MetricsReport* report, FILE* stream);
+
+void MetricsPrintJson(const MetricsReport* report, FILE* stream);
+
+/// Сохраняет снимок метрик в файл, в JSON если у файла расширение .json
+MetricsError MetricsDump(const char* file_name);
+
+/// Освобождает счетчики всех потоков; остальные потоки к этому моменту должны завершиться
+void MetricsDestroy();
+
+#endif // METRICS_HPP_
@@ -0,0 +1,83 @@
+#ifndef NAME_INDEX_HPP_
+#define NAME_INDEX_HPP_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "tree.hpp"
+
+static const size_t NAME_INDEX_START_ENTRIES_CAPACITY = 64;
+static const size_t NAME_INDEX_START_TABLE_CAPACITY = 256;
+static const size_t NAME_INDEX_START_POSTING_CAPACITY = 4;
+static const size_t NAME_INDEX_MAX_TRIGRAMS = 2 + MAX_TREE_CHAR_SIZE;
+static const size_t NAME_INDEX_DEFAULT_TOP_K = 3;
+static const double NAME_INDEX_MIN_SCORE = 0.3;
+
+enum NameIndexError {
+    NAME_INDEX_OK          =  0,
+    NAME_INDEX_ALLOC_ERROR =  1
+};
+
+const char* NameIndexStrError(NameIndexError error);
+
+void NameIndexPrintError(NameIndexError error, const char* file, int line);
+
+#define NAME_INDEX_PRINT_ERROR(error) NameIndexPrintError(error, __FILE__, __LINE__)
+
+/// Триграмма - три подряд идущих кодпоинта UTF-8 по 21 биту, упакованные в одно число
+typedef uint64_t name_trigram_t;
+
+struct NameIndexEntry {
+    TreeNode* leaf;
+
+    size_t trigram_count;
+
+    bool is_removed;
+};
+
+/// Ячейка хеш-таблицы: триграмма и список номеров имен, в которых она встречается
+struct NameIndexPosting {
+    name_trigram_t trigram;
+
+    size_t* ids;
+    size_t size;
+    size_t capacity;
+};
+
+struct NameIndex {
+    NameIndexEntry* entries;
+    size_t entries_size;
+    size_t entries_capacity;
+
+    NameIndexPosting* table;
+    size_t table_size;
+    size_t table_capacity;
+
+    unsigned* scratch_scores;
+    size_t* scratch_touched;
+};
+
+struct NameIndexMatch {
+    TreeNode* leaf;
+
+    double score;
+};
+
+NameIndexError NameIndexInit(NameIndex* index);
+
+NameIndexError NameIndexDestroy(NameIndex* index);
+
+/// Индексирует все листья поддерева node
+NameIndexError NameIndexBuild(NameIndex* index, TreeNode* node);
+
+NameIndexError NameIndexAdd(NameIndex* index, TreeNode* leaf);
+
+NameIndexError NameIndexRemove(NameIndex* index, TreeNode* leaf);
+
+/// Возвращает лист, имя которого в точности равно name, или NULL; просматривает только самый короткий список триграмм имени
+TreeNode* NameIndexFind(NameIndex* index, const char* name);
+
+/// Записывает в matches до k ближайших к query имен по убыванию схожести, возвращает их количество
+size_t NameIndexSearch(NameIndex* index, const char* query, NameIndexMatch* matches, size_t k);
+
+#endif // NAME_INDEX_HPP_
@@ -0,0 +1,70 @@
+#ifndef RADIX_TRIE_HPP_
+#define RADIX_TRIE_HPP_
+
+#include <stdlib.h>
+
+#include "tree.hpp"
+
+static const size_t RADIX_TRIE_MAX_KEY_LEN = MAX_TREE_CHAR_SIZE;
+
+enum RadixTrieError {
+    RADIX_TRIE_OK          =  0,
+    RADIX_TRIE_ALLOC_ERROR =  1
+};
+
+const char* RadixTrieStrError(RadixTrieError error);
+
+void RadixTriePrintError(RadixTrieError error, const char* file, int line);
+
+#define RADIX_TRIE_PRINT_ERROR(error) RadixTriePrintError(error, __FILE__, __LINE__)
+
+/// Вершина хранит метку ребра, ведущего в нее, прямо за собой в той же аллокации
+struct RadixTrieNode {
+    RadixTrieNode* first_child;
+    RadixTrieNode* next_sibling;
+
+    size_t count;
+
+    size_t label_len;
+    char label[];
+};
+
+struct RadixTrie {
+    RadixTrieNode* root;
+
+    size_t key_count;
+    size_t node_count;
+    size_t label_bytes;
+    size_t raw_bytes;
+};
+
+struct RadixTrieMemoryStats {
+    size_t key_count;
+    size_t node_count;
+
+    size_t trie_bytes;
+    size_t raw_bytes;
+
+    double overhead;
+};
+
+RadixTrieError RadixTrieInit(RadixTrie* trie);
+
+RadixTrieError RadixTrieDestroy(RadixTrie* trie);
+
+/// Добавляет значения всех вершин поддерева node
+RadixTrieError RadixTrieBuild(RadixTrie* trie, TreeNode* node);
+
+RadixTrieError RadixTrieInsert(RadixTrie* trie, const char* key);
+
+RadixTrieError RadixTrieRemove(RadixTrie* trie, const char* key);
+
+/// Возвращает, сколько раз key был добавлен
+size_t RadixTrieCount(RadixTrie* trie, const char* key);
+
+/// Записывает в completions до limit ключей с префиксом prefix в лексикографическом порядке, возвращает их количество
+size_t RadixTrieComplete(RadixTrie* trie, const char* prefix, char (*completions)[1 + RADIX_TRIE_MAX_KEY_LEN], size_t limit);
+
+RadixTrieMemoryStats RadixTrieGetMemoryStats(RadixTrie* trie);
+
+#endif // RADIX_TRIE_HPP_
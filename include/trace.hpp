@@ -0,0 +1,98 @@
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/// Категории отделяют ожидание пользователя и внешних процессов от собственной работы программы
+#define TRACE_WORK    "work"
+#define TRACE_WAIT    "wait"
+#define TRACE_PROCESS "process"
+
+static const char TRACE_DEFAULT_FILE_NAME[] = "akinator_trace.json";
+
+#ifdef AKINATOR_TRACE
+
+#include <atomic>
+
+static const size_t TRACE_RING_CAPACITY = 1 << 16;
+
+enum TraceError {
+    TRACE_OK              =  0,
+    TRACE_FILE_OPEN_ERROR =  1
+};
+
+const char* TraceStrError(TraceError error);
+
+void TracePrintError(TraceError error, const char* file, int line);
+
+#define TRACE_PRINT_ERROR(error) TracePrintError(error, __FILE__, __LINE__)
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+
+    uint64_t start_ns;
+    uint64_t duration_ns;
+};
+
+/// Кольцо событий одного потока: пишет только владелец, при переполнении затираются самые старые события
+struct TraceRing {
+    TraceEvent events[TRACE_RING_CAPACITY];
+    std::atomic<uint64_t> head;
+
+    size_t thread_id;
+
+    TraceRing* next;
+};
+
+/// Записывает законченный отрезок [start_ns, сейчас) в кольцо текущего потока
+void TraceRecord(const char* name, const char* category, uint64_t start_ns);
+
+/// Сохраняет все кольца в формате Chrome trace event (открывается в Perfetto и chrome://tracing)
+TraceError TraceFlush(const char* file_name);
+
+/// Освобождает кольца; остальные потоки к этому моменту должны завершиться
+void TraceDestroy();
+
+class TraceScope {
+  public:
+    TraceScope(const char* name, const char* category);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    const char* name_;
+    const char* category_;
+    uint64_t start_ns_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/// Отрезок до конца текущего блока
+#define TRACE_SCOPE(name, category) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
+
+/// Отрезок вокруг одного выражения, значение выражения сохраняется
+#define TRACE_CALL(name, category, expr) ([&]() { TraceScope trace_call_scope(name, category); return (expr); }())
+
+#define TRACE_FLUSH(file_name)                          \
+    do {                                                \
+        TraceError trace_err = TraceFlush(file_name);   \
+        if (trace_err != TRACE_OK) {                    \
+            TRACE_PRINT_ERROR(trace_err);               \
+        }                                               \
+        TraceDestroy();                                 \
+    } while (0)
+
+#else
+
+#define TRACE_SCOPE(name, category)
+#define TRACE_CALL(name, category, expr) (expr)
+#define TRACE_FLUSH(file_name) (void)(file_name)
+
+#endif // AKINATOR_TRACE
+
+#endif // TRACE_HPP_
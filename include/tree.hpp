@@ -4,15 +4,11 @@
 #include <stdlib.h>
 #include <limits.h>
 
-typedef char* tree_elem_t;
-#define MAX_TREE_CHAR_SIZE 256
+#include "tree_template.hpp"
+#include "tree_string.hpp"
 
-enum TreeError {
-    TREE_OK                   =  0,
-    TREE_NODE_ALLOC_ERROR     =  1,
-    TREE_GRAPH_ERROR          =  2,
-    TREE_LOST_NODES           =  3
-};
+typedef const char* tree_elem_t;
+#define MAX_TREE_CHAR_SIZE 256
 
 const char* TreeStrError(TreeError error);
 
@@ -24,27 +20,20 @@ static const tree_elem_t ROOT_VALUE = NULL;
 
 static const size_t BUILD_DUMP_COMMAND_SIZE = 128;
 
-struct TreeNode {
-    tree_elem_t value;
-
-    TreeNode* parent;
-    TreeNode* left;
-    TreeNode* right;
-};
-
-
-struct Tree {
-    TreeNode* root;
+typedef TreeNodeT<TreeString> TreeNode;
 
-    size_t size;
-
-    TreeError last_error;
-};
+typedef TreeT<TreeString> Tree;
 
 TreeNode* TreeNodeInit(const char* value);
 
+TreeNode* TreeNodeInit(TreeString&& value);
+
+/// Ноды из статического массива (см. TreeSetStaticNodes) не возвращаются аллокатору, у них только очищается значение
 TreeError TreeNodeDestroy(TreeNode** node);
 
+/// Помечает массив нод в статической памяти, например встроенную базу (см. akinator_embedded.hpp)
+void TreeSetStaticNodes(TreeNode* nodes, size_t count);
+
 TreeNode* TreeNodeGetParent(TreeNode* node);
 
 TreeNode* TreeNodeGetLeft(TreeNode* node);
@@ -53,6 +42,9 @@ TreeError TreeNodeLinkLeft(TreeNode* node, TreeNode* new_left);
 
 TreeNode* TreeNodeGetRight(TreeNode* node);
 
+/// Следующая вершина прямого обхода поддерева subtree_root без стека (см. TreeTNodeNextPreorder)
+TreeNode* TreeNodeNextPreorder(TreeNode* node, TreeNode* subtree_root);
+
 TreeError TreeNodeLinkRight(TreeNode* node, TreeNode* new_right);
 
 tree_elem_t TreeNodeGetValue(TreeNode* node);
@@ -0,0 +1,25 @@
+#ifndef TREE_HASH_HPP_
+#define TREE_HASH_HPP_
+
+#include <stdint.h>
+
+#include "tree.hpp"
+
+/// Хеш отсутствующего ребенка
+static const uint64_t TREE_HASH_NIL = 0x6A09E667F3BCC908ull;
+
+static const size_t TREE_HASH_START_STACK_CAPACITY = 64;
+
+/// Хеш поддерева: TREE_HASH_NIL для NULL, иначе сохраненный в вершине
+uint64_t TreeHashGet(TreeNode* node);
+
+/// Считает хеш вершины по ее тексту и уже посчитанным хешам детей
+uint64_t TreeHashNode(TreeNode* node);
+
+/// Пересчитывает хеши всего поддерева снизу вверх
+TreeError TreeHashSubTree(TreeNode* node);
+
+/// Пересчитывает хеш node и всех ее предков; вызывать после любого изменения вершины или ее детей
+void TreeHashUpdatePath(TreeNode* node);
+
+#endif // TREE_HASH_HPP_
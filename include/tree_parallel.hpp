@@ -0,0 +1,45 @@
+#ifndef TREE_PARALLEL_HPP_
+#define TREE_PARALLEL_HPP_
+
+#include <stdio.h>
+
+#include "tree.hpp"
+
+static const size_t TREE_PARALLEL_MAX_THREADS = 64;
+/// Пока вызывающий поток не обошел столько вершин, помощники не запускаются: маленькие деревья обходятся без потоков
+static const size_t TREE_PARALLEL_SPAWN_THRESHOLD = 1 << 14;
+/// Раз в столько вершин поток отдает на кражу самую старую отложенную вершину, если его очередь пуста
+static const size_t TREE_PARALLEL_CUTOFF = 256;
+static const size_t TREE_PARALLEL_START_CAPACITY = 64;
+static const size_t TREE_PARALLEL_START_OUTPUT_CAPACITY = 1 << 12;
+
+/// Кусок обхода, выполняемый одним потоком; вывод кусков склеивается в порядке последовательного обхода
+struct TreeParallelTask {
+    size_t worker_i;
+
+    char* output;
+    size_t output_size;
+    size_t output_capacity;
+
+    bool is_alloc_failed;
+};
+
+/// pre вызывается до детей вершины и может ее освободить: дети к этому моменту уже прочитаны;
+/// post (если не NULL) упорядочен после детей только по выводу, но не по времени выполнения
+struct TreeParallelVisitor {
+    void (*pre)(TreeNode* node, size_t depth, TreeParallelTask* task, void* context);
+    void (*post)(TreeNode* node, size_t depth, TreeParallelTask* task, void* context);
+
+    void* context;
+};
+
+/// Число потоков обхода; task->worker_i всегда меньше него
+size_t TreeParallelThreadCount();
+
+/// Обходит поддерево root (сначала левые дети) на пуле с кражей работы; если output не NULL,
+/// вывод TreeParallelPrintf пишется туда в том же порядке, что и при последовательном обходе
+TreeError TreeParallelWalk(TreeNode* root, const TreeParallelVisitor* visitor, FILE* output);
+
+TreeError TreeParallelPrintf(TreeParallelTask* task, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // TREE_PARALLEL_HPP_
@@ -0,0 +1,60 @@
+#ifndef TREE_STRING_HPP_
+#define TREE_STRING_HPP_
+
+#include <stdlib.h>
+
+/// Тег конструктора TreeString, который ссылается на чужую строку без копирования
+struct TreeStringBorrow {};
+
+/// Строка для значений дерева: короткие строки хранятся прямо внутри объекта, длинные - в куче,
+/// заимствованные (например, литералы встроенной базы) - там, где их положил владелец
+class TreeString {
+  public:
+    static const size_t INLINE_CAPACITY = 55;
+
+    constexpr TreeString() noexcept : size_(0), inline_() {}
+
+    /// str не копируется и не освобождается, поэтому должна жить дольше строки
+    constexpr TreeString(TreeStringBorrow, const char* str, size_t size) noexcept : size_(size | BORROWED_FLAG), borrowed_(str) {}
+
+    explicit TreeString(const char* str);
+
+    TreeString(const char* str, size_t size);
+
+    TreeString(TreeString&& other) noexcept;
+
+    TreeString& operator=(TreeString&& other) noexcept;
+
+    TreeString(const TreeString&) = delete;
+
+    TreeString& operator=(const TreeString&) = delete;
+
+    ~TreeString();
+
+    const char* CStr() const { return IsInline() ? inline_ : (IsBorrowed() ? borrowed_ : heap_); }
+
+    size_t Size() const { return size_ & ~BORROWED_FLAG; }
+
+    bool IsInline() const { return size_ <= INLINE_CAPACITY; }
+
+    bool IsBorrowed() const { return (size_ & BORROWED_FLAG) != 0; }
+
+    bool IsHeap() const { return !IsInline() && !IsBorrowed(); }
+
+    /// Возвращает false, если не удалось выделить память; строка при этом не меняется
+    bool Assign(const char* str, size_t size);
+
+  private:
+    static const size_t BORROWED_FLAG = ~(~(size_t)0 >> 1);
+
+    /// Старший бит - признак заимствованной строки
+    size_t size_;
+
+    union {
+        char inline_[INLINE_CAPACITY + 1];
+        char* heap_;
+        const char* borrowed_;
+    };
+};
+
+#endif // TREE_STRING_HPP_
@@ -0,0 +1,151 @@
+#ifndef TREE_TEMPLATE_HPP_
+#define TREE_TEMPLATE_HPP_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <memory>
+#include <new>
+#include <utility>
+
+enum TreeError {
+    TREE_OK                   =  0,
+    TREE_NODE_ALLOC_ERROR     =  1,
+    TREE_GRAPH_ERROR          =  2,
+    TREE_LOST_NODES           =  3
+};
+
+template <typename T>
+struct TreeNodeT {
+    /// Значение строится на месте из value_args, поэтому статические таблицы нод инициализируются еще при компиляции
+    template <typename... ValueArgs>
+    constexpr TreeNodeT(TreeNodeT* node_parent, TreeNodeT* node_left, TreeNodeT* node_right, uint64_t node_hash, ValueArgs&&... value_args)
+        : value(std::forward<ValueArgs>(value_args)...), parent(node_parent), left(node_left), right(node_right), hash(node_hash) {}
+
+    /// Ноды живут только по своим адресам (на них ссылаются родители и дети), поэтому не копируются
+    TreeNodeT(const TreeNodeT&) = delete;
+    TreeNodeT& operator=(const TreeNodeT&) = delete;
+
+    T value;
+
+    TreeNodeT* parent;
+    TreeNodeT* left;
+    TreeNodeT* right;
+
+    /// Хеш текста и хешей детей, считается отдельно (см. tree_hash.hpp)
+    uint64_t hash;
+};
+
+template <typename T, typename Allocator = std::allocator<TreeNodeT<T>>>
+struct TreeT {
+    TreeNodeT<T>* root;
+
+    size_t size;
+
+    TreeError last_error;
+
+    Allocator allocator;
+};
+
+/// Создает ноду, перемещая в нее value; возвращает NULL, если аллокатор не смог выделить память
+template <typename T, typename Allocator>
+TreeNodeT<T>* TreeTNodeInit(Allocator& allocator, T&& value) {
+    typedef std::allocator_traits<Allocator> AllocatorTraits;
+
+    TreeNodeT<T>* node = NULL;
+    try {
+        node = AllocatorTraits::allocate(allocator, 1);
+    }
+    catch (const std::bad_alloc&) {
+        return NULL;
+    }
+
+    AllocatorTraits::construct(allocator, node, nullptr, nullptr, nullptr, 0, std::move(value));
+
+    return node;
+}
+
+template <typename T, typename Allocator>
+void TreeTNodeDestroy(Allocator& allocator, TreeNodeT<T>** node) {
+    assert(node != NULL);
+
+    typedef std::allocator_traits<Allocator> AllocatorTraits;
+
+    if (*node == NULL) {
+        return;
+    }
+
+    AllocatorTraits::destroy(allocator, *node);
+    AllocatorTraits::deallocate(allocator, *node, 1);
+
+    *node = NULL;
+}
+
+template <typename T>
+void TreeTNodeLinkLeft(TreeNodeT<T>* node, TreeNodeT<T>* new_left) {
+    assert(node != NULL);
+
+    if (node->left != NULL) {
+        node->left->parent = NULL;
+    }
+
+    node->left = new_left;
+
+    if (new_left != NULL) {
+        new_left->parent = node;
+    }
+}
+
+template <typename T>
+void TreeTNodeLinkRight(TreeNodeT<T>* node, TreeNodeT<T>* new_right) {
+    assert(node != NULL);
+
+    if (node->right != NULL) {
+        node->right->parent = NULL;
+    }
+
+    node->right = new_right;
+
+    if (new_right != NULL) {
+        new_right->parent = node;
+    }
+}
+
+/// Следующая вершина прямого обхода поддерева subtree_root (сначала левые дети) по ссылкам на родителей;
+/// NULL, когда поддерево пройдено. Дополнительной памяти не нужно, поэтому глубина дерева не ограничена
+template <typename T>
+TreeNodeT<T>* TreeTNodeNextPreorder(TreeNodeT<T>* node, TreeNodeT<T>* subtree_root) {
+    assert(node != NULL);
+    assert(subtree_root != NULL);
+
+    if (node->left != NULL) {
+        return node->left;
+    }
+
+    if (node->right != NULL) {
+        return node->right;
+    }
+
+    for (; node != subtree_root; node = node->parent) {
+        if (node->parent->left == node && node->parent->right != NULL) {
+            return node->parent->right;
+        }
+    }
+
+    return NULL;
+}
+
+template <typename T, typename Allocator>
+TreeError TreeTInit(TreeT<T, Allocator>* tree, T&& root_value) {
+    assert(tree != NULL);
+
+    tree->root = TreeTNodeInit(tree->allocator, std::move(root_value));
+
+    tree->size = 0;
+
+    tree->last_error = (tree->root == NULL) ? TREE_NODE_ALLOC_ERROR : TREE_OK;
+
+    return tree->last_error;
+}
+
+#endif // TREE_TEMPLATE_HPP_
@@ -3,7 +3,17 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdarg.h>
-
+#include <sys/stat.h>
+
+#include "akinator_compressed.hpp"
+#include "akinator_io.hpp"
+#include "akinator_json.hpp"
+#include "akinator_lazy.hpp"
+#include "akinator_shards.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "tree_hash.hpp"
+#include "tree_parallel.hpp"
 #include "utils.hpp"
 
 const char* AkinatorStrError(AkinatorError error) {
@@ -18,6 +28,32 @@ const char* AkinatorStrError(AkinatorError error) {
             return "Ошибка при создании файла базы данных акинатора";
         case AKINATOR_DATABASE_FILE_OPEN_ERROR:
             return "Ошибка при открытии файла базы данных акинатора";
+        case AKINATOR_NAME_INDEX_ERROR:
+            return "Ошибка в индексе имен акинатора";
+        case AKINATOR_RADIX_TRIE_ERROR:
+            return "Ошибка в префиксном дереве значений акинатора";
+        case AKINATOR_DATABASE_PARSE_ERROR:
+            return "Файл базы данных акинатора поврежден";
+        case AKINATOR_RELOAD_ERROR:
+            return "Ошибка при фоновой перезагрузке базы данных акинатора";
+        case AKINATOR_MERGE_ERROR:
+            return "Базы данных для слияния не происходят от общей базы";
+        case AKINATOR_HISTORY_ERROR:
+            return "Ошибка в журнале обучения акинатора";
+        case AKINATOR_SHARD_ERROR:
+            return "Ошибка в манифесте шардов базы данных акинатора";
+        case AKINATOR_EMBEDDED_ERROR:
+            return "Встроенная база данных акинатора пуста или уже использована";
+        case AKINATOR_BENCH_ERROR:
+            return "Неверные параметры генератора баз или бенчмарка";
+        case AKINATOR_EVAL_ERROR:
+            return "Доля ошибок оракула должна быть от 0 до 1";
+        case AKINATOR_SIMILARITY_ERROR:
+            return "Слишком много ближайших объектов в запросе сходства";
+        case AKINATOR_SESSION_ERROR:
+            return "Ошибка файла сессии или воспроизведение разошлось с записью";
+        case AKINATOR_SIMILARITY_CHECK_ERROR:
+            return "Сходство разошлось с перебором всех пар или база слишком велика для проверки";
         default:
             return "Непредвиденная ошибка";
     }
@@ -30,32 +66,83 @@ void AkinatorPrintError(AkinatorError error, const char* file, int line) {
     fprintf(stderr, "Error in %s:%d:\n%s\n", file, line, AkinatorStrError(error));
 }
 
-AkinatorError AkinatorTreeInit(Tree* akinator_tree) {
-    assert(akinator_tree != NULL);
+AkinatorError AkinatorTreeInit(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorTreeInit", TRACE_WORK);
 
-    if (TreeInit(akinator_tree) != TREE_OK) {
+    if (TreeInit(&akinator->tree) != TREE_OK) {
         return AKINATOR_TREE_ERROR;
     }
 
+    if (NameIndexInit(&akinator->name_index) != NAME_INDEX_OK) {
+        return AKINATOR_NAME_INDEX_ERROR;
+    }
+
+    if (RadixTrieInit(&akinator->value_trie) != RADIX_TRIE_OK) {
+        return AKINATOR_RADIX_TRIE_ERROR;
+    }
+
+    if (AkinatorHistoryInit(&akinator->history) != AKINATOR_HISTORY_OK) {
+        return AKINATOR_HISTORY_ERROR;
+    }
+
     return AKINATOR_OK;
 }
 
-AkinatorError AkinatorTreeDestroy(Tree* akinator_tree) {
-    assert(akinator_tree != NULL);    
+AkinatorError AkinatorTreeDestroy(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorTreeDestroy", TRACE_WORK);
+
+    NameIndexDestroy(&akinator->name_index);
+
+    RadixTrieDestroy(&akinator->value_trie);
 
-    if (TreeDestroy(akinator_tree) != TREE_OK) {
+    AkinatorHistoryDestroy(&akinator->history);
+
+    AkinatorLazyDestroy(akinator);
+
+    AkinatorShardsDestroy(akinator);
+
+    if (TreeDestroy(&akinator->tree) != TREE_OK) {
         return AKINATOR_TREE_ERROR;
     }
     return AKINATOR_OK;
 }
 
-static AkinatorError AkinatorAnswerHandle(TreeNode* node) {
+AkinatorError AkinatorEnsureIndexes(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    if (!akinator->is_index_pending) {
+        return AKINATOR_OK;
+    }
+
+    TRACE_SCOPE("AkinatorEnsureIndexes", TRACE_WORK);
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    if (NameIndexInit(&akinator->name_index) != NAME_INDEX_OK || NameIndexBuild(&akinator->name_index, first_node) != NAME_INDEX_OK) {
+        return AKINATOR_NAME_INDEX_ERROR;
+    }
+
+    if (RadixTrieInit(&akinator->value_trie) != RADIX_TRIE_OK || RadixTrieBuild(&akinator->value_trie, first_node) != RADIX_TRIE_OK) {
+        return AKINATOR_RADIX_TRIE_ERROR;
+    }
+
+    akinator->is_index_pending = false;
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorAnswerHandle(Akinator* akinator, TreeNode* node) {
+    assert(akinator != NULL);
     assert(node != NULL);
 
     AkinatorPrintf("Вы загадали %s?\n", TreeNodeGetValue(node));
 
     char yes_or_no[1 + MAX_ANSWER_LEN];
-    scanf("%"TO_STRING(MAX_ANSWER_LEN)"s", yes_or_no);
+    TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadWord(yes_or_no, MAX_ANSWER_LEN));
 
     if (strcmp(yes_or_no, "да") == 0) {
         AkinatorPrintf("Я крут!\n");
@@ -63,11 +150,28 @@ static AkinatorError AkinatorAnswerHandle(TreeNode* node) {
     else {
         AkinatorPrintf("А кого вы загадали?\n");
         char name[1 + MAX_NAME_LEN] = "";
-        scanf("\n%"TO_STRING(MAX_NAME_LEN)"[^\n]", name);
+        TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadLine(name, MAX_NAME_LEN, true));
+
+        AkinatorError index_err = AkinatorEnsureIndexes(akinator);
+        if (index_err != AKINATOR_OK) {
+            return index_err;
+        }
+
+        if (NameIndexFind(&akinator->name_index, name) != NULL
+            || (akinator->lazy != NULL && AkinatorLazyFind(akinator, name) != NULL)) {
+            AkinatorPrintf("%s уже есть в базе, не буду добавлять второй раз\n", name);
+            return AKINATOR_OK;
+        }
+
+        char completions[MAX_COMPLETION_COUNT][1 + RADIX_TRIE_MAX_KEY_LEN] = {};
+        size_t completion_count = RadixTrieComplete(&akinator->value_trie, name, completions, MAX_COMPLETION_COUNT);
+        for (size_t completion_i = 0; completion_i < completion_count; completion_i++) {
+            AkinatorPrintf("Похожая запись в базе: %s\n", completions[completion_i]);
+        }
 
         AkinatorPrintf("Чем он(а) отличается от моего варианта? Он(а)(ваш вариант) ....\n");
         char attribute[1 + MAX_ATTRIBUTE_LEN] = "";
-        scanf("\n%"TO_STRING(MAX_ATTRIBUTE_LEN)"[^\n]", attribute);
+        TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadLine(attribute, MAX_ATTRIBUTE_LEN, true));
 
         TreeNode* current_answer = node;
         TreeNode* parent = TreeNodeGetParent(current_answer);
@@ -97,49 +201,77 @@ static AkinatorError AkinatorAnswerHandle(TreeNode* node) {
             return AKINATOR_TREE_ERROR;
         }
 
+        akinator->tree.size += 2;
+
+        TreeHashUpdatePath(new_answer);
+
+        if (AkinatorHistoryRecord(&akinator->history, attribute_node, current_answer, new_answer) != AKINATOR_HISTORY_OK) {
+            return AKINATOR_HISTORY_ERROR;
+        }
+
+        if (NameIndexAdd(&akinator->name_index, new_answer) != NAME_INDEX_OK) {
+            return AKINATOR_NAME_INDEX_ERROR;
+        }
+
+        if (RadixTrieInsert(&akinator->value_trie, name) != RADIX_TRIE_OK
+            || RadixTrieInsert(&akinator->value_trie, attribute) != RADIX_TRIE_OK) {
+            return AKINATOR_RADIX_TRIE_ERROR;
+        }
+
         AkinatorPrintf("Спасибо, я его запомнил!\n");
     }
 
     return AKINATOR_OK;
 }
 
+TreeNode* AkinatorNextNode(TreeNode* node, bool is_yes) {
+    assert(node != NULL);
+
+    return is_yes ? TreeNodeGetRight(node) : TreeNodeGetLeft(node);
+}
+
 static AkinatorError AkinatorQuestionHandle(TreeNode** node, TreeNode** node_parent) {
     assert(node != NULL);
     assert(node_parent != NULL);
 
+    uint64_t start_ns = MetricsNow();
+
     TreeNode* loc_node = *node;
     TreeNode* loc_node_parent = *node_parent;
 
     AkinatorPrintf("Он(a) %s?\n", TreeNodeGetValue(loc_node));
 
     char yes_or_no[1 + MAX_ANSWER_LEN] = "";
-    scanf("%"TO_STRING(MAX_ANSWER_LEN)"s", yes_or_no);
+    TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadWord(yes_or_no, MAX_ANSWER_LEN));
     
-    if (strcmp(yes_or_no, "да") != 0) {
-        loc_node_parent = loc_node;
-        loc_node = TreeNodeGetLeft(loc_node);
-    }
-    else {
-        loc_node_parent = loc_node;
-        loc_node = TreeNodeGetRight(loc_node);
-    }
+    loc_node_parent = loc_node;
+    loc_node = AkinatorNextNode(loc_node, strcmp(yes_or_no, "да") == 0);
 
     *node = loc_node;
     *node_parent = loc_node_parent;
 
+    MetricsRecord(METRICS_QUESTION, MetricsNow() - start_ns);
+
     return AKINATOR_OK;
 }
 
-AkinatorError AkinatorRequest(Tree* akinator_tree) {
-    assert(akinator_tree != NULL);
+AkinatorError AkinatorRequest(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorRequest", TRACE_WORK);
 
-    TreeNode* node_parent = TreeGetRoot(akinator_tree);
+    TreeNode* node_parent = TreeGetRoot(&akinator->tree);
     TreeNode* node = TreeNodeGetLeft(node_parent);
 
     while (true) {
+        AkinatorError expand_err = AkinatorLazyExpand(akinator, node);
+        if (expand_err != AKINATOR_OK) {
+            return expand_err;
+        }
+
         bool is_answer = TreeNodeGetLeft(node) == NULL && TreeNodeGetRight(node) == NULL;
         if (is_answer) {
-            AkinatorError ans_handle_err = AkinatorAnswerHandle(node);
+            AkinatorError ans_handle_err = AkinatorAnswerHandle(akinator, node);
             if (ans_handle_err != AKINATOR_OK) {
                 return ans_handle_err;
             }
@@ -156,40 +288,172 @@ AkinatorError AkinatorRequest(Tree* akinator_tree) {
     return AKINATOR_OK;
 }
 
-static AkinatorError AkinatorBuildSaveFile(TreeNode* node, FILE* database_file, size_t tab_count) {
+static void AkinatorSavePrintTabs(TreeParallelTask* task, size_t tab_count) {
+    assert(task != NULL);
+
+    static const char TABS[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+    static const size_t TABS_LEN = sizeof(TABS) - 1;
+
+    if (tab_count > MAX_INDENT_DEPTH) {
+        tab_count = MAX_INDENT_DEPTH;
+    }
+
+    while (tab_count > 0) {
+        size_t print_count = (tab_count < TABS_LEN) ? tab_count : TABS_LEN;
+        TreeParallelPrintf(task, "%.*s", (int)print_count, TABS);
+        tab_count -= print_count;
+    }
+}
+
+static void AkinatorSaveNodeEnter(TreeNode* node, size_t tab_count, TreeParallelTask* task, void*) {
+    assert(node != NULL);
+    assert(task != NULL);
+
+    AkinatorSavePrintTabs(task, tab_count);
+    TreeParallelPrintf(task, "{\n");
+
+    AkinatorSavePrintTabs(task, tab_count);
+    TreeParallelPrintf(task, "%s\n", TreeNodeGetValue(node));
+
+    if (TreeNodeGetLeft(node) == NULL) {
+        AkinatorSavePrintTabs(task, tab_count + 1);
+        TreeParallelPrintf(task, "{nil}\n");
+    }
+}
+
+static void AkinatorSaveNodeLeave(TreeNode* node, size_t tab_count, TreeParallelTask* task, void*) {
+    assert(node != NULL);
+    assert(task != NULL);
+
+    if (TreeNodeGetRight(node) == NULL) {
+        AkinatorSavePrintTabs(task, tab_count + 1);
+        TreeParallelPrintf(task, "{nil}\n");
+    }
+
+    AkinatorSavePrintTabs(task, tab_count);
+    TreeParallelPrintf(task, "}\n");
+}
+
+/// Текстовый формат пишется параллельно по поддеревьям, куски склеиваются в исходном порядке
+static AkinatorError AkinatorBuildSaveFile(TreeNode* first_node, FILE* database_file) {
     assert(database_file != NULL);
 
-    if (node == NULL) {
-        for (size_t tab_i = 0; tab_i < tab_count; tab_i++) { fprintf(database_file, "\t"); }
+    if (first_node == NULL) {
         fprintf(database_file, "{nil}\n");
         return AKINATOR_OK;
     }
-    
-    for (size_t tab_i = 0; tab_i < tab_count; tab_i++) { fprintf(database_file, "\t"); }
-    fprintf(database_file, "{\n");
 
-    for (size_t tab_i = 0; tab_i < tab_count; tab_i++) { fprintf(database_file, "\t"); }
-    fprintf(database_file, "%s\n", TreeNodeGetValue(node));
+    TreeParallelVisitor visitor = {AkinatorSaveNodeEnter, AkinatorSaveNodeLeave, NULL};
 
-    AkinatorBuildSaveFile(TreeNodeGetLeft(node), database_file, tab_count + 1);
+    if (TreeParallelWalk(first_node, &visitor, database_file) != TREE_OK) {
+        return AKINATOR_TREE_ERROR;
+    }
 
-    AkinatorBuildSaveFile(TreeNodeGetRight(node), database_file, tab_count + 1);
+    return AKINATOR_OK;
+}
 
-    for (size_t tab_i = 0; tab_i < tab_count; tab_i++) { fprintf(database_file, "\t"); }
-    fprintf(database_file, "}\n");
+AkinatorDatabaseFormat AkinatorGetDatabaseFormat(const char* database_file_name) {
+    assert(database_file_name != NULL);
 
-    return AKINATOR_OK;
+    const char* extension = strrchr(database_file_name, '.');
+    if (extension == NULL) {
+        return AKINATOR_FORMAT_TEXT;
+    }
+
+    if (strcmp(extension, ".json") == 0) {
+        return AKINATOR_FORMAT_JSON;
+    }
+
+    if (strcmp(extension, ".jsonl") == 0) {
+        return AKINATOR_FORMAT_JSON_LINES;
+    }
+
+    if (strcmp(extension, ".akz") == 0) {
+        return AKINATOR_FORMAT_COMPRESSED;
+    }
+
+    if (strcmp(extension, ".akm") == 0) {
+        return AKINATOR_FORMAT_MANIFEST;
+    }
+
+    return AKINATOR_FORMAT_TEXT;
 }
 
-AkinatorError AkinatorTreeSave(Tree* akinator_tree) {
-    assert(akinator_tree != NULL);
+static bool AkinatorGetFileMtime(const char* database_file_name, struct timespec* mtime) {
+    assert(database_file_name != NULL);
+    assert(mtime != NULL);
 
-    AkinatorPrintf("В какую базу данных вы хотите загрузить акинатора(введите имя файла):\n");
-    char database_file_name[MAX_FILE_NAME_LEN + 1] = {};
-    scanf("\n%"TO_STRING(MAX_FILE_NAME_LEN)"[^\n]", database_file_name);
+    struct stat file_stat = {};
+    if (stat(database_file_name, &file_stat) != 0) {
+        return false;
+    }
 
-    if (strlen(database_file_name) == 0) {
-        snprintf(database_file_name, MAX_FILE_NAME_LEN, "%s", AKINATOR_STD_DATABASE_FILE_NAME);
+    *mtime = file_stat.st_mtim;
+
+    return true;
+}
+
+static void AkinatorRememberFile(Akinator* akinator, const char* database_file_name) {
+    assert(akinator != NULL);
+    assert(database_file_name != NULL);
+
+    akinator->synced_file_name[0] = '\0';
+
+    if (!AkinatorGetFileMtime(database_file_name, &akinator->synced_mtime)) {
+        return;
+    }
+
+    strncpy(akinator->synced_file_name, database_file_name, MAX_FILE_NAME_LEN);
+    akinator->synced_hash = TreeHashGet(TreeNodeGetLeft(TreeGetRoot(&akinator->tree)));
+}
+
+bool AkinatorIsFileUpToDate(Akinator* akinator, const char* database_file_name) {
+    assert(akinator != NULL);
+    assert(database_file_name != NULL);
+
+    if (strcmp(akinator->synced_file_name, database_file_name) != 0) {
+        return false;
+    }
+
+    struct timespec mtime = {};
+    if (!AkinatorGetFileMtime(database_file_name, &mtime)
+        || mtime.tv_sec != akinator->synced_mtime.tv_sec || mtime.tv_nsec != akinator->synced_mtime.tv_nsec) {
+        return false;
+    }
+
+    if (akinator->lazy != NULL) {
+        return AkinatorHistoryUndoCount(&akinator->history) == 0;
+    }
+
+    return akinator->synced_hash == TreeHashGet(TreeNodeGetLeft(TreeGetRoot(&akinator->tree)));
+}
+
+AkinatorError AkinatorTreeSaveFile(Akinator* akinator, const char* database_file_name) {
+    assert(akinator != NULL);
+    assert(database_file_name != NULL);
+
+    TRACE_SCOPE("AkinatorTreeSaveFile", TRACE_WORK);
+
+    if (AkinatorIsFileUpToDate(akinator, database_file_name)) {
+        return AKINATOR_OK;
+    }
+
+    AkinatorError expand_err = AkinatorLazyExpandAll(akinator);
+    if (expand_err != AKINATOR_OK) {
+        return expand_err;
+    }
+
+    uint64_t start_ns = MetricsNow();
+
+    if (AkinatorGetDatabaseFormat(database_file_name) == AKINATOR_FORMAT_MANIFEST) {
+        AkinatorError shards_err = AkinatorShardsSave(akinator, database_file_name);
+        if (shards_err == AKINATOR_OK) {
+            AkinatorRememberFile(akinator, database_file_name);
+        }
+
+        MetricsRecord(METRICS_SAVE, MetricsNow() - start_ns);
+
+        return shards_err;
     }
 
     FILE* database_file = fopen(database_file_name, "w");
@@ -197,49 +461,113 @@ AkinatorError AkinatorTreeSave(Tree* akinator_tree) {
         return AKINATOR_DATABASE_FILE_CREATE_ERROR;
     }
 
-    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(akinator_tree));
-    AkinatorError build_err = AkinatorBuildSaveFile(first_node, database_file, 0);
-    if (build_err != AKINATOR_OK) {
-        return build_err;
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+    AkinatorError build_err = AKINATOR_OK;
+
+    switch (AkinatorGetDatabaseFormat(database_file_name)) {
+        case AKINATOR_FORMAT_JSON:
+            build_err = AkinatorJsonSave(first_node, database_file);
+            break;
+        case AKINATOR_FORMAT_JSON_LINES:
+            build_err = AkinatorJsonLinesSave(first_node, database_file);
+            break;
+        case AKINATOR_FORMAT_COMPRESSED:
+            build_err = AkinatorCompressedSave(first_node, database_file);
+            break;
+        case AKINATOR_FORMAT_TEXT:
+        case AKINATOR_FORMAT_MANIFEST:
+        default:
+            build_err = AkinatorBuildSaveFile(first_node, database_file);
+            break;
     }
 
     fclose(database_file);
 
-    return AKINATOR_OK;
-}
+    if (build_err == AKINATOR_OK) {
+        AkinatorRememberFile(akinator, database_file_name);
+    }
 
-static AkinatorError AkinatorTreeBuild(TreeNode** node, TreeNode* node_parent, FILE* database_file) {
-    assert(node != NULL);
-    assert(node_parent != NULL);
-    assert(database_file != NULL);
+    MetricsRecord(METRICS_SAVE, MetricsNow() - start_ns);
 
-    TreeNode* loc_node = *node;
+    return build_err;
+}
 
-    char value[1 + MAX_TREE_CHAR_SIZE];
-    fscanf(database_file, "{");
-    SkipSpaces(database_file);
-    fscanf(database_file, "%"TO_STRING(MAX_TREE_CHAR_SIZE)"[^\n]", value); //FIXME как пофиксить ввод?
+AkinatorError AkinatorTreeSave(Akinator* akinator) {
+    assert(akinator != NULL);
 
-    SkipSpaces(database_file);
+    AkinatorPrintf("В какую базу данных вы хотите загрузить акинатора(введите имя файла):\n");
+    char database_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadLine(database_file_name, MAX_FILE_NAME_LEN, true));
+
+    if (strlen(database_file_name) == 0) {
+        snprintf(database_file_name, MAX_FILE_NAME_LEN, "%s", AKINATOR_STD_DATABASE_FILE_NAME);
+    }
 
-    if (strcmp(value, "nil}") == 0) {
-        *node = NULL;
+    if (AkinatorIsFileUpToDate(akinator, database_file_name)) {
+        AkinatorPrintf("База данных не изменилась, файл не перезаписан\n");
         return AKINATOR_OK;
     }
 
-    loc_node = TreeNodeInit(value);
-    loc_node->parent = node_parent;
+    return AkinatorTreeSaveFile(akinator, database_file_name);
+}
 
-    AkinatorTreeBuild(&loc_node->left, loc_node, database_file);
-    AkinatorTreeBuild(&loc_node->right, loc_node, database_file);
-    
-    fscanf(database_file, "}");
+/// Читает поддерево в *node без рекурсии: slot - место для следующей вершины, после {nil} или закрытой вершины
+/// подъем по родителям переводит его к правому ребенку или закрывает родителя; созданные вершины добавляются к tree->size
+static AkinatorError AkinatorTreeBuild(Tree* tree, FILE* database_file) {
+    assert(tree != NULL);
+    assert(database_file != NULL);
 
-    SkipSpaces(database_file);
+    TreeNode* node_parent = TreeGetRoot(tree);
+    TreeNode* parent = node_parent;
+    TreeNode** slot = &node_parent->left;
 
-    *node = loc_node;
+    while (true) {
+        char value[1 + MAX_TREE_CHAR_SIZE];
+        if (getc(database_file) != '{') {
+            return AKINATOR_DATABASE_PARSE_ERROR;
+        }
+        SkipSpaces(database_file);
+        if (fscanf(database_file, "%"TO_STRING(MAX_TREE_CHAR_SIZE)"[^\n]", value) != 1) { //FIXME как пофиксить ввод?
+            return AKINATOR_DATABASE_PARSE_ERROR;
+        }
 
-    return AKINATOR_OK;
+        SkipSpaces(database_file);
+
+        if (strcmp(value, "nil}") != 0) {
+            TreeNode* loc_node = TreeNodeInit(TreeString(value, strlen(value)));
+            if (loc_node == NULL) {
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+            loc_node->parent = parent;
+
+            *slot = loc_node;
+            tree->size++;
+
+            parent = loc_node;
+            slot = &loc_node->left;
+            continue;
+        }
+
+        *slot = NULL;
+
+        while (parent != node_parent && slot == &parent->right) {
+            if (getc(database_file) != '}') {
+                return AKINATOR_DATABASE_PARSE_ERROR;
+            }
+
+            SkipSpaces(database_file);
+
+            TreeNode* done_node = parent;
+            parent = TreeNodeGetParent(done_node);
+            slot = (parent->left == done_node) ? &parent->left : &parent->right;
+        }
+
+        if (parent == node_parent) {
+            return AKINATOR_OK;
+        }
+
+        slot = &parent->right;
+    }
 }
 
 static AkinatorError AkinatorDatabaseFillIfEmpty(const char* database_file_name) {
@@ -258,91 +586,261 @@ static AkinatorError AkinatorDatabaseFillIfEmpty(const char* database_file_name)
     return AKINATOR_OK;
 }
 
-AkinatorError AkinatorTreeLoad(Tree* akinator_tree, bool is_fast_load, char database_file_name[MAX_FILE_NAME_LEN + 1]) {
-    assert(akinator_tree != NULL);
+AkinatorError AkinatorTreeReadFile(Tree* tree, const char* database_file_name) {
+    assert(tree != NULL);
+    assert(database_file_name != NULL);
 
-    if (akinator_tree->root != NULL) {
-        AkinatorTreeDestroy(akinator_tree);
+    AkinatorDatabaseFormat format = AkinatorGetDatabaseFormat(database_file_name);
+    if (format == AKINATOR_FORMAT_MANIFEST) {
+        return AKINATOR_SHARD_ERROR;
+    }
 
-        AkinatorError init_error = AkinatorTreeInit(akinator_tree);
-        if (init_error != AKINATOR_OK) {
-            return init_error;
-        }
+    FILE* database_file = fopen(database_file_name, "r");
+    if (database_file == NULL) {
+        return AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    }
+
+    AkinatorError build_err = AKINATOR_OK;
+
+    switch (format) {
+        case AKINATOR_FORMAT_JSON:
+            build_err = TRACE_CALL("AkinatorJsonLoad", TRACE_WORK, AkinatorJsonLoad(tree, database_file));
+            break;
+        case AKINATOR_FORMAT_JSON_LINES:
+            build_err = TRACE_CALL("AkinatorJsonLinesLoad", TRACE_WORK, AkinatorJsonLinesLoad(tree, database_file));
+            break;
+        case AKINATOR_FORMAT_COMPRESSED:
+            build_err = TRACE_CALL("AkinatorCompressedLoad", TRACE_WORK, AkinatorCompressedLoad(tree, database_file));
+            break;
+        case AKINATOR_FORMAT_TEXT:
+        case AKINATOR_FORMAT_MANIFEST:
+        default:
+            build_err = TRACE_CALL("AkinatorTreeBuild", TRACE_WORK, AkinatorTreeBuild(tree, database_file));
+            break;
+    }
+
+    fclose(database_file);
+
+    return build_err;
+}
+
+AkinatorError AkinatorTreeLoadFile(Akinator* akinator, const char* database_file_name) {
+    assert(akinator != NULL);
+    assert(database_file_name != NULL);
+
+    TRACE_SCOPE("AkinatorTreeLoadFile", TRACE_WORK);
+
+    uint64_t start_ns = MetricsNow();
+
+    AkinatorError build_err = AKINATOR_OK;
+
+    if (AkinatorGetDatabaseFormat(database_file_name) == AKINATOR_FORMAT_MANIFEST) {
+        build_err = AkinatorShardsLoad(akinator, database_file_name);
+    }
+    else {
+        build_err = AkinatorTreeReadFile(&akinator->tree, database_file_name);
     }
 
+    if (build_err != AKINATOR_OK) {
+        return build_err;
+    }
+
+    if (TRACE_CALL("TreeHashSubTree", TRACE_WORK, TreeHashSubTree(TreeGetRoot(&akinator->tree))) != TREE_OK) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorRememberFile(akinator, database_file_name);
+
+    if (TRACE_CALL("NameIndexBuild", TRACE_WORK, NameIndexBuild(&akinator->name_index, TreeNodeGetLeft(TreeGetRoot(&akinator->tree)))) != NAME_INDEX_OK) {
+        return AKINATOR_NAME_INDEX_ERROR;
+    }
+
+    if (TRACE_CALL("RadixTrieBuild", TRACE_WORK, RadixTrieBuild(&akinator->value_trie, TreeNodeGetLeft(TreeGetRoot(&akinator->tree)))) != RADIX_TRIE_OK) {
+        return AKINATOR_RADIX_TRIE_ERROR;
+    }
+
+    MetricsRecord(METRICS_LOAD, MetricsNow() - start_ns);
+
+    return AKINATOR_OK;
+}
+
+void AkinatorAskDatabaseFileName(char database_file_name[MAX_FILE_NAME_LEN + 1]) {
+    assert(database_file_name != NULL);
+
+    AkinatorPrintf("Из какой базы данных вы хотите загрузить акинатора(введите имя файла):\n");
+    database_file_name[0] = '\0';
+    TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadLine(database_file_name, MAX_FILE_NAME_LEN, false));
+
+    if (strlen(database_file_name) == 0) {
+        snprintf(database_file_name, MAX_FILE_NAME_LEN, "%s", AKINATOR_STD_DATABASE_FILE_NAME);
+    }
+}
+
+AkinatorError AkinatorTreeLoad(Akinator* akinator, bool is_fast_load, bool is_lazy, char database_file_name[MAX_FILE_NAME_LEN + 1]) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorTreeLoad", TRACE_WORK);
+
     char loc_database_file_name[MAX_FILE_NAME_LEN + 1] = {};
     
     if (is_fast_load) {
         strncpy(loc_database_file_name, database_file_name, MAX_FILE_NAME_LEN);
     }
     else {
-        AkinatorPrintf("Из какой базы данных вы хотите загрузить акинатора(введите имя файла):\n");
-        scanf("%"TO_STRING(MAX_FILE_NAME_LEN)"[^\n]", loc_database_file_name);
+        AkinatorAskDatabaseFileName(loc_database_file_name);
     }
 
     if (strlen(loc_database_file_name) == 0) {
         snprintf(loc_database_file_name, MAX_FILE_NAME_LEN, "%s", AKINATOR_STD_DATABASE_FILE_NAME);
     }
 
-    AkinatorDatabaseFillIfEmpty(loc_database_file_name);
+    if (database_file_name != NULL) {
+        strncpy(database_file_name, loc_database_file_name, MAX_FILE_NAME_LEN);
+    }
 
-    FILE* database_file = fopen(loc_database_file_name, "r");
-    if (database_file == NULL) {
-        return AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    if (AkinatorGetDatabaseFormat(loc_database_file_name) == AKINATOR_FORMAT_TEXT) {
+        AkinatorDatabaseFillIfEmpty(loc_database_file_name);
     }
 
-    AkinatorError build_err = AkinatorTreeBuild(&akinator_tree->root->left, akinator_tree->root, database_file);
-    if (build_err != AKINATOR_OK) {
-        return build_err;
+    Akinator new_akinator = {};
+    AkinatorError init_error = AkinatorTreeInit(&new_akinator);
+    if (init_error != AKINATOR_OK) {
+        AkinatorTreeDestroy(&new_akinator);
+        return init_error;
     }
 
-    fclose(database_file);
+    AkinatorError load_err = AKINATOR_OK;
+    if (is_lazy && AkinatorGetDatabaseFormat(loc_database_file_name) == AKINATOR_FORMAT_TEXT) {
+        load_err = AkinatorLazyLoadFile(&new_akinator, loc_database_file_name);
+        AkinatorRememberFile(&new_akinator, loc_database_file_name);
+    }
+    else {
+        load_err = AkinatorTreeLoadFile(&new_akinator, loc_database_file_name);
+    }
+
+    if (load_err != AKINATOR_OK) {
+        AkinatorTreeDestroy(&new_akinator);
+        return load_err;
+    }
+
+    if (akinator->tree.root != NULL) {
+        AkinatorTreeDestroy(akinator);
+    }
+
+    *akinator = new_akinator;
 
     return AKINATOR_OK;
 }
 
-static AkinatorError AkinatorGetAnswerList(TreeNode* node, const char* name, char* cur_ans_list, char* ans_list) {
-    assert(node != NULL);
-    assert(name != NULL);
-    assert(cur_ans_list != NULL);
+AkinatorError AkinatorGetAnswerList(TreeNode* first_node, TreeNode* leaf, char** ans_list, size_t* ans_list_len) {
+    assert(first_node != NULL);
+    assert(leaf != NULL);
     assert(ans_list != NULL);
+    assert(ans_list_len != NULL);
 
-    bool is_answer = TreeNodeGetLeft(node) == NULL && TreeNodeGetRight(node) == NULL;
-    if (is_answer) {
-        if (strcmp(name, TreeNodeGetValue(node)) == 0) {
-            strncpy(ans_list, cur_ans_list, MAX_ANSWER_LIST_LEN);
-        }
-        return AKINATOR_OK;
+    size_t depth = 0;
+    for (TreeNode* node = leaf; node != first_node; node = TreeNodeGetParent(node)) {
+        depth++;
     }
 
-    char left_answer_list[1 + MAX_ANSWER_LIST_LEN] = {};
-    snprintf(left_answer_list, MAX_ANSWER_LIST_LEN, "%sn", cur_ans_list);
-    AkinatorGetAnswerList(TreeNodeGetLeft(node), name, left_answer_list, ans_list);
+    *ans_list = (char*)calloc(depth + 1, sizeof(char));
+    if (*ans_list == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    *ans_list_len = depth;
 
-    char right_answer_list[1 + MAX_ANSWER_LIST_LEN] = {};
-    snprintf(right_answer_list, MAX_ANSWER_LIST_LEN, "%sy", cur_ans_list);
-    AkinatorGetAnswerList(TreeNodeGetRight(node), name, right_answer_list, ans_list);
+    for (TreeNode* node = leaf; node != first_node; node = TreeNodeGetParent(node)) {
+        (*ans_list)[--depth] = (TreeNodeGetLeft(TreeNodeGetParent(node)) == node) ? 'n' : 'y';
+    }
 
     return AKINATOR_OK;
 }
 
-AkinatorError AkinatorFind(Tree* akinator_tree) {
-    assert(akinator_tree != NULL);
+TreeNode* AkinatorResolveName(Akinator* akinator, const char* name) {
+    assert(akinator != NULL);
+    assert(name != NULL);
+
+    TreeNode* lazy_leaf = AkinatorLazyFind(akinator, name);
+    if (lazy_leaf != NULL) {
+        return lazy_leaf;
+    }
+
+    if (AkinatorEnsureIndexes(akinator) != AKINATOR_OK) {
+        return NULL;
+    }
+
+    TreeNode* exact_leaf = NameIndexFind(&akinator->name_index, name);
+    if (exact_leaf != NULL) {
+        return exact_leaf;
+    }
+
+    NameIndexMatch matches[NAME_INDEX_DEFAULT_TOP_K] = {};
+    size_t match_count = NameIndexSearch(&akinator->name_index, name, matches, NAME_INDEX_DEFAULT_TOP_K);
+
+    if (match_count == 0 || matches[0].score < NAME_INDEX_MIN_SCORE) {
+        return NULL;
+    }
+
+    return matches[0].leaf;
+}
+
+/// В *work_ns добавляется время поиска имени без ожидания ввода
+static TreeNode* AkinatorAskName(Akinator* akinator, char name[1 + MAX_NAME_LEN], uint64_t* work_ns) {
+    assert(akinator != NULL);
+    assert(name != NULL);
+    assert(work_ns != NULL);
+
+    TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadLine(name, MAX_NAME_LEN, true));
+
+    uint64_t start_ns = MetricsNow();
+
+    TreeNode* leaf = AkinatorResolveName(akinator, name);
+
+    *work_ns += MetricsNow() - start_ns;
+
+    if (leaf == NULL) {
+        AkinatorPrintf("Я не знаю %s\n", name);
+        return NULL;
+    }
+
+    if (strcmp(TreeNodeGetValue(leaf), name) != 0) {
+        AkinatorPrintf("Я не знаю %s, но знаю %s\n", name, TreeNodeGetValue(leaf));
+    }
+
+    return leaf;
+}
+
+AkinatorError AkinatorFind(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorFind", TRACE_WORK);
 
     AkinatorPrintf("Кого вы хотите найти?\n");
 
-    char name[1 + MAX_NAME_LEN] = {};
-    scanf("\n%"TO_STRING(MAX_NAME_LEN)"[^\n]", name);
+    uint64_t work_ns = 0;
+
+    char name_buffer[1 + MAX_NAME_LEN] = {};
+    TreeNode* leaf = AkinatorAskName(akinator, name_buffer, &work_ns);
+    if (leaf == NULL) {
+        MetricsRecord(METRICS_FIND, work_ns);
+        return AKINATOR_OK;
+    }
 
-    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(akinator_tree));
+    uint64_t start_ns = MetricsNow();
 
-    char ans_list[1 + MAX_ANSWER_LIST_LEN] = {};
-    AkinatorGetAnswerList(first_node, name, "", ans_list);
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
 
-    size_t ans_list_len = strlen(ans_list);
+    char* ans_list = NULL;
+    size_t ans_list_len = 0;
+    if (AkinatorGetAnswerList(first_node, leaf, &ans_list, &ans_list_len) != AKINATOR_OK) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
 
     if (ans_list_len == 0) {
         AkinatorPrintf("Я его не знаю\n");
+        PROTECTED_FREE(ans_list);
+        MetricsRecord(METRICS_FIND, work_ns + MetricsNow() - start_ns);
         return AKINATOR_OK;
     }
 
@@ -366,47 +864,60 @@ AkinatorError AkinatorFind(Tree* akinator_tree) {
 
     AkinatorPrintf("\n");
 
+    PROTECTED_FREE(ans_list);
+
+    MetricsRecord(METRICS_FIND, work_ns + MetricsNow() - start_ns);
+
     return AKINATOR_OK;
 }
 
-AkinatorError AkinatorCompare(Tree* akinator_tree) {
-    assert(akinator_tree != NULL);
+AkinatorError AkinatorCompare(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorCompare", TRACE_WORK);
 
     AkinatorPrintf("Кого вы хотите сравнить? Напишите в отдельные строчки по очереди:\n");
 
-    char name1[1 + MAX_NAME_LEN] = {};
-    scanf("\n%"TO_STRING(MAX_NAME_LEN)"[^\n]", name1);
+    uint64_t work_ns = 0;
 
-    char name2[1 + MAX_NAME_LEN] = {};
-    scanf("\n%"TO_STRING(MAX_NAME_LEN)"[^\n]", name2);
+    char name1_buffer[1 + MAX_NAME_LEN] = {};
+    TreeNode* leaf1 = AkinatorAskName(akinator, name1_buffer, &work_ns);
 
-    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(akinator_tree));
-    
-    char ans_list1[1 + MAX_ANSWER_LIST_LEN] = {};
-    AkinatorGetAnswerList(first_node, name1, "", ans_list1);
-    size_t ans_list1_len = strlen(ans_list1);
+    char name2_buffer[1 + MAX_NAME_LEN] = {};
+    TreeNode* leaf2 = AkinatorAskName(akinator, name2_buffer, &work_ns);
 
-    char ans_list2[1 + MAX_ANSWER_LIST_LEN] = {};
-    AkinatorGetAnswerList(first_node, name2, "", ans_list2);
-    size_t ans_list2_len = strlen(ans_list2);
+    if (leaf1 == NULL || leaf2 == NULL) {
+        MetricsRecord(METRICS_COMPARE, work_ns);
+        return AKINATOR_OK;
+    }
+
+    uint64_t start_ns = MetricsNow();
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    char* ans_list1 = NULL;
+    size_t ans_list1_len = 0;
+    char* ans_list2 = NULL;
+    size_t ans_list2_len = 0;
+
+    if (AkinatorGetAnswerList(first_node, leaf1, &ans_list1, &ans_list1_len) != AKINATOR_OK
+        || AkinatorGetAnswerList(first_node, leaf2, &ans_list2, &ans_list2_len) != AKINATOR_OK) {
+        PROTECTED_FREE(ans_list1);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
 
     size_t common_ans_cnt = 0;
-    while (ans_list1[common_ans_cnt] == ans_list2[common_ans_cnt]) {
+    while (ans_list1[common_ans_cnt] != '\0' && ans_list1[common_ans_cnt] == ans_list2[common_ans_cnt]) {
         common_ans_cnt++;
     }
 
-    char common_ans_list[1 + MAX_ANSWER_LIST_LEN] = {};
-    strncpy(common_ans_list, ans_list1, common_ans_cnt);
-
-    char different_ans1[1 + MAX_ANSWER_LIST_LEN] = {};
-    strncpy(different_ans1, ans_list1 + common_ans_cnt, MAX_ANSWER_LIST_LEN);
+    const char* different_ans1 = ans_list1 + common_ans_cnt;
     size_t dif_ans1_len = ans_list1_len - common_ans_cnt;
 
-    char different_ans2[1 + MAX_ANSWER_LIST_LEN];
-    strncpy(different_ans2, ans_list2 + common_ans_cnt, MAX_ANSWER_LIST_LEN);
+    const char* different_ans2 = ans_list2 + common_ans_cnt;
     size_t dif_ans2_len = ans_list2_len - common_ans_cnt;
 
-    TreeNode* last_common_node = NULL;
+    TreeNode* first_different_node = first_node;
 
     if (common_ans_cnt == 0) {
         AkinatorPrintf("Они ничем не похожи\n");
@@ -414,40 +925,31 @@ AkinatorError AkinatorCompare(Tree* akinator_tree) {
     else {
         AkinatorPrintf("Каждый из них ");
 
-        TreeNode* node = first_node;
         for (size_t common_ans_i = 0; common_ans_i < common_ans_cnt; common_ans_i++) {
-            if (common_ans_list[common_ans_i] == 'n') {
+            if (ans_list1[common_ans_i] == 'n') {
                 AkinatorPrintf("не ");
             }
 
-            AkinatorPrintf("%s ", TreeNodeGetValue(node));
+            AkinatorPrintf("%s ", TreeNodeGetValue(first_different_node));
 
-            if (common_ans_list[common_ans_i] == 'n') {
-                node = TreeNodeGetLeft(node);
+            if (ans_list1[common_ans_i] == 'n') {
+                first_different_node = TreeNodeGetLeft(first_different_node);
             }
             else {
-                node = TreeNodeGetRight(node);
+                first_different_node = TreeNodeGetRight(first_different_node);
             }
         }
-        
-        last_common_node = TreeNodeGetParent(node);
 
         AkinatorPrintf("\n");
     }
 
-    if (ans_list1_len - common_ans_cnt == 0) {
+    if (dif_ans1_len == 0) {
         AkinatorPrintf("Они ничем не отличаются");
     }
     else {
         AkinatorPrintf("Первый уникален тем что он: ");
 
-        TreeNode* node1 = NULL;
-        if (common_ans_list[common_ans_cnt - 1] == 'n') {
-            node1 = TreeNodeGetLeft(last_common_node);
-        }
-        else {
-            node1 = TreeNodeGetRight(last_common_node);
-        }
+        TreeNode* node1 = first_different_node;
 
         for (size_t ans1_i = 0; ans1_i < dif_ans1_len; ans1_i++) {
             if (different_ans1[ans1_i] == 'n') {
@@ -468,13 +970,7 @@ AkinatorError AkinatorCompare(Tree* akinator_tree) {
 
         AkinatorPrintf("Второй уникален тем что он: ");
 
-        TreeNode* node2 = NULL;
-        if (common_ans_list[common_ans_cnt - 1] == 'n') {
-            node2 = TreeNodeGetLeft(last_common_node);
-        }
-        else {
-            node2 = TreeNodeGetRight(last_common_node);
-        }
+        TreeNode* node2 = first_different_node;
 
         for (size_t ans2_i = 0; ans2_i < dif_ans2_len; ans2_i++) {
             if (different_ans2[ans2_i] == 'n') {
@@ -494,6 +990,100 @@ AkinatorError AkinatorCompare(Tree* akinator_tree) {
         AkinatorPrintf("\n");
     }
 
+    PROTECTED_FREE(ans_list1);
+    PROTECTED_FREE(ans_list2);
+
+    MetricsRecord(METRICS_COMPARE, work_ns + MetricsNow() - start_ns);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorUndo(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorUndo", TRACE_WORK);
+
+    if (AkinatorHistoryUndoCount(&akinator->history) == 0) {
+        AkinatorPrintf("Нечего отменять\n");
+        return AKINATOR_OK;
+    }
+
+    AkinatorHistoryError undo_err = AkinatorHistoryUndo(akinator);
+    if (undo_err != AKINATOR_HISTORY_OK) {
+        AKINATOR_HISTORY_PRINT_ERROR(undo_err);
+        return AKINATOR_HISTORY_ERROR;
+    }
+
+    AkinatorPrintf("Последнее обучение отменено\n");
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorRedo(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorRedo", TRACE_WORK);
+
+    if (AkinatorHistoryRedoCount(&akinator->history) == 0) {
+        AkinatorPrintf("Нечего повторять\n");
+        return AKINATOR_OK;
+    }
+
+    AkinatorHistoryError redo_err = AkinatorHistoryRedo(akinator);
+    if (redo_err != AKINATOR_HISTORY_OK) {
+        AKINATOR_HISTORY_PRINT_ERROR(redo_err);
+        return AKINATOR_HISTORY_ERROR;
+    }
+
+    AkinatorPrintf("Обучение повторено\n");
+
+    return AKINATOR_OK;
+}
+
+static void AkinatorAskSnapshotName(char name[1 + AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN]) {
+    assert(name != NULL);
+
+    AkinatorPrintf("Введите имя снимка:\n");
+    name[0] = '\0';
+    TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadLine(name, AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN, true));
+}
+
+AkinatorError AkinatorSnapshotSave(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    char name[1 + AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN] = {};
+    AkinatorAskSnapshotName(name);
+
+    if (AkinatorHistorySnapshotSave(&akinator->history, name) != AKINATOR_HISTORY_OK) {
+        return AKINATOR_HISTORY_ERROR;
+    }
+
+    AkinatorPrintf("Снимок %s сохранен\n", name);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorSnapshotRestore(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    char name[1 + AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN] = {};
+    AkinatorAskSnapshotName(name);
+
+    TRACE_SCOPE("AkinatorSnapshotRestore", TRACE_WORK);
+
+    AkinatorHistoryError restore_err = AkinatorHistorySnapshotRestore(akinator, name);
+    if (restore_err == AKINATOR_HISTORY_UNKNOWN_SNAPSHOT) {
+        AkinatorPrintf("Снимка %s нет\n", name);
+        return AKINATOR_OK;
+    }
+
+    if (restore_err != AKINATOR_HISTORY_OK) {
+        AKINATOR_HISTORY_PRINT_ERROR(restore_err);
+        return AKINATOR_HISTORY_ERROR;
+    }
+
+    AkinatorPrintf("Дерево возвращено к снимку %s\n", name);
+
     return AKINATOR_OK;
 }
 
@@ -502,7 +1092,17 @@ AkinatorError AkinatorPrintf(const char* format, ...) {
     va_list args;
     va_start(args, format);
 
-    vprintf(format, args);
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    AkinatorIoVPrintf(format, args_copy);
+
+    va_end(args_copy);
+
+    if (!AkinatorIoIsSpeechEnabled()) {
+        va_end(args);
+        return AKINATOR_OK;
+    }
 
     char command_arg[MAX_PRINT_COMMAND_SIZE + 1];
     vsnprintf(command_arg, MAX_PRINT_COMMAND_SIZE, format, args);
@@ -510,7 +1110,11 @@ AkinatorError AkinatorPrintf(const char* format, ...) {
     char command[2 * MAX_PRINT_COMMAND_SIZE + 1];
     snprintf(command, 2 * MAX_PRINT_COMMAND_SIZE, "espeak-ng -v ru \"%s\"", command_arg);
 
-    system(command);
+    uint64_t start_ns = MetricsNow();
+
+    TRACE_CALL("espeak-ng", TRACE_PROCESS, system(command));
+
+    MetricsRecord(METRICS_SPEECH, MetricsNow() - start_ns);
 
     va_end(args);
 
@@ -521,10 +1125,10 @@ AkinatorError AkinatorPrintf(const char* format, ...) {
     va_list args;
     va_start(args, format);
 
-    vprintf(format, args);
+    AkinatorIoVPrintf(format, args);
 
     va_end(args);
 
     return AKINATOR_OK;
 }
-#endif
\ No newline at end of file
+#endif
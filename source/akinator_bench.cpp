@@ -0,0 +1,558 @@
+#include "akinator_bench.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "metrics.hpp"
+#include "utils.hpp"
+
+enum AkinatorBenchOperation {
+    AKINATOR_BENCH_LOAD            = 0,
+    AKINATOR_BENCH_VERIFY          = 1,
+    AKINATOR_BENCH_FIND            = 2,
+    AKINATOR_BENCH_COMPARE         = 3,
+    AKINATOR_BENCH_DESCENT         = 4,
+    AKINATOR_BENCH_SAVE            = 5,
+    AKINATOR_BENCH_DUMP            = 6,
+    AKINATOR_BENCH_DESTROY         = 7,
+    AKINATOR_BENCH_OPERATION_COUNT = 8
+};
+
+static const char* const AKINATOR_BENCH_OPERATION_NAMES[AKINATOR_BENCH_OPERATION_COUNT] = {
+    "load", "verify", "find", "compare", "descent", "save", "dump", "destroy"
+};
+
+/// Поддерево, которое генератор еще должен записать; is_leave - осталось закрыть вопрос
+struct AkinatorBenchGenFrame {
+    size_t leaf_count;
+    size_t depth;
+
+    bool is_leave;
+};
+
+struct AkinatorBenchGenStack {
+    AkinatorBenchGenFrame* frames;
+    size_t size;
+    size_t capacity;
+};
+
+/// Листья, на которых меряются поиск, сравнение и спуск; выбираются через равные промежутки в прямом обходе.
+/// Списки ответов выделяются поиском и освобождаются в конце итерации
+struct AkinatorBenchSamples {
+    TreeNode* leaves[AKINATOR_BENCH_SAMPLE_COUNT];
+    char* ans_lists[AKINATOR_BENCH_SAMPLE_COUNT];
+    size_t count;
+
+    size_t node_count;
+    size_t leaf_count;
+};
+
+bool AkinatorBenchParseShape(const char* shape_name, AkinatorBenchShape* shape) {
+    assert(shape_name != NULL);
+    assert(shape != NULL);
+
+    if (strcmp(shape_name, "balanced") == 0) {
+        *shape = AKINATOR_BENCH_BALANCED;
+    }
+    else if (strcmp(shape_name, "chain") == 0) {
+        *shape = AKINATOR_BENCH_CHAIN;
+    }
+    else if (strcmp(shape_name, "skewed") == 0) {
+        *shape = AKINATOR_BENCH_SKEWED;
+    }
+    else {
+        return false;
+    }
+
+    return true;
+}
+
+static uint64_t AkinatorBenchRandom(uint64_t* state) {
+    assert(state != NULL);
+
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+static bool AkinatorBenchGenPush(AkinatorBenchGenStack* stack, size_t leaf_count, size_t depth, bool is_leave) {
+    assert(stack != NULL);
+
+    if (stack->size == stack->capacity) {
+        size_t new_capacity = (stack->capacity == 0) ? AKINATOR_BENCH_START_CAPACITY : stack->capacity * 2;
+
+        AkinatorBenchGenFrame* new_frames = (AkinatorBenchGenFrame*)realloc(stack->frames, new_capacity * sizeof(AkinatorBenchGenFrame));
+        if (new_frames == NULL) {
+            return false;
+        }
+
+        stack->frames = new_frames;
+        stack->capacity = new_capacity;
+    }
+
+    stack->frames[stack->size++] = {leaf_count, depth, is_leave};
+
+    return true;
+}
+
+static void AkinatorBenchPrintTabs(FILE* database_file, size_t tab_count) {
+    assert(database_file != NULL);
+
+    if (tab_count > MAX_INDENT_DEPTH) {
+        tab_count = MAX_INDENT_DEPTH;
+    }
+
+    for (size_t tab_i = 0; tab_i < tab_count; tab_i++) {
+        fputc('\t', database_file);
+    }
+}
+
+/// Пишет "<prefix> <id>" и добавляет через пробел случайные буквы, пока значение короче value_len байт
+static void AkinatorBenchPrintValue(FILE* database_file, size_t depth, const char* prefix, size_t id, size_t value_len, uint64_t* random_state) {
+    assert(database_file != NULL);
+    assert(prefix != NULL);
+    assert(random_state != NULL);
+
+    AkinatorBenchPrintTabs(database_file, depth);
+
+    size_t len = (size_t)fprintf(database_file, "%s %lu", prefix, id);
+
+    if (len + 1 < value_len) {
+        fputc(' ', database_file);
+        len++;
+    }
+
+    for (; len < value_len; len++) {
+        fputc('a' + (int)(AkinatorBenchRandom(random_state) % 26), database_file);
+    }
+
+    fputc('\n', database_file);
+}
+
+/// Сколько листьев из leaf_count > 1 уходит в левое поддерево (ответ "нет")
+static size_t AkinatorBenchSplit(size_t leaf_count, AkinatorBenchShape shape, uint64_t* random_state) {
+    assert(leaf_count > 1);
+    assert(random_state != NULL);
+
+    switch (shape) {
+        case AKINATOR_BENCH_CHAIN:
+            return 1;
+        case AKINATOR_BENCH_SKEWED: {
+            size_t percent = 5 + AkinatorBenchRandom(random_state) % 46;
+
+            size_t left_count = leaf_count * percent / 100;
+            if (left_count == 0) {
+                left_count = 1;
+            }
+
+            return (AkinatorBenchRandom(random_state) % 2 == 0) ? left_count : leaf_count - left_count;
+        }
+        case AKINATOR_BENCH_BALANCED:
+        default:
+            return leaf_count / 2;
+    }
+}
+
+AkinatorError AkinatorBenchGenerate(const char* database_file_name, size_t leaf_count, AkinatorBenchShape shape, size_t value_len) {
+    assert(database_file_name != NULL);
+
+    if (leaf_count == 0 || value_len > MAX_NAME_LEN) {
+        return AKINATOR_BENCH_ERROR;
+    }
+
+    AkinatorBenchGenStack stack = {};
+    if (!AkinatorBenchGenPush(&stack, leaf_count, 0, false)) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    FILE* database_file = fopen(database_file_name, "w");
+    if (database_file == NULL) {
+        PROTECTED_FREE(stack.frames);
+        return AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    setvbuf(database_file, NULL, _IOFBF, AKINATOR_BENCH_BUFFER_SIZE);
+
+    uint64_t random_state = AKINATOR_BENCH_SEED;
+    size_t leaf_id = 0;
+    size_t question_id = 0;
+
+    AkinatorError generate_err = AKINATOR_OK;
+
+    while (stack.size > 0) {
+        AkinatorBenchGenFrame frame = stack.frames[--stack.size];
+
+        if (frame.is_leave) {
+            AkinatorBenchPrintTabs(database_file, frame.depth);
+            fputs("}\n", database_file);
+            continue;
+        }
+
+        AkinatorBenchPrintTabs(database_file, frame.depth);
+        fputs("{\n", database_file);
+
+        if (frame.leaf_count == 1) {
+            AkinatorBenchPrintValue(database_file, frame.depth, "объект", leaf_id++, value_len, &random_state);
+
+            for (size_t child_i = 0; child_i < 2; child_i++) {
+                AkinatorBenchPrintTabs(database_file, frame.depth + 1);
+                fputs("{nil}\n", database_file);
+            }
+
+            AkinatorBenchPrintTabs(database_file, frame.depth);
+            fputs("}\n", database_file);
+            continue;
+        }
+
+        AkinatorBenchPrintValue(database_file, frame.depth, "признак", question_id++, value_len, &random_state);
+
+        size_t left_count = AkinatorBenchSplit(frame.leaf_count, shape, &random_state);
+
+        if (!AkinatorBenchGenPush(&stack, 0, frame.depth, true)
+            || !AkinatorBenchGenPush(&stack, frame.leaf_count - left_count, frame.depth + 1, false)
+            || !AkinatorBenchGenPush(&stack, left_count, frame.depth + 1, false)) {
+            generate_err = AKINATOR_NODE_ALLOC_ERROR;
+            break;
+        }
+    }
+
+    PROTECTED_FREE(stack.frames);
+
+    if (fclose(database_file) != 0 && generate_err == AKINATOR_OK) {
+        generate_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    return generate_err;
+}
+
+/// При stride == 0 только считает вершины и листья, иначе берет каждый stride-й лист
+static bool AkinatorBenchWalk(TreeNode* first_node, AkinatorBenchSamples* samples, size_t stride) {
+    assert(first_node != NULL);
+    assert(samples != NULL);
+
+    size_t stack_capacity = AKINATOR_BENCH_START_CAPACITY;
+    size_t stack_size = 0;
+    TreeNode** stack = (TreeNode**)calloc(stack_capacity, sizeof(TreeNode*));
+    if (stack == NULL) {
+        return false;
+    }
+
+    stack[stack_size++] = first_node;
+
+    size_t leaf_i = 0;
+
+    while (stack_size > 0) {
+        TreeNode* node = stack[--stack_size];
+        TreeNode* left = TreeNodeGetLeft(node);
+        TreeNode* right = TreeNodeGetRight(node);
+
+        if (stride == 0) {
+            samples->node_count++;
+        }
+
+        if (left == NULL && right == NULL) {
+            if (stride == 0) {
+                samples->leaf_count++;
+            }
+            else if (leaf_i % stride == 0 && samples->count < AKINATOR_BENCH_SAMPLE_COUNT) {
+                samples->leaves[samples->count++] = node;
+            }
+
+            leaf_i++;
+            continue;
+        }
+
+        if (stack_size + 2 > stack_capacity) {
+            TreeNode** new_stack = (TreeNode**)realloc(stack, 2 * stack_capacity * sizeof(TreeNode*));
+            if (new_stack == NULL) {
+                PROTECTED_FREE(stack);
+                return false;
+            }
+
+            stack = new_stack;
+            stack_capacity *= 2;
+        }
+
+        if (right != NULL) {
+            stack[stack_size++] = right;
+        }
+
+        if (left != NULL) {
+            stack[stack_size++] = left;
+        }
+    }
+
+    PROTECTED_FREE(stack);
+
+    return true;
+}
+
+static bool AkinatorBenchSample(TreeNode* first_node, AkinatorBenchSamples* samples) {
+    assert(first_node != NULL);
+    assert(samples != NULL);
+
+    samples->count = 0;
+    samples->node_count = 0;
+    samples->leaf_count = 0;
+    memset(samples->ans_lists, 0, sizeof(samples->ans_lists));
+
+    if (!AkinatorBenchWalk(first_node, samples, 0)) {
+        return false;
+    }
+
+    size_t stride = samples->leaf_count / AKINATOR_BENCH_SAMPLE_COUNT;
+
+    return AkinatorBenchWalk(first_node, samples, (stride == 0) ? 1 : stride);
+}
+
+/// Поиск и сравнение повторяют работу AkinatorFind и AkinatorCompare без ввода и печати
+static void AkinatorBenchQueries(Akinator* akinator, AkinatorBenchSamples* samples, uint64_t durations[AKINATOR_BENCH_OPERATION_COUNT], uint64_t* sink) {
+    assert(akinator != NULL);
+    assert(samples != NULL);
+    assert(durations != NULL);
+    assert(sink != NULL);
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    uint64_t start_ns = MetricsNow();
+
+    for (size_t sample_i = 0; sample_i < samples->count; sample_i++) {
+        TreeNode* leaf = AkinatorResolveName(akinator, TreeNodeGetValue(samples->leaves[sample_i]));
+        size_t ans_list_len = 0;
+        if (leaf != NULL && AkinatorGetAnswerList(first_node, leaf, &samples->ans_lists[sample_i], &ans_list_len) == AKINATOR_OK) {
+            *sink += ans_list_len;
+        }
+    }
+
+    durations[AKINATOR_BENCH_FIND] = MetricsNow() - start_ns;
+
+    start_ns = MetricsNow();
+
+    for (size_t sample_i = 0; sample_i < samples->count / 2; sample_i++) {
+        TreeNode* leaf1 = AkinatorResolveName(akinator, TreeNodeGetValue(samples->leaves[sample_i]));
+        TreeNode* leaf2 = AkinatorResolveName(akinator, TreeNodeGetValue(samples->leaves[samples->count - 1 - sample_i]));
+        if (leaf1 == NULL || leaf2 == NULL) {
+            continue;
+        }
+
+        char* ans_list1 = NULL;
+        char* ans_list2 = NULL;
+        size_t ans_list1_len = 0;
+        size_t ans_list2_len = 0;
+
+        if (AkinatorGetAnswerList(first_node, leaf1, &ans_list1, &ans_list1_len) == AKINATOR_OK
+            && AkinatorGetAnswerList(first_node, leaf2, &ans_list2, &ans_list2_len) == AKINATOR_OK) {
+            size_t common_ans_cnt = 0;
+            while (ans_list1[common_ans_cnt] != '\0' && ans_list1[common_ans_cnt] == ans_list2[common_ans_cnt]) {
+                common_ans_cnt++;
+            }
+
+            *sink += common_ans_cnt;
+        }
+
+        PROTECTED_FREE(ans_list1);
+        PROTECTED_FREE(ans_list2);
+    }
+
+    durations[AKINATOR_BENCH_COMPARE] = MetricsNow() - start_ns;
+
+    start_ns = MetricsNow();
+
+    for (size_t sample_i = 0; sample_i < samples->count; sample_i++) {
+        if (samples->ans_lists[sample_i] == NULL) {
+            continue;
+        }
+
+        TreeNode* node = first_node;
+
+        for (const char* answer = samples->ans_lists[sample_i]; *answer != '\0'; answer++) {
+            node = (*answer == 'n') ? TreeNodeGetLeft(node) : TreeNodeGetRight(node);
+        }
+
+        *sink += (unsigned char)TreeNodeGetValue(node)[0];
+    }
+
+    durations[AKINATOR_BENCH_DESCENT] = MetricsNow() - start_ns;
+}
+
+static AkinatorError AkinatorBenchIteration(const char* database_file_name, const char* save_file_name, AkinatorBenchSamples* samples,
+                                            uint64_t durations[AKINATOR_BENCH_OPERATION_COUNT], uint64_t* sink) {
+    assert(database_file_name != NULL);
+    assert(save_file_name != NULL);
+    assert(samples != NULL);
+    assert(durations != NULL);
+    assert(sink != NULL);
+
+    Akinator akinator = {};
+
+    uint64_t start_ns = MetricsNow();
+
+    AkinatorError bench_err = AkinatorTreeInit(&akinator);
+    if (bench_err == AKINATOR_OK) {
+        bench_err = AkinatorTreeLoadFile(&akinator, database_file_name);
+    }
+
+    durations[AKINATOR_BENCH_LOAD] = MetricsNow() - start_ns;
+
+    if (bench_err == AKINATOR_OK && !AkinatorBenchSample(TreeNodeGetLeft(TreeGetRoot(&akinator.tree)), samples)) {
+        bench_err = AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    if (bench_err == AKINATOR_OK) {
+        start_ns = MetricsNow();
+        TreeError verify_err = TreeVerefy(&akinator.tree);
+        durations[AKINATOR_BENCH_VERIFY] = MetricsNow() - start_ns;
+
+        if (verify_err != TREE_OK) {
+            bench_err = AKINATOR_TREE_ERROR;
+        }
+    }
+
+    if (bench_err == AKINATOR_OK) {
+        AkinatorBenchQueries(&akinator, samples, durations, sink);
+
+        akinator.synced_file_name[0] = '\0';
+
+        start_ns = MetricsNow();
+        bench_err = AkinatorTreeSaveFile(&akinator, save_file_name);
+        durations[AKINATOR_BENCH_SAVE] = MetricsNow() - start_ns;
+    }
+
+    if (bench_err == AKINATOR_OK && samples->node_count <= AKINATOR_BENCH_MAX_DUMP_NODES) {
+        start_ns = MetricsNow();
+        TREE_DUMP(&akinator.tree);
+        durations[AKINATOR_BENCH_DUMP] = MetricsNow() - start_ns;
+    }
+
+    for (size_t sample_i = 0; sample_i < AKINATOR_BENCH_SAMPLE_COUNT; sample_i++) {
+        PROTECTED_FREE(samples->ans_lists[sample_i]);
+    }
+
+    start_ns = MetricsNow();
+    AkinatorTreeDestroy(&akinator);
+    durations[AKINATOR_BENCH_DESTROY] = MetricsNow() - start_ns;
+
+    return bench_err;
+}
+
+static int AkinatorBenchCompareNs(const void* first, const void* second) {
+    assert(first != NULL);
+    assert(second != NULL);
+
+    uint64_t first_ns = *(const uint64_t*)first;
+    uint64_t second_ns = *(const uint64_t*)second;
+
+    return (first_ns < second_ns) ? -1 : (first_ns > second_ns);
+}
+
+static void AkinatorBenchReport(FILE* csv_file, const char* database_file_name, AkinatorBenchSamples* samples,
+                                AkinatorBenchOperation operation, uint64_t* durations, size_t repeat_count) {
+    assert(csv_file != NULL);
+    assert(database_file_name != NULL);
+    assert(samples != NULL);
+    assert(durations != NULL);
+
+    qsort(durations, repeat_count, sizeof(uint64_t), AkinatorBenchCompareNs);
+
+    uint64_t sum_ns = 0;
+    for (size_t repeat_i = 0; repeat_i < repeat_count; repeat_i++) {
+        sum_ns += durations[repeat_i];
+    }
+
+    size_t op_count = 1;
+    if (operation == AKINATOR_BENCH_FIND || operation == AKINATOR_BENCH_DESCENT) {
+        op_count = samples->count;
+    }
+    else if (operation == AKINATOR_BENCH_COMPARE) {
+        op_count = samples->count / 2;
+    }
+
+    if (op_count == 0) {
+        op_count = 1;
+    }
+
+    uint64_t median_ns = durations[repeat_count / 2];
+    double mean_ns = (double)sum_ns / (double)repeat_count;
+    double median_op_ns = (double)median_ns / (double)op_count;
+
+    fprintf(csv_file, "%s,%lu,%lu,%s,%lu,%lu,%lu,%lu,%.0f,%lu,%.1f\n", database_file_name, samples->node_count, samples->leaf_count,
+            AKINATOR_BENCH_OPERATION_NAMES[operation], op_count, repeat_count,
+            durations[0], median_ns, mean_ns, durations[repeat_count - 1], median_op_ns);
+
+    printf("%-8s медиана %12.3f мс, на операцию %12.1f нс\n", AKINATOR_BENCH_OPERATION_NAMES[operation], (double)median_ns / 1e6, median_op_ns);
+}
+
+AkinatorError AkinatorBenchRun(const char* database_file_name, const char* csv_file_name, size_t repeat_count, size_t warmup_count) {
+    assert(database_file_name != NULL);
+    assert(csv_file_name != NULL);
+
+    char save_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    if (repeat_count == 0 || strlen(database_file_name) + sizeof(AKINATOR_BENCH_SAVE_SUFFIX) > sizeof(save_file_name)) {
+        return AKINATOR_BENCH_ERROR;
+    }
+
+    snprintf(save_file_name, sizeof(save_file_name), "%s%s", database_file_name, AKINATOR_BENCH_SAVE_SUFFIX);
+
+    AkinatorBenchSamples* samples = (AkinatorBenchSamples*)calloc(1, sizeof(AkinatorBenchSamples));
+    uint64_t* durations = (uint64_t*)calloc(AKINATOR_BENCH_OPERATION_COUNT * repeat_count, sizeof(uint64_t));
+
+    if (samples == NULL || durations == NULL) {
+        PROTECTED_FREE(samples);
+        PROTECTED_FREE(durations);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorError bench_err = AKINATOR_OK;
+    uint64_t sink = 0;
+
+    for (size_t iteration_i = 0; iteration_i < warmup_count + repeat_count && bench_err == AKINATOR_OK; iteration_i++) {
+        uint64_t iteration_durations[AKINATOR_BENCH_OPERATION_COUNT] = {};
+
+        bench_err = AkinatorBenchIteration(database_file_name, save_file_name, samples, iteration_durations, &sink);
+
+        if (iteration_i < warmup_count) {
+            continue;
+        }
+
+        for (size_t operation_i = 0; operation_i < AKINATOR_BENCH_OPERATION_COUNT; operation_i++) {
+            durations[operation_i * repeat_count + iteration_i - warmup_count] = iteration_durations[operation_i];
+        }
+    }
+
+    remove(save_file_name);
+
+    FILE* csv_file = (bench_err == AKINATOR_OK) ? fopen(csv_file_name, "a") : NULL;
+    if (bench_err == AKINATOR_OK && csv_file == NULL) {
+        bench_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    if (csv_file != NULL) {
+        fseek(csv_file, 0, SEEK_END);
+        if (ftell(csv_file) == 0) {
+            fprintf(csv_file, "database,nodes,leaves,operation,ops_per_sample,samples,min_ns,median_ns,mean_ns,max_ns,median_ns_per_op\n");
+        }
+
+        printf("%s: вершин %lu, листьев %lu (контрольная сумма %lu)\n", database_file_name, samples->node_count, samples->leaf_count, sink);
+
+        for (size_t operation_i = 0; operation_i < AKINATOR_BENCH_OPERATION_COUNT; operation_i++) {
+            AkinatorBenchOperation operation = (AkinatorBenchOperation)operation_i;
+
+            if (operation == AKINATOR_BENCH_DUMP && samples->node_count > AKINATOR_BENCH_MAX_DUMP_NODES) {
+                continue;
+            }
+
+            AkinatorBenchReport(csv_file, database_file_name, samples, operation, &durations[operation_i * repeat_count], repeat_count);
+        }
+
+        fclose(csv_file);
+    }
+
+    PROTECTED_FREE(samples);
+    PROTECTED_FREE(durations);
+
+    return bench_err;
+}
@@ -0,0 +1,513 @@
+#include "akinator_compressed.hpp"
+
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "utils.hpp"
+
+/// Буфер в памяти, куда собирается весь файл перед одной записью
+struct AkinatorCompressedWriter {
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+};
+
+struct AkinatorCompressedReader {
+    const unsigned char* data;
+    size_t pos;
+    size_t size;
+};
+
+/// Вершина, у которой еще не прочитаны дети
+struct AkinatorCompressedFrame {
+    TreeNode* node;
+
+    bool is_left_pending;
+    bool is_right_pending;
+};
+
+static bool AkinatorCompressedReserve(AkinatorCompressedWriter* writer, size_t len) {
+    assert(writer != NULL);
+
+    if (writer->size + len <= writer->capacity) {
+        return true;
+    }
+
+    size_t new_capacity = (writer->capacity == 0) ? AKINATOR_COMPRESSED_START_CAPACITY : writer->capacity;
+    while (new_capacity < writer->size + len) {
+        new_capacity *= 2;
+    }
+
+    unsigned char* new_data = (unsigned char*)realloc(writer->data, new_capacity);
+    if (new_data == NULL) {
+        return false;
+    }
+
+    writer->data = new_data;
+    writer->capacity = new_capacity;
+
+    return true;
+}
+
+static bool AkinatorCompressedWriteBytes(AkinatorCompressedWriter* writer, const void* bytes, size_t len) {
+    assert(writer != NULL);
+    assert(bytes != NULL || len == 0);
+
+    if (!AkinatorCompressedReserve(writer, len)) {
+        return false;
+    }
+
+    if (len != 0) {
+        memcpy(writer->data + writer->size, bytes, len);
+        writer->size += len;
+    }
+
+    return true;
+}
+
+static bool AkinatorCompressedWriteVarint(AkinatorCompressedWriter* writer, uint64_t value) {
+    assert(writer != NULL);
+
+    unsigned char bytes[AKINATOR_COMPRESSED_MAX_VARINT_LEN] = {};
+    size_t len = 0;
+
+    do {
+        bytes[len] = (unsigned char)(value & 0x7F);
+        value >>= 7;
+
+        if (value != 0) {
+            bytes[len] |= 0x80;
+        }
+
+        len++;
+    } while (value != 0);
+
+    return AkinatorCompressedWriteBytes(writer, bytes, len);
+}
+
+static bool AkinatorCompressedReadVarint(AkinatorCompressedReader* reader, uint64_t* value) {
+    assert(reader != NULL);
+    assert(value != NULL);
+
+    *value = 0;
+
+    for (size_t shift = 0; shift < 7 * AKINATOR_COMPRESSED_MAX_VARINT_LEN; shift += 7) {
+        if (reader->pos == reader->size) {
+            return false;
+        }
+
+        unsigned char byte = reader->data[reader->pos++];
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int AkinatorCompressedCompareStrings(const void* first, const void* second) {
+    return strcmp(*(const char* const*)first, *(const char* const*)second);
+}
+
+/// Собирает вершины в прямом порядке обхода без рекурсии
+static TreeNode** AkinatorCompressedCollect(TreeNode* first_node, size_t* node_count) {
+    assert(first_node != NULL);
+    assert(node_count != NULL);
+
+    TreeNode** nodes = NULL;
+    size_t nodes_size = 0;
+    size_t nodes_capacity = 0;
+
+    TreeNode** stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    TreeNode* node = first_node;
+
+    while (node != NULL) {
+        if (nodes_size == nodes_capacity) {
+            nodes_capacity = (nodes_capacity == 0) ? AKINATOR_COMPRESSED_START_CAPACITY : 2 * nodes_capacity;
+
+            TreeNode** new_nodes = (TreeNode**)realloc(nodes, nodes_capacity * sizeof(TreeNode*));
+            if (new_nodes == NULL) {
+                PROTECTED_FREE(nodes);
+                PROTECTED_FREE(stack);
+                return NULL;
+            }
+
+            nodes = new_nodes;
+        }
+
+        if (stack_size == stack_capacity) {
+            stack_capacity = (stack_capacity == 0) ? AKINATOR_COMPRESSED_START_CAPACITY : 2 * stack_capacity;
+
+            TreeNode** new_stack = (TreeNode**)realloc(stack, stack_capacity * sizeof(TreeNode*));
+            if (new_stack == NULL) {
+                PROTECTED_FREE(nodes);
+                PROTECTED_FREE(stack);
+                return NULL;
+            }
+
+            stack = new_stack;
+        }
+
+        nodes[nodes_size++] = node;
+
+        if (TreeNodeGetRight(node) != NULL) {
+            stack[stack_size++] = TreeNodeGetRight(node);
+        }
+
+        if (TreeNodeGetLeft(node) != NULL) {
+            node = TreeNodeGetLeft(node);
+        }
+        else {
+            node = (stack_size == 0) ? NULL : stack[--stack_size];
+        }
+    }
+
+    PROTECTED_FREE(stack);
+
+    *node_count = nodes_size;
+
+    return nodes;
+}
+
+static size_t AkinatorCompressedCommonPrefix(const char* first, const char* second) {
+    assert(first != NULL);
+    assert(second != NULL);
+
+    size_t len = 0;
+    while (first[len] != '\0' && first[len] == second[len]) {
+        len++;
+    }
+
+    return len;
+}
+
+static bool AkinatorCompressedWriteDictionary(AkinatorCompressedWriter* writer, const char** dictionary, size_t dictionary_size) {
+    assert(writer != NULL);
+    assert(dictionary != NULL);
+
+    if (!AkinatorCompressedWriteVarint(writer, dictionary_size)) {
+        return false;
+    }
+
+    const char* previous = "";
+
+    for (size_t string_i = 0; string_i < dictionary_size; string_i++) {
+        size_t prefix_len = AkinatorCompressedCommonPrefix(previous, dictionary[string_i]);
+        size_t suffix_len = strlen(dictionary[string_i] + prefix_len);
+
+        if (!AkinatorCompressedWriteVarint(writer, prefix_len)
+            || !AkinatorCompressedWriteVarint(writer, suffix_len)
+            || !AkinatorCompressedWriteBytes(writer, dictionary[string_i] + prefix_len, suffix_len)) {
+            return false;
+        }
+
+        previous = dictionary[string_i];
+    }
+
+    return true;
+}
+
+static bool AkinatorCompressedWriteShape(AkinatorCompressedWriter* writer, TreeNode** nodes, size_t node_count) {
+    assert(writer != NULL);
+    assert(nodes != NULL);
+
+    size_t shape_size = (2 * node_count + 7) / 8;
+
+    if (!AkinatorCompressedReserve(writer, shape_size)) {
+        return false;
+    }
+
+    unsigned char* shape = writer->data + writer->size;
+    memset(shape, 0, shape_size);
+
+    for (size_t node_i = 0; node_i < node_count; node_i++) {
+        if (TreeNodeGetLeft(nodes[node_i]) != NULL) {
+            shape[(2 * node_i) / 8] |= (unsigned char)(1 << ((2 * node_i) % 8));
+        }
+
+        if (TreeNodeGetRight(nodes[node_i]) != NULL) {
+            shape[(2 * node_i + 1) / 8] |= (unsigned char)(1 << ((2 * node_i + 1) % 8));
+        }
+    }
+
+    writer->size += shape_size;
+
+    return true;
+}
+
+static AkinatorError AkinatorCompressedEncode(AkinatorCompressedWriter* writer, TreeNode** nodes, size_t node_count) {
+    assert(writer != NULL);
+    assert(nodes != NULL);
+
+    const char** dictionary = (const char**)calloc(node_count, sizeof(const char*));
+    if (dictionary == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    for (size_t node_i = 0; node_i < node_count; node_i++) {
+        dictionary[node_i] = TreeNodeGetValue(nodes[node_i]);
+    }
+
+    qsort(dictionary, node_count, sizeof(const char*), AkinatorCompressedCompareStrings);
+
+    size_t dictionary_size = 0;
+    for (size_t string_i = 0; string_i < node_count; string_i++) {
+        if (dictionary_size == 0 || strcmp(dictionary[dictionary_size - 1], dictionary[string_i]) != 0) {
+            dictionary[dictionary_size++] = dictionary[string_i];
+        }
+    }
+
+    bool is_written = AkinatorCompressedWriteBytes(writer, AKINATOR_COMPRESSED_MAGIC, AKINATOR_COMPRESSED_MAGIC_LEN)
+                      && AkinatorCompressedWriteVarint(writer, node_count)
+                      && AkinatorCompressedWriteDictionary(writer, dictionary, dictionary_size)
+                      && AkinatorCompressedWriteShape(writer, nodes, node_count);
+
+    for (size_t node_i = 0; is_written && node_i < node_count; node_i++) {
+        const char* value = TreeNodeGetValue(nodes[node_i]);
+
+        const char** found = (const char**)bsearch(&value, dictionary, dictionary_size, sizeof(const char*),
+                                                   AkinatorCompressedCompareStrings);
+        assert(found != NULL);
+
+        is_written = AkinatorCompressedWriteVarint(writer, (size_t)(found - dictionary));
+    }
+
+    PROTECTED_FREE(dictionary);
+
+    return is_written ? AKINATOR_OK : AKINATOR_NODE_ALLOC_ERROR;
+}
+
+AkinatorError AkinatorCompressedSave(TreeNode* first_node, FILE* compressed_file) {
+    assert(first_node != NULL);
+    assert(compressed_file != NULL);
+
+    size_t node_count = 0;
+    TreeNode** nodes = AkinatorCompressedCollect(first_node, &node_count);
+    if (nodes == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorCompressedWriter writer = {};
+    AkinatorError save_err = AkinatorCompressedEncode(&writer, nodes, node_count);
+
+    if (save_err == AKINATOR_OK && fwrite(writer.data, 1, writer.size, compressed_file) != writer.size) {
+        save_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    PROTECTED_FREE(writer.data);
+    PROTECTED_FREE(nodes);
+
+    return save_err;
+}
+
+/// Раскладывает словарь в один буфер: строка номер i лежит с offsets[i] и заканчивается нулем
+static AkinatorError AkinatorCompressedReadDictionary(AkinatorCompressedReader* reader, char** chars, size_t** offsets, size_t* dictionary_size) {
+    assert(reader != NULL);
+    assert(chars != NULL);
+    assert(offsets != NULL);
+    assert(dictionary_size != NULL);
+
+    uint64_t string_count = 0;
+    if (!AkinatorCompressedReadVarint(reader, &string_count) || string_count > reader->size - reader->pos) {
+        return AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    *offsets = (size_t*)calloc(string_count + 1, sizeof(size_t));
+    if (*offsets == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    size_t chars_size = 0;
+    size_t chars_capacity = 0;
+    size_t previous_len = 0;
+
+    for (size_t string_i = 0; string_i < string_count; string_i++) {
+        uint64_t prefix_len = 0;
+        uint64_t suffix_len = 0;
+
+        if (!AkinatorCompressedReadVarint(reader, &prefix_len) || !AkinatorCompressedReadVarint(reader, &suffix_len)
+            || prefix_len > previous_len || suffix_len > reader->size - reader->pos) {
+            return AKINATOR_DATABASE_PARSE_ERROR;
+        }
+
+        size_t len = prefix_len + suffix_len;
+
+        if (chars_size + len + 1 > chars_capacity) {
+            size_t new_capacity = (chars_capacity == 0) ? AKINATOR_COMPRESSED_START_CAPACITY : 2 * chars_capacity;
+            while (new_capacity < chars_size + len + 1) {
+                new_capacity *= 2;
+            }
+
+            char* new_chars = (char*)realloc(*chars, new_capacity);
+            if (new_chars == NULL) {
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+
+            *chars = new_chars;
+            chars_capacity = new_capacity;
+        }
+
+        if (string_i > 0) {
+            memcpy(*chars + chars_size, *chars + (*offsets)[string_i - 1], prefix_len);
+        }
+        memcpy(*chars + chars_size + prefix_len, reader->data + reader->pos, suffix_len);
+        (*chars)[chars_size + len] = '\0';
+
+        reader->pos += suffix_len;
+
+        (*offsets)[string_i] = chars_size;
+        chars_size += len + 1;
+        previous_len = len;
+    }
+
+    (*offsets)[string_count] = chars_size;
+    *dictionary_size = string_count;
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorCompressedBuild(Tree* tree, AkinatorCompressedReader* reader, const char* chars,
+                                             const size_t* offsets, size_t dictionary_size, size_t node_count) {
+    assert(tree != NULL);
+    assert(reader != NULL);
+    assert(offsets != NULL);
+
+    size_t shape_size = (2 * node_count + 7) / 8;
+    if (shape_size > reader->size - reader->pos) {
+        return AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    const unsigned char* shape = reader->data + reader->pos;
+    reader->pos += shape_size;
+
+    AkinatorCompressedFrame* stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    AkinatorError build_err = AKINATOR_OK;
+
+    for (size_t node_i = 0; node_i < node_count && build_err == AKINATOR_OK; node_i++) {
+        uint64_t string_id = 0;
+        if (!AkinatorCompressedReadVarint(reader, &string_id) || string_id >= dictionary_size) {
+            build_err = AKINATOR_DATABASE_PARSE_ERROR;
+            break;
+        }
+
+        TreeNode* node = TreeNodeInit(TreeString(chars + offsets[string_id], offsets[string_id + 1] - offsets[string_id] - 1));
+        if (node == NULL) {
+            build_err = AKINATOR_NODE_ALLOC_ERROR;
+            break;
+        }
+
+        while (stack_size > 0 && !stack[stack_size - 1].is_left_pending && !stack[stack_size - 1].is_right_pending) {
+            stack_size--;
+        }
+
+        if (node_i == 0) {
+            TreeNodeLinkLeft(TreeGetRoot(tree), node);
+        }
+        else if (stack_size == 0) {
+            TreeNodeDestroy(&node);
+            build_err = AKINATOR_DATABASE_PARSE_ERROR;
+            break;
+        }
+        else if (stack[stack_size - 1].is_left_pending) {
+            TreeNodeLinkLeft(stack[stack_size - 1].node, node);
+            stack[stack_size - 1].is_left_pending = false;
+        }
+        else {
+            TreeNodeLinkRight(stack[stack_size - 1].node, node);
+            stack[stack_size - 1].is_right_pending = false;
+        }
+
+        tree->size++;
+
+        bool has_left = (shape[(2 * node_i) / 8] >> ((2 * node_i) % 8)) & 1;
+        bool has_right = (shape[(2 * node_i + 1) / 8] >> ((2 * node_i + 1) % 8)) & 1;
+
+        if (!has_left && !has_right) {
+            continue;
+        }
+
+        if (stack_size == stack_capacity) {
+            size_t new_capacity = (stack_capacity == 0) ? AKINATOR_COMPRESSED_START_CAPACITY : 2 * stack_capacity;
+
+            AkinatorCompressedFrame* new_stack = (AkinatorCompressedFrame*)realloc(stack, new_capacity * sizeof(AkinatorCompressedFrame));
+            if (new_stack == NULL) {
+                build_err = AKINATOR_NODE_ALLOC_ERROR;
+                break;
+            }
+
+            stack = new_stack;
+            stack_capacity = new_capacity;
+        }
+
+        stack[stack_size++] = {node, has_left, has_right};
+    }
+
+    for (size_t frame_i = 0; build_err == AKINATOR_OK && frame_i < stack_size; frame_i++) {
+        if (stack[frame_i].is_left_pending || stack[frame_i].is_right_pending) {
+            build_err = AKINATOR_DATABASE_PARSE_ERROR;
+        }
+    }
+
+    PROTECTED_FREE(stack);
+
+    return build_err;
+}
+
+AkinatorError AkinatorCompressedLoad(Tree* tree, FILE* compressed_file) {
+    assert(tree != NULL);
+    assert(compressed_file != NULL);
+
+    size_t file_size = FileSize(compressed_file);
+
+    unsigned char* data = (unsigned char*)calloc(file_size + 1, 1);
+    if (data == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorCompressedReader reader = {data, 0, fread(data, 1, file_size, compressed_file)};
+
+    uint64_t node_count = 0;
+    AkinatorError load_err = AKINATOR_OK;
+
+    if (reader.size < AKINATOR_COMPRESSED_MAGIC_LEN || memcmp(data, AKINATOR_COMPRESSED_MAGIC, AKINATOR_COMPRESSED_MAGIC_LEN) != 0) {
+        load_err = AKINATOR_DATABASE_PARSE_ERROR;
+    }
+    else {
+        reader.pos = AKINATOR_COMPRESSED_MAGIC_LEN;
+
+        if (!AkinatorCompressedReadVarint(&reader, &node_count) || node_count == 0 || node_count > reader.size) {
+            load_err = AKINATOR_DATABASE_PARSE_ERROR;
+        }
+    }
+
+    char* chars = NULL;
+    size_t* offsets = NULL;
+    size_t dictionary_size = 0;
+
+    if (load_err == AKINATOR_OK) {
+        load_err = AkinatorCompressedReadDictionary(&reader, &chars, &offsets, &dictionary_size);
+    }
+
+    if (load_err == AKINATOR_OK) {
+        load_err = AkinatorCompressedBuild(tree, &reader, chars, offsets, dictionary_size, node_count);
+    }
+
+    if (load_err == AKINATOR_OK && reader.pos != reader.size) {
+        load_err = AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    PROTECTED_FREE(chars);
+    PROTECTED_FREE(offsets);
+    PROTECTED_FREE(data);
+
+    return load_err;
+}
@@ -0,0 +1,143 @@
+#include "akinator_diff.hpp"
+
+#include <assert.h>
+
+#include "tree_hash.hpp"
+#include "utils.hpp"
+
+struct AkinatorDiffEntry {
+    TreeNode* old_node;
+    TreeNode* new_node;
+
+    size_t depth;
+    char answer;
+};
+
+struct AkinatorDiffStack {
+    AkinatorDiffEntry* entries;
+    size_t size;
+    size_t capacity;
+};
+
+static bool AkinatorDiffPush(AkinatorDiffStack* stack, AkinatorDiffEntry entry) {
+    assert(stack != NULL);
+
+    if (TreeHashGet(entry.old_node) == TreeHashGet(entry.new_node)) {
+        return true;
+    }
+
+    if (stack->size == stack->capacity) {
+        size_t new_capacity = (stack->capacity == 0) ? AKINATOR_DIFF_START_STACK_CAPACITY : 2 * stack->capacity;
+
+        AkinatorDiffEntry* new_entries = (AkinatorDiffEntry*)realloc(stack->entries, new_capacity * sizeof(AkinatorDiffEntry));
+        if (new_entries == NULL) {
+            return false;
+        }
+
+        stack->entries = new_entries;
+        stack->capacity = new_capacity;
+    }
+
+    stack->entries[stack->size++] = entry;
+
+    return true;
+}
+
+static void AkinatorDiffPrintPath(const char* path, size_t depth, FILE* stream) {
+    assert(path != NULL);
+    assert(stream != NULL);
+
+    if (depth == 0) {
+        fputc('.', stream);
+        return;
+    }
+
+    fwrite(path, 1, depth, stream);
+}
+
+AkinatorError AkinatorDiff(Akinator* old_akinator, Akinator* new_akinator, FILE* stream, AkinatorDiffStats* stats) {
+    assert(old_akinator != NULL);
+    assert(new_akinator != NULL);
+    assert(stream != NULL);
+    assert(stats != NULL);
+
+    *stats = {};
+
+    AkinatorDiffStack stack = {};
+
+    char* path = NULL;
+    size_t path_capacity = 0;
+
+    TreeNode* old_first = TreeNodeGetLeft(TreeGetRoot(&old_akinator->tree));
+    TreeNode* new_first = TreeNodeGetLeft(TreeGetRoot(&new_akinator->tree));
+
+    if (!AkinatorDiffPush(&stack, {old_first, new_first, 0, '\0'})) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    while (stack.size > 0) {
+        AkinatorDiffEntry entry = stack.entries[--stack.size];
+        stats->visited_count++;
+
+        if (entry.depth > 0) {
+            if (entry.depth > path_capacity) {
+                size_t new_capacity = (path_capacity == 0) ? AKINATOR_DIFF_START_STACK_CAPACITY : 2 * path_capacity;
+                while (new_capacity < entry.depth) {
+                    new_capacity *= 2;
+                }
+
+                char* new_path = (char*)realloc(path, new_capacity);
+                if (new_path == NULL) {
+                    PROTECTED_FREE(stack.entries);
+                    PROTECTED_FREE(path);
+                    return AKINATOR_NODE_ALLOC_ERROR;
+                }
+
+                path = new_path;
+                path_capacity = new_capacity;
+            }
+
+            path[entry.depth - 1] = entry.answer;
+        }
+
+        if (entry.old_node == NULL || entry.new_node == NULL) {
+            bool is_added = (entry.old_node == NULL);
+            TreeNode* node = is_added ? entry.new_node : entry.old_node;
+
+            fprintf(stream, "%c ", is_added ? '+' : '-');
+            AkinatorDiffPrintPath(path, entry.depth, stream);
+            fprintf(stream, " \"%s\"\n", TreeNodeGetValue(node));
+
+            if (is_added) {
+                stats->added_count++;
+            }
+            else {
+                stats->removed_count++;
+            }
+
+            continue;
+        }
+
+        if (strcmp(TreeNodeGetValue(entry.old_node), TreeNodeGetValue(entry.new_node)) != 0) {
+            fprintf(stream, "~ ");
+            AkinatorDiffPrintPath(path, entry.depth, stream);
+            fprintf(stream, " \"%s\" -> \"%s\"\n", TreeNodeGetValue(entry.old_node), TreeNodeGetValue(entry.new_node));
+
+            stats->changed_count++;
+        }
+
+        bool is_pushed = AkinatorDiffPush(&stack, {TreeNodeGetRight(entry.old_node), TreeNodeGetRight(entry.new_node), entry.depth + 1, 'y'})
+                         && AkinatorDiffPush(&stack, {TreeNodeGetLeft(entry.old_node), TreeNodeGetLeft(entry.new_node), entry.depth + 1, 'n'});
+
+        if (!is_pushed) {
+            PROTECTED_FREE(stack.entries);
+            PROTECTED_FREE(path);
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+    }
+
+    PROTECTED_FREE(stack.entries);
+    PROTECTED_FREE(path);
+
+    return AKINATOR_OK;
+}
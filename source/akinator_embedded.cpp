@@ -0,0 +1,190 @@
+#include "akinator_embedded.hpp"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "utils.hpp"
+
+/// Вершина в очереди обхода генератора; номер вершины - ее место в очереди
+struct AkinatorEmbeddedEntry {
+    TreeNode* node;
+
+    size_t parent_id;
+    size_t left_id;
+    size_t right_id;
+};
+
+struct AkinatorEmbeddedQueue {
+    AkinatorEmbeddedEntry* entries;
+    size_t size;
+    size_t capacity;
+};
+
+static bool akinator_embedded_is_used = false;
+
+AkinatorError AkinatorEmbeddedLoad(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    TRACE_SCOPE("AkinatorEmbeddedLoad", TRACE_WORK);
+
+    uint64_t start_ns = MetricsNow();
+
+    if (akinator_embedded_is_used || akinator_embedded_node_count < 2) {
+        return AKINATOR_EMBEDDED_ERROR;
+    }
+
+    akinator_embedded_is_used = true;
+
+    TreeSetStaticNodes(akinator_embedded_nodes, akinator_embedded_node_count);
+
+    *akinator = {};
+    akinator->tree.root = &akinator_embedded_nodes[0];
+    akinator->tree.size = akinator_embedded_node_count - 1;
+    akinator->is_index_pending = true;
+
+    if (AkinatorHistoryInit(&akinator->history) != AKINATOR_HISTORY_OK) {
+        return AKINATOR_HISTORY_ERROR;
+    }
+
+    MetricsRecord(METRICS_LOAD, MetricsNow() - start_ns);
+
+    return AKINATOR_OK;
+}
+
+static bool AkinatorEmbeddedPush(AkinatorEmbeddedQueue* queue, TreeNode* node, size_t parent_id) {
+    assert(queue != NULL);
+    assert(node != NULL);
+
+    if (queue->size == queue->capacity) {
+        size_t new_capacity = (queue->capacity == 0) ? AKINATOR_EMBEDDED_START_CAPACITY : queue->capacity * 2;
+
+        AkinatorEmbeddedEntry* new_entries = (AkinatorEmbeddedEntry*)realloc(queue->entries, new_capacity * sizeof(AkinatorEmbeddedEntry));
+        if (new_entries == NULL) {
+            return false;
+        }
+
+        queue->entries = new_entries;
+        queue->capacity = new_capacity;
+    }
+
+    queue->entries[queue->size++] = {node, parent_id, 0, 0};
+
+    return true;
+}
+
+/// Кавычки, обратная косая черта и управляющие символы пишутся восьмеричными escape-последовательностями
+static void AkinatorEmbeddedPrintLiteral(FILE* source_file, const char* str) {
+    assert(source_file != NULL);
+    assert(str != NULL);
+
+    fputc('"', source_file);
+
+    for (const unsigned char* symbol = (const unsigned char*)str; *symbol != '\0'; symbol++) {
+        if (*symbol == '"' || *symbol == '\\' || *symbol < ' ') {
+            fprintf(source_file, "\\%03o", *symbol);
+        }
+        else {
+            fputc(*symbol, source_file);
+        }
+    }
+
+    fputc('"', source_file);
+}
+
+static void AkinatorEmbeddedPrintLink(FILE* source_file, bool is_present, size_t node_id) {
+    assert(source_file != NULL);
+
+    if (is_present) {
+        fprintf(source_file, "&akinator_embedded_nodes[%lu]", node_id);
+    }
+    else {
+        fputs("NULL", source_file);
+    }
+}
+
+static void AkinatorEmbeddedPrintNode(FILE* source_file, AkinatorEmbeddedEntry* entry, bool is_root) {
+    assert(source_file != NULL);
+    assert(entry != NULL);
+
+    TreeNode* node = entry->node;
+
+    fputs("    {", source_file);
+    AkinatorEmbeddedPrintLink(source_file, !is_root, entry->parent_id);
+    fputs(", ", source_file);
+    AkinatorEmbeddedPrintLink(source_file, TreeNodeGetLeft(node) != NULL, entry->left_id);
+    fputs(", ", source_file);
+    AkinatorEmbeddedPrintLink(source_file, TreeNodeGetRight(node) != NULL, entry->right_id);
+    fprintf(source_file, ", 0x%016lxull", node->hash);
+
+    if (!is_root) {
+        fputs(", TreeStringBorrow(), ", source_file);
+        AkinatorEmbeddedPrintLiteral(source_file, TreeNodeGetValue(node));
+        fprintf(source_file, ", %luul", node->value.Size());
+    }
+
+    fputs("},\n", source_file);
+}
+
+AkinatorError AkinatorEmbeddedGenerate(Akinator* akinator, const char* database_file_name, const char* source_file_name) {
+    assert(akinator != NULL);
+    assert(akinator->lazy == NULL);
+    assert(database_file_name != NULL);
+    assert(source_file_name != NULL);
+
+    TRACE_SCOPE("AkinatorEmbeddedGenerate", TRACE_WORK);
+
+    AkinatorEmbeddedQueue queue = {};
+    if (!AkinatorEmbeddedPush(&queue, TreeGetRoot(&akinator->tree), 0)) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    for (size_t node_id = 0; node_id < queue.size; node_id++) {
+        TreeNode* left = TreeNodeGetLeft(queue.entries[node_id].node);
+        TreeNode* right = TreeNodeGetRight(queue.entries[node_id].node);
+
+        queue.entries[node_id].left_id = queue.size;
+        if (left != NULL && !AkinatorEmbeddedPush(&queue, left, node_id)) {
+            PROTECTED_FREE(queue.entries);
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+
+        queue.entries[node_id].right_id = queue.size;
+        if (right != NULL && !AkinatorEmbeddedPush(&queue, right, node_id)) {
+            PROTECTED_FREE(queue.entries);
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+    }
+
+    FILE* source_file = fopen(source_file_name, "w");
+    if (source_file == NULL) {
+        PROTECTED_FREE(queue.entries);
+        return AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    fprintf(source_file, "/// Сгенерировано командой make embed, не редактировать вручную\n");
+    fprintf(source_file, "/// Файл хранится в репозитории, так как без него не собрать генерирующую его программу:\n");
+    fprintf(source_file, "/// после make embed его нужно закоммитить\n");
+    fprintf(source_file, "#include \"akinator_embedded.hpp\"\n\n");
+    fprintf(source_file, "const char akinator_embedded_source_name[] = ");
+    AkinatorEmbeddedPrintLiteral(source_file, database_file_name);
+    fprintf(source_file, ";\n\nconst size_t akinator_embedded_node_count = %lu;\n\n", queue.size);
+    fprintf(source_file, "TreeNode akinator_embedded_nodes[%lu] = {\n", queue.size);
+
+    for (size_t node_id = 0; node_id < queue.size; node_id++) {
+        AkinatorEmbeddedPrintNode(source_file, &queue.entries[node_id], node_id == 0);
+    }
+
+    fprintf(source_file, "};\n");
+
+    PROTECTED_FREE(queue.entries);
+
+    AkinatorError generate_err = AKINATOR_OK;
+    if (fclose(source_file) != 0) {
+        generate_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    return generate_err;
+}
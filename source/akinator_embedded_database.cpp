@@ -0,0 +1,21 @@
+/// Сгенерировано командой make embed, не редактировать вручную
+/// Файл хранится в репозитории, так как без него не собрать генерирующую его программу:
+/// после make embed его нужно закоммитить
+#include "akinator_embedded.hpp"
+
+const char akinator_embedded_source_name[] = "database.aki";
+
+const size_t akinator_embedded_node_count = 10;
+
+TreeNode akinator_embedded_nodes[10] = {
+    {NULL, &akinator_embedded_nodes[1], NULL, 0x2bcb6ef9511bbb40ull},
+    {&akinator_embedded_nodes[0], &akinator_embedded_nodes[2], &akinator_embedded_nodes[3], 0x1e0aa9804fd4ababull, TreeStringBorrow(), "играет в клэш рояль", 35ul},
+    {&akinator_embedded_nodes[1], NULL, NULL, 0xaf7b53b40cb950eeull, TreeStringBorrow(), "ничего", 12ul},
+    {&akinator_embedded_nodes[1], &akinator_embedded_nodes[4], &akinator_embedded_nodes[5], 0xd948ec85e1202e6eull, TreeStringBorrow(), "староста 1 курса", 29ul},
+    {&akinator_embedded_nodes[3], &akinator_embedded_nodes[6], &akinator_embedded_nodes[7], 0xce5a3b679c5b500dull, TreeStringBorrow(), "играет в волейбол", 32ul},
+    {&akinator_embedded_nodes[3], NULL, NULL, 0x979e2b9f6401141eull, TreeStringBorrow(), "женя р.", 12ul},
+    {&akinator_embedded_nodes[4], NULL, NULL, 0x7a2657dd723132f4ull, TreeStringBorrow(), "вова н.", 12ul},
+    {&akinator_embedded_nodes[4], &akinator_embedded_nodes[8], &akinator_embedded_nodes[9], 0xfab33d372a715653ull, TreeStringBorrow(), "ходит на хуавей", 28ul},
+    {&akinator_embedded_nodes[7], NULL, NULL, 0x456418a0e3f9f3d5ull, TreeStringBorrow(), "илья д.", 12ul},
+    {&akinator_embedded_nodes[7], NULL, NULL, 0x2bb1d495a6f74f4bull, TreeStringBorrow(), "артем а.", 14ul},
+};
@@ -0,0 +1,414 @@
+#include "akinator_eval.hpp"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "tree_parallel.hpp"
+#include "utils.hpp"
+
+struct AkinatorEvalFrame {
+    TreeNode* node;
+    size_t depth;
+};
+
+/// Все листья в порядке прямого обхода; номер листа в массиве задает его поток случайных ошибок
+struct AkinatorEvalLeaves {
+    TreeNode** leaves;
+    size_t count;
+    size_t capacity;
+
+    size_t max_depth;
+};
+
+/// Счетчики одного потока; path - истинные ответы текущей партии, переиспользуется между партиями
+struct AkinatorEvalPartial {
+    size_t* question_histogram;
+    size_t guessed_count;
+    size_t questions_sum;
+
+    AkinatorEvalGame worst[AKINATOR_EVAL_WORST_COUNT];
+    size_t worst_count;
+
+    bool* path;
+    size_t path_capacity;
+
+    bool is_alloc_failed;
+};
+
+static bool AkinatorEvalPushLeaf(AkinatorEvalLeaves* leaves, TreeNode* leaf) {
+    assert(leaves != NULL);
+    assert(leaf != NULL);
+
+    if (leaves->count == leaves->capacity) {
+        size_t new_capacity = (leaves->capacity == 0) ? AKINATOR_EVAL_START_CAPACITY : leaves->capacity * 2;
+
+        TreeNode** new_leaves = (TreeNode**)realloc(leaves->leaves, new_capacity * sizeof(TreeNode*));
+        if (new_leaves == NULL) {
+            return false;
+        }
+
+        leaves->leaves = new_leaves;
+        leaves->capacity = new_capacity;
+    }
+
+    leaves->leaves[leaves->count++] = leaf;
+
+    return true;
+}
+
+static AkinatorError AkinatorEvalCollectLeaves(TreeNode* first_node, AkinatorEvalLeaves* leaves) {
+    assert(first_node != NULL);
+    assert(leaves != NULL);
+
+    size_t stack_capacity = AKINATOR_EVAL_START_CAPACITY;
+    size_t stack_size = 0;
+    AkinatorEvalFrame* stack = (AkinatorEvalFrame*)calloc(stack_capacity, sizeof(AkinatorEvalFrame));
+    if (stack == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    stack[stack_size++] = {first_node, 0};
+
+    while (stack_size > 0) {
+        AkinatorEvalFrame frame = stack[--stack_size];
+        TreeNode* left = TreeNodeGetLeft(frame.node);
+        TreeNode* right = TreeNodeGetRight(frame.node);
+
+        if (frame.depth > leaves->max_depth) {
+            leaves->max_depth = frame.depth;
+        }
+
+        if (left == NULL && right == NULL) {
+            if (!AkinatorEvalPushLeaf(leaves, frame.node)) {
+                PROTECTED_FREE(stack);
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+
+            continue;
+        }
+
+        if (stack_size + 2 > stack_capacity) {
+            AkinatorEvalFrame* new_stack = (AkinatorEvalFrame*)realloc(stack, 2 * stack_capacity * sizeof(AkinatorEvalFrame));
+            if (new_stack == NULL) {
+                PROTECTED_FREE(stack);
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+
+            stack = new_stack;
+            stack_capacity *= 2;
+        }
+
+        if (right != NULL) {
+            stack[stack_size++] = {right, frame.depth + 1};
+        }
+
+        if (left != NULL) {
+            stack[stack_size++] = {left, frame.depth + 1};
+        }
+    }
+
+    PROTECTED_FREE(stack);
+
+    return AKINATOR_OK;
+}
+
+static uint64_t AkinatorEvalRandom(uint64_t* state) {
+    assert(state != NULL);
+
+    *state += 0x9E3779B97F4A7C15ull;
+
+    uint64_t mixed = *state;
+    mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EBull;
+
+    return mixed ^ (mixed >> 31);
+}
+
+static bool AkinatorEvalIsMistake(uint64_t* random_state, double error_rate) {
+    assert(random_state != NULL);
+
+    return error_rate > 0 && (double)(AkinatorEvalRandom(random_state) >> 11) / 9007199254740992.0 < error_rate;
+}
+
+static bool AkinatorEvalIsWorse(const AkinatorEvalGame* game, const AkinatorEvalGame* other) {
+    assert(game != NULL);
+    assert(other != NULL);
+
+    if (game->question_count != other->question_count) {
+        return game->question_count > other->question_count;
+    }
+
+    return game->leaf_i < other->leaf_i;
+}
+
+/// Вставляет партию в отсортированный список худших, если она хуже последней из них
+static void AkinatorEvalKeepWorst(AkinatorEvalGame* worst, size_t* worst_count, const AkinatorEvalGame* game) {
+    assert(worst != NULL);
+    assert(worst_count != NULL);
+    assert(game != NULL);
+
+    if (*worst_count == AKINATOR_EVAL_WORST_COUNT && !AkinatorEvalIsWorse(game, &worst[AKINATOR_EVAL_WORST_COUNT - 1])) {
+        return;
+    }
+
+    size_t game_i = (*worst_count < AKINATOR_EVAL_WORST_COUNT) ? (*worst_count)++ : AKINATOR_EVAL_WORST_COUNT - 1;
+
+    for (; game_i > 0 && AkinatorEvalIsWorse(game, &worst[game_i - 1]); game_i--) {
+        worst[game_i] = worst[game_i - 1];
+    }
+
+    worst[game_i] = *game;
+}
+
+/// Истинный путь восстанавливается подъемом по родителям, затем игра спускается от first_node через AkinatorNextNode
+static void AkinatorEvalPlay(TreeNode* first_node, TreeNode* leaf, size_t leaf_i, double error_rate, AkinatorEvalPartial* partial) {
+    assert(first_node != NULL);
+    assert(leaf != NULL);
+    assert(partial != NULL);
+
+    size_t depth = 0;
+    for (TreeNode* node = leaf; node != first_node; node = TreeNodeGetParent(node)) {
+        depth++;
+    }
+
+    if (depth > partial->path_capacity) {
+        bool* new_path = (bool*)realloc(partial->path, depth * sizeof(bool));
+        if (new_path == NULL) {
+            partial->is_alloc_failed = true;
+            return;
+        }
+
+        partial->path = new_path;
+        partial->path_capacity = depth;
+    }
+
+    size_t path_i = depth;
+    for (TreeNode* node = leaf; node != first_node; node = TreeNodeGetParent(node)) {
+        partial->path[--path_i] = TreeNodeGetRight(TreeNodeGetParent(node)) == node;
+    }
+
+    uint64_t random_state = AKINATOR_EVAL_SEED ^ leaf_i;
+    bool is_on_path = true;
+
+    TreeNode* node = first_node;
+    size_t question_count = 0;
+
+    while (TreeNodeGetLeft(node) != NULL || TreeNodeGetRight(node) != NULL) {
+        bool is_yes = false;
+
+        if (is_on_path) {
+            is_yes = partial->path[question_count];
+
+            if (AkinatorEvalIsMistake(&random_state, error_rate)) {
+                is_yes = !is_yes;
+                is_on_path = false;
+            }
+        }
+        else {
+            is_yes = AkinatorEvalRandom(&random_state) % 2 == 0;
+        }
+
+        question_count++;
+
+        TreeNode* next_node = AkinatorNextNode(node, is_yes);
+        if (next_node == NULL) {
+            break;
+        }
+
+        node = next_node;
+    }
+
+    AkinatorEvalGame game = {leaf, leaf_i, question_count, node == leaf};
+
+    partial->question_histogram[question_count]++;
+    partial->questions_sum += question_count;
+    partial->guessed_count += game.is_guessed;
+
+    AkinatorEvalKeepWorst(partial->worst, &partial->worst_count, &game);
+}
+
+static void AkinatorEvalMerge(AkinatorEvalResult* result, const AkinatorEvalPartial* partial) {
+    assert(result != NULL);
+    assert(partial != NULL);
+
+    for (size_t question_i = 0; question_i < result->histogram_size; question_i++) {
+        result->question_histogram[question_i] += partial->question_histogram[question_i];
+    }
+
+    result->guessed_count += partial->guessed_count;
+    result->questions_sum += partial->questions_sum;
+
+    for (size_t game_i = 0; game_i < partial->worst_count; game_i++) {
+        AkinatorEvalKeepWorst(result->worst, &result->worst_count, &partial->worst[game_i]);
+    }
+}
+
+AkinatorError AkinatorEvalRun(Akinator* akinator, double error_rate, AkinatorEvalResult* result) {
+    assert(akinator != NULL);
+    assert(result != NULL);
+
+    TRACE_SCOPE("AkinatorEvalRun", TRACE_WORK);
+
+    *result = {};
+
+    if (!(error_rate >= 0 && error_rate <= 1)) {
+        return AKINATOR_EVAL_ERROR;
+    }
+
+    uint64_t start_ns = MetricsNow();
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+    if (first_node == NULL) {
+        return AKINATOR_TREE_ERROR;
+    }
+
+    AkinatorEvalLeaves leaves = {};
+    AkinatorError eval_err = AkinatorEvalCollectLeaves(first_node, &leaves);
+    if (eval_err != AKINATOR_OK) {
+        PROTECTED_FREE(leaves.leaves);
+        return eval_err;
+    }
+
+    result->error_rate = error_rate;
+    result->game_count = leaves.count;
+    result->histogram_size = leaves.max_depth + 1;
+    result->question_histogram = (size_t*)calloc(result->histogram_size, sizeof(size_t));
+
+    size_t chunk_count = (leaves.count + AKINATOR_EVAL_CHUNK_SIZE - 1) / AKINATOR_EVAL_CHUNK_SIZE;
+
+    size_t thread_count = TreeParallelThreadCount();
+    if (thread_count > chunk_count) {
+        thread_count = chunk_count;
+    }
+
+    AkinatorEvalPartial* partials = (AkinatorEvalPartial*)calloc(thread_count, sizeof(AkinatorEvalPartial));
+
+    bool is_alloc_failed = result->question_histogram == NULL || partials == NULL;
+    for (size_t thread_i = 0; !is_alloc_failed && thread_i < thread_count; thread_i++) {
+        partials[thread_i].question_histogram = (size_t*)calloc(result->histogram_size, sizeof(size_t));
+        is_alloc_failed = partials[thread_i].question_histogram == NULL;
+    }
+
+    if (!is_alloc_failed) {
+        std::atomic<size_t> next_chunk(0);
+
+        auto worker = [&leaves, &next_chunk, partials, first_node, error_rate, chunk_count](size_t thread_i) {
+            for (size_t chunk_i = next_chunk++; chunk_i < chunk_count; chunk_i = next_chunk++) {
+                size_t end_i = (chunk_i + 1) * AKINATOR_EVAL_CHUNK_SIZE;
+                if (end_i > leaves.count) {
+                    end_i = leaves.count;
+                }
+
+                for (size_t leaf_i = chunk_i * AKINATOR_EVAL_CHUNK_SIZE; leaf_i < end_i; leaf_i++) {
+                    AkinatorEvalPlay(first_node, leaves.leaves[leaf_i], leaf_i, error_rate, &partials[thread_i]);
+                }
+            }
+        };
+
+        std::thread threads[TREE_PARALLEL_MAX_THREADS];
+        size_t started_count = 0;
+
+        for (; started_count + 1 < thread_count; started_count++) {
+            try {
+                threads[started_count] = std::thread(worker, started_count);
+            }
+            catch (const std::system_error&) {
+                break;
+            }
+        }
+
+        worker(thread_count - 1);
+
+        for (size_t thread_i = 0; thread_i < started_count; thread_i++) {
+            threads[thread_i].join();
+        }
+
+        result->thread_count = started_count + 1;
+
+        for (size_t thread_i = 0; thread_i < thread_count; thread_i++) {
+            is_alloc_failed = is_alloc_failed || partials[thread_i].is_alloc_failed;
+            AkinatorEvalMerge(result, &partials[thread_i]);
+        }
+    }
+
+    for (size_t thread_i = 0; partials != NULL && thread_i < thread_count; thread_i++) {
+        PROTECTED_FREE(partials[thread_i].question_histogram);
+        PROTECTED_FREE(partials[thread_i].path);
+    }
+
+    PROTECTED_FREE(partials);
+    PROTECTED_FREE(leaves.leaves);
+
+    if (is_alloc_failed) {
+        AkinatorEvalDestroy(result);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    for (size_t question_i = 0; question_i < result->histogram_size; question_i++) {
+        if (result->question_histogram[question_i] != 0) {
+            result->max_questions = question_i;
+        }
+    }
+
+    result->elapsed_ns = MetricsNow() - start_ns;
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorEvalDestroy(AkinatorEvalResult* result) {
+    assert(result != NULL);
+
+    PROTECTED_FREE(result->question_histogram);
+    *result = {};
+
+    return AKINATOR_OK;
+}
+
+size_t AkinatorEvalPercentile(const AkinatorEvalResult* result, double share) {
+    assert(result != NULL);
+    assert(share >= 0 && share <= 1);
+
+    size_t target_count = (size_t)ceil(share * (double)result->game_count);
+    size_t game_count = 0;
+
+    for (size_t question_i = 0; question_i < result->histogram_size; question_i++) {
+        game_count += result->question_histogram[question_i];
+
+        if (game_count >= target_count) {
+            return question_i;
+        }
+    }
+
+    return result->max_questions;
+}
+
+void AkinatorEvalPrint(const AkinatorEvalResult* result, FILE* stream) {
+    assert(result != NULL);
+    assert(stream != NULL);
+
+    double game_share = (result->game_count == 0) ? 0 : 100.0 / (double)result->game_count;
+    double average_questions = (result->game_count == 0) ? 0 : (double)result->questions_sum / (double)result->game_count;
+    double elapsed_ms = (double)result->elapsed_ns / 1e6;
+
+    fprintf(stream, "Партий: %lu, угадано: %lu (%.2f%%), доля ошибок оракула: %.3f\n",
+            result->game_count, result->guessed_count, (double)result->guessed_count * game_share, result->error_rate);
+    fprintf(stream, "Вопросов до ответа: в среднем %.2f, медиана %lu, 90%% партий - до %lu, 99%% - до %lu, максимум %lu\n",
+            average_questions, AkinatorEvalPercentile(result, 0.5), AkinatorEvalPercentile(result, 0.9),
+            AkinatorEvalPercentile(result, 0.99), result->max_questions);
+
+    fprintf(stream, "Дольше всего угадываются:\n");
+    for (size_t game_i = 0; game_i < result->worst_count; game_i++) {
+        const AkinatorEvalGame* game = &result->worst[game_i];
+
+        fprintf(stream, "    %s - вопросов: %lu%s\n", TreeNodeGetValue(game->leaf), game->question_count, game->is_guessed ? "" : " (не угадан)");
+    }
+
+    fprintf(stream, "Потоков: %lu, время: %.1f мс (%.0f партий в секунду)\n", result->thread_count, elapsed_ms,
+            (result->elapsed_ns == 0) ? 0 : (double)result->game_count / (elapsed_ms / 1e3));
+}
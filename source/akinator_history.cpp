@@ -0,0 +1,255 @@
+#include "akinator_history.hpp"
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "akinator.hpp"
+#include "tree_hash.hpp"
+#include "utils.hpp"
+
+const char* AkinatorHistoryStrError(AkinatorHistoryError error) {
+    switch (error) {
+        case AKINATOR_HISTORY_OK:
+            return "Выполнено без ошибок";
+        case AKINATOR_HISTORY_ALLOC_ERROR:
+            return "Не удалось выделить память под журнал обучения";
+        case AKINATOR_HISTORY_INDEX_ERROR:
+            return "Не удалось обновить индексы при отмене или повторе обучения";
+        case AKINATOR_HISTORY_UNKNOWN_SNAPSHOT:
+            return "Снимка с таким именем нет";
+        default:
+            return "Непредвиденная ошибка";
+    }
+}
+
+void AkinatorHistoryPrintError(AkinatorHistoryError error, const char* file, int line) {
+    assert(file != NULL);
+
+    fprintf(stderr, "Error in %s:%d:\n%s\n", file, line, AkinatorHistoryStrError(error));
+}
+
+AkinatorHistoryError AkinatorHistoryInit(AkinatorHistory* history) {
+    assert(history != NULL);
+
+    *history = {};
+
+    return AKINATOR_HISTORY_OK;
+}
+
+/// Освобождает вершины отмененных шагов [new_size, size); они уже отцеплены от дерева
+static void AkinatorHistoryTruncate(AkinatorHistory* history, size_t new_size) {
+    assert(history != NULL);
+    assert(new_size >= history->position);
+
+    while (history->size > new_size) {
+        AkinatorHistoryStep* step = &history->steps[--history->size];
+
+        TreeNodeDestroy(&step->new_answer);
+        TreeNodeDestroy(&step->question);
+    }
+
+    size_t kept_count = 0;
+    for (size_t snapshot_i = 0; snapshot_i < history->snapshots_size; snapshot_i++) {
+        if (history->snapshots[snapshot_i].position <= history->size) {
+            history->snapshots[kept_count++] = history->snapshots[snapshot_i];
+        }
+    }
+    history->snapshots_size = kept_count;
+}
+
+AkinatorHistoryError AkinatorHistoryDestroy(AkinatorHistory* history) {
+    assert(history != NULL);
+
+    AkinatorHistoryTruncate(history, history->position);
+
+    PROTECTED_FREE(history->steps);
+    PROTECTED_FREE(history->snapshots);
+
+    *history = {};
+
+    return AKINATOR_HISTORY_OK;
+}
+
+AkinatorHistoryError AkinatorHistoryRecord(AkinatorHistory* history, TreeNode* question, TreeNode* old_answer, TreeNode* new_answer) {
+    assert(history != NULL);
+    assert(question != NULL);
+    assert(old_answer != NULL);
+    assert(new_answer != NULL);
+
+    AkinatorHistoryTruncate(history, history->position);
+
+    if (history->size == history->capacity) {
+        size_t new_capacity = (history->capacity == 0) ? AKINATOR_HISTORY_START_CAPACITY : 2 * history->capacity;
+
+        AkinatorHistoryStep* new_steps = (AkinatorHistoryStep*)realloc(history->steps, new_capacity * sizeof(AkinatorHistoryStep));
+        if (new_steps == NULL) {
+            return AKINATOR_HISTORY_ALLOC_ERROR;
+        }
+
+        history->steps = new_steps;
+        history->capacity = new_capacity;
+    }
+
+    history->steps[history->size++] = {question, old_answer, new_answer};
+    history->position = history->size;
+
+    return AKINATOR_HISTORY_OK;
+}
+
+size_t AkinatorHistoryUndoCount(AkinatorHistory* history) {
+    assert(history != NULL);
+
+    return history->position;
+}
+
+size_t AkinatorHistoryRedoCount(AkinatorHistory* history) {
+    assert(history != NULL);
+
+    return history->size - history->position;
+}
+
+/// Ставит new_child на место old_child у его родителя
+static void AkinatorHistoryReplaceChild(TreeNode* old_child, TreeNode* new_child) {
+    assert(old_child != NULL);
+    assert(new_child != NULL);
+
+    TreeNode* parent = TreeNodeGetParent(old_child);
+    assert(parent != NULL);
+
+    if (TreeNodeGetLeft(parent) == old_child) {
+        TreeNodeLinkLeft(parent, new_child);
+    }
+    else {
+        TreeNodeLinkRight(parent, new_child);
+    }
+}
+
+AkinatorHistoryError AkinatorHistoryUndo(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    AkinatorHistory* history = &akinator->history;
+    assert(history->position > 0);
+
+    AkinatorHistoryStep* step = &history->steps[history->position - 1];
+
+    TreeNodeLinkLeft(step->question, NULL);
+    AkinatorHistoryReplaceChild(step->question, step->old_answer);
+
+    TreeHashUpdatePath(step->old_answer);
+
+    akinator->tree.size -= 2;
+    history->position--;
+
+    if (NameIndexRemove(&akinator->name_index, step->new_answer) != NAME_INDEX_OK) {
+        return AKINATOR_HISTORY_INDEX_ERROR;
+    }
+
+    if (RadixTrieRemove(&akinator->value_trie, TreeNodeGetValue(step->new_answer)) != RADIX_TRIE_OK
+        || RadixTrieRemove(&akinator->value_trie, TreeNodeGetValue(step->question)) != RADIX_TRIE_OK) {
+        return AKINATOR_HISTORY_INDEX_ERROR;
+    }
+
+    return AKINATOR_HISTORY_OK;
+}
+
+AkinatorHistoryError AkinatorHistoryRedo(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    AkinatorHistory* history = &akinator->history;
+    assert(history->position < history->size);
+
+    AkinatorHistoryStep* step = &history->steps[history->position];
+
+    AkinatorHistoryReplaceChild(step->old_answer, step->question);
+    TreeNodeLinkLeft(step->question, step->old_answer);
+
+    TreeHashUpdatePath(step->question);
+
+    akinator->tree.size += 2;
+    history->position++;
+
+    if (NameIndexAdd(&akinator->name_index, step->new_answer) != NAME_INDEX_OK) {
+        return AKINATOR_HISTORY_INDEX_ERROR;
+    }
+
+    if (RadixTrieInsert(&akinator->value_trie, TreeNodeGetValue(step->new_answer)) != RADIX_TRIE_OK
+        || RadixTrieInsert(&akinator->value_trie, TreeNodeGetValue(step->question)) != RADIX_TRIE_OK) {
+        return AKINATOR_HISTORY_INDEX_ERROR;
+    }
+
+    return AKINATOR_HISTORY_OK;
+}
+
+static AkinatorHistorySnapshot* AkinatorHistoryFindSnapshot(AkinatorHistory* history, const char* name) {
+    assert(history != NULL);
+    assert(name != NULL);
+
+    for (size_t snapshot_i = 0; snapshot_i < history->snapshots_size; snapshot_i++) {
+        if (strcmp(history->snapshots[snapshot_i].name, name) == 0) {
+            return &history->snapshots[snapshot_i];
+        }
+    }
+
+    return NULL;
+}
+
+AkinatorHistoryError AkinatorHistorySnapshotSave(AkinatorHistory* history, const char* name) {
+    assert(history != NULL);
+    assert(name != NULL);
+
+    AkinatorHistorySnapshot* snapshot = AkinatorHistoryFindSnapshot(history, name);
+
+    if (snapshot == NULL) {
+        if (history->snapshots_size == history->snapshots_capacity) {
+            size_t new_capacity = (history->snapshots_capacity == 0) ? AKINATOR_HISTORY_START_CAPACITY : 2 * history->snapshots_capacity;
+
+            AkinatorHistorySnapshot* new_snapshots = (AkinatorHistorySnapshot*)realloc(history->snapshots,
+                                                                                      new_capacity * sizeof(AkinatorHistorySnapshot));
+            if (new_snapshots == NULL) {
+                return AKINATOR_HISTORY_ALLOC_ERROR;
+            }
+
+            history->snapshots = new_snapshots;
+            history->snapshots_capacity = new_capacity;
+        }
+
+        snapshot = &history->snapshots[history->snapshots_size++];
+
+        strncpy(snapshot->name, name, AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN);
+        snapshot->name[AKINATOR_HISTORY_MAX_SNAPSHOT_NAME_LEN] = '\0';
+    }
+
+    snapshot->position = history->position;
+
+    return AKINATOR_HISTORY_OK;
+}
+
+AkinatorHistoryError AkinatorHistorySnapshotRestore(Akinator* akinator, const char* name) {
+    assert(akinator != NULL);
+    assert(name != NULL);
+
+    AkinatorHistory* history = &akinator->history;
+
+    AkinatorHistorySnapshot* snapshot = AkinatorHistoryFindSnapshot(history, name);
+    if (snapshot == NULL) {
+        return AKINATOR_HISTORY_UNKNOWN_SNAPSHOT;
+    }
+
+    size_t target_position = snapshot->position;
+
+    while (history->position > target_position) {
+        AkinatorHistoryError undo_err = AkinatorHistoryUndo(akinator);
+        if (undo_err != AKINATOR_HISTORY_OK) {
+            return undo_err;
+        }
+    }
+
+    while (history->position < target_position) {
+        AkinatorHistoryError redo_err = AkinatorHistoryRedo(akinator);
+        if (redo_err != AKINATOR_HISTORY_OK) {
+            return redo_err;
+        }
+    }
+
+    return AKINATOR_HISTORY_OK;
+}
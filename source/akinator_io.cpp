@@ -0,0 +1,524 @@
+#include "akinator_io.hpp"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "metrics.hpp"
+#include "utils.hpp"
+
+static const uint64_t AKINATOR_IO_NS_PER_SEC = 1000000000;
+static const double AKINATOR_IO_NS_PER_MS = 1e6;
+static const size_t AKINATOR_IO_OUTPUT_BUFFER_SIZE = 1024;
+
+struct AkinatorIoState {
+    AkinatorIoMode mode;
+    bool is_speech_enabled;
+
+    FILE* session_file;
+
+    AkinatorIoEvent* events;
+    size_t event_count;
+    size_t event_capacity;
+    bool is_paced;
+
+    /// steps[i] - шаг воспроизведения перед чтением events[i]
+    AkinatorIoStep* steps;
+    size_t step_count;
+    /// Программа запросила не тот вид чтения или больше чтений, чем записано
+    bool is_diverged;
+
+    uint64_t step_start_ns;
+    uint64_t output_hash;
+};
+
+static AkinatorIoState akinator_io = {AKINATOR_IO_LIVE, true};
+
+static uint64_t AkinatorIoHash(uint64_t hash, const char* text, size_t len) {
+    assert(text != NULL);
+
+    for (size_t char_i = 0; char_i < len; char_i++) {
+        hash ^= (unsigned char)text[char_i];
+        hash *= AKINATOR_IO_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+static void AkinatorIoStepStart() {
+    akinator_io.output_hash = AKINATOR_IO_HASH_OFFSET;
+    akinator_io.step_start_ns = MetricsNow();
+}
+
+static bool AkinatorIoIsKind(int kind) {
+    return kind == AKINATOR_IO_WORD || kind == AKINATOR_IO_LINE || kind == AKINATOR_IO_RAW_LINE
+           || kind == AKINATOR_IO_INT || kind == AKINATOR_IO_END;
+}
+
+static void AkinatorIoReset() {
+    PROTECTED_FREE(akinator_io.events);
+    PROTECTED_FREE(akinator_io.steps);
+
+    akinator_io.session_file = NULL;
+    akinator_io.event_count = 0;
+    akinator_io.event_capacity = 0;
+    akinator_io.step_count = 0;
+    akinator_io.is_diverged = false;
+    akinator_io.mode = AKINATOR_IO_LIVE;
+}
+
+AkinatorError AkinatorIoRecordStart(const char* session_file_name) {
+    assert(session_file_name != NULL);
+    assert(akinator_io.mode == AKINATOR_IO_LIVE);
+
+    akinator_io.session_file = fopen(session_file_name, "w");
+    if (akinator_io.session_file == NULL) {
+        return AKINATOR_SESSION_ERROR;
+    }
+
+    fprintf(akinator_io.session_file, "# kind is_read wait_ns work_ns output_hash value\n");
+
+    akinator_io.mode = AKINATOR_IO_RECORD;
+    AkinatorIoStepStart();
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorIoEventParse(const char* line, AkinatorIoEvent* event) {
+    assert(line != NULL);
+    assert(event != NULL);
+
+    char kind = '\0';
+    int is_read = 0;
+    int value_start = 0;
+    if (sscanf(line, "%c %d %lu %lu %lx%n", &kind, &is_read, &event->wait_ns, &event->work_ns,
+               &event->output_hash, &value_start) != 5 || !AkinatorIoIsKind(kind)) {
+        return AKINATOR_SESSION_ERROR;
+    }
+
+    if (line[value_start] == ' ') {
+        value_start++;
+    }
+
+    event->kind = (AkinatorIoReadKind)kind;
+    event->is_read = is_read != 0;
+
+    size_t value_len = strcspn(line + value_start, "\n");
+    if (value_len > AKINATOR_IO_MAX_VALUE_LEN) {
+        return AKINATOR_SESSION_ERROR;
+    }
+
+    memcpy(event->value, line + value_start, value_len);
+    event->value[value_len] = '\0';
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorIoEventsRead(FILE* session_file) {
+    assert(session_file != NULL);
+
+    char line[AKINATOR_IO_MAX_EVENT_LINE_LEN + 1] = {};
+    while (fgets(line, (int)sizeof(line), session_file) != NULL) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+
+        if (akinator_io.event_count == akinator_io.event_capacity) {
+            size_t new_capacity = (akinator_io.event_capacity == 0) ? AKINATOR_IO_START_CAPACITY
+                                                                    : 2 * akinator_io.event_capacity;
+            AkinatorIoEvent* new_events = (AkinatorIoEvent*)realloc(akinator_io.events,
+                                                                    new_capacity * sizeof(AkinatorIoEvent));
+            if (new_events == NULL) {
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+
+            akinator_io.events = new_events;
+            akinator_io.event_capacity = new_capacity;
+        }
+
+        AkinatorError parse_err = AkinatorIoEventParse(line, &akinator_io.events[akinator_io.event_count]);
+        if (parse_err != AKINATOR_OK) {
+            return parse_err;
+        }
+
+        akinator_io.event_count++;
+    }
+
+    if (akinator_io.event_count == 0 || akinator_io.events[akinator_io.event_count - 1].kind != AKINATOR_IO_END) {
+        return AKINATOR_SESSION_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorIoReplayStart(const char* session_file_name, bool is_paced) {
+    assert(session_file_name != NULL);
+    assert(akinator_io.mode == AKINATOR_IO_LIVE);
+
+    FILE* session_file = fopen(session_file_name, "r");
+    if (session_file == NULL) {
+        return AKINATOR_SESSION_ERROR;
+    }
+
+    AkinatorError read_err = AkinatorIoEventsRead(session_file);
+    fclose(session_file);
+
+    if (read_err == AKINATOR_OK) {
+        akinator_io.steps = (AkinatorIoStep*)calloc(akinator_io.event_count, sizeof(AkinatorIoStep));
+        if (akinator_io.steps == NULL) {
+            read_err = AKINATOR_NODE_ALLOC_ERROR;
+        }
+    }
+
+    if (read_err != AKINATOR_OK) {
+        AkinatorIoReset();
+        return read_err;
+    }
+
+    akinator_io.mode = AKINATOR_IO_REPLAY;
+    akinator_io.is_paced = is_paced;
+    akinator_io.is_speech_enabled = false;
+    AkinatorIoStepStart();
+
+    return AKINATOR_OK;
+}
+
+static void AkinatorIoSleep(uint64_t duration_ns) {
+    timespec duration = {};
+    duration.tv_sec = (time_t)(duration_ns / AKINATOR_IO_NS_PER_SEC);
+    duration.tv_nsec = (long)(duration_ns % AKINATOR_IO_NS_PER_SEC);
+
+    while (nanosleep(&duration, &duration) != 0) {}
+}
+
+/// Закрывает текущий шаг в воспроизведении: сверяет его с событием, которое сейчас будет выдано
+static const AkinatorIoEvent* AkinatorIoReplayNext(AkinatorIoReadKind kind) {
+    uint64_t work_ns = MetricsNow() - akinator_io.step_start_ns;
+
+    size_t event_i = akinator_io.step_count;
+    if (event_i >= akinator_io.event_count) {
+        akinator_io.is_diverged = true;
+        return NULL;
+    }
+
+    const AkinatorIoEvent* event = &akinator_io.events[event_i];
+
+    akinator_io.steps[event_i].work_ns = work_ns;
+    akinator_io.steps[event_i].is_output_same = (event->output_hash == akinator_io.output_hash);
+    akinator_io.step_count++;
+
+    if (event->kind != kind) {
+        akinator_io.is_diverged = true;
+        return NULL;
+    }
+
+    return event;
+}
+
+static void AkinatorIoRecordEvent(AkinatorIoReadKind kind, bool is_read, uint64_t wait_ns, uint64_t work_ns,
+                                  const char* value) {
+    assert(value != NULL);
+
+    fprintf(akinator_io.session_file, "%c %d %lu %lu %016lx %s\n", (char)kind, is_read ? 1 : 0,
+            wait_ns, work_ns, akinator_io.output_hash, value);
+}
+
+static void AkinatorIoSkipSpaces() {
+    int symbol = getchar();
+    while (symbol != EOF && isspace(symbol)) {
+        symbol = getchar();
+    }
+
+    if (symbol != EOF) {
+        ungetc(symbol, stdin);
+    }
+}
+
+/// Читает из stdin не больше max_len символов до пробела (is_word) или до конца строки, не забирая ограничитель
+static size_t AkinatorIoReadStdin(char* value, size_t max_len, bool is_word) {
+    assert(value != NULL);
+
+    size_t len = 0;
+    while (len < max_len) {
+        int symbol = getchar();
+        if (symbol == EOF) {
+            break;
+        }
+
+        if (symbol == '\n' || (is_word && isspace(symbol))) {
+            ungetc(symbol, stdin);
+            break;
+        }
+
+        value[len++] = (char)symbol;
+    }
+
+    value[len] = '\0';
+
+    return len;
+}
+
+/// Читает целое как "%d": знак и цифры; нецифровой символ остается в потоке, а value становится пустой
+static size_t AkinatorIoReadStdinInt(char* value) {
+    assert(value != NULL);
+
+    size_t len = 0;
+    int symbol = getchar();
+    if (symbol == '-' || symbol == '+') {
+        value[len++] = (char)symbol;
+        symbol = getchar();
+    }
+
+    while (symbol != EOF && isdigit(symbol) && len < AKINATOR_IO_MAX_INT_LEN) {
+        value[len++] = (char)symbol;
+        symbol = getchar();
+    }
+
+    if (symbol != EOF) {
+        ungetc(symbol, stdin);
+    }
+
+    if (len != 0 && !isdigit((unsigned char)value[len - 1])) {
+        len = 0;
+    }
+
+    value[len] = '\0';
+
+    return len;
+}
+
+static bool AkinatorIoRead(AkinatorIoReadKind kind, char* value, size_t max_len) {
+    assert(value != NULL);
+    assert(max_len <= AKINATOR_IO_MAX_VALUE_LEN);
+
+    bool is_read = false;
+
+    if (akinator_io.mode == AKINATOR_IO_REPLAY) {
+        const AkinatorIoEvent* event = AkinatorIoReplayNext(kind);
+
+        if (event != NULL && akinator_io.is_paced) {
+            AkinatorIoSleep(event->wait_ns);
+        }
+
+        value[0] = '\0';
+        if (event != NULL) {
+            strncat(value, event->value, max_len);
+            is_read = event->is_read;
+        }
+
+        AkinatorIoStepStart();
+
+        return is_read;
+    }
+
+    uint64_t wait_start_ns = MetricsNow();
+    uint64_t work_ns = wait_start_ns - akinator_io.step_start_ns;
+
+    if (kind != AKINATOR_IO_RAW_LINE) {
+        AkinatorIoSkipSpaces();
+    }
+
+    if (kind == AKINATOR_IO_INT) {
+        is_read = AkinatorIoReadStdinInt(value) != 0 || !feof(stdin);
+
+        int symbol = getchar();
+        while (symbol != EOF && symbol != '\n') {
+            symbol = getchar();
+        }
+    }
+    else {
+        is_read = AkinatorIoReadStdin(value, max_len, kind == AKINATOR_IO_WORD) != 0;
+    }
+
+    if (akinator_io.mode == AKINATOR_IO_RECORD) {
+        AkinatorIoRecordEvent(kind, is_read, MetricsNow() - wait_start_ns, work_ns, value);
+    }
+
+    AkinatorIoStepStart();
+
+    return is_read;
+}
+
+bool AkinatorIoReadWord(char* word, size_t max_len) {
+    assert(word != NULL);
+
+    return AkinatorIoRead(AKINATOR_IO_WORD, word, max_len);
+}
+
+bool AkinatorIoReadLine(char* line, size_t max_len, bool is_skip_spaces) {
+    assert(line != NULL);
+
+    return AkinatorIoRead(is_skip_spaces ? AKINATOR_IO_LINE : AKINATOR_IO_RAW_LINE, line, max_len);
+}
+
+bool AkinatorIoReadInt(int* value) {
+    assert(value != NULL);
+
+    char text[1 + AKINATOR_IO_MAX_INT_LEN] = {};
+    if (!AkinatorIoRead(AKINATOR_IO_INT, text, AKINATOR_IO_MAX_INT_LEN)) {
+        return false;
+    }
+
+    *value = (int)strtol(text, NULL, 10);
+
+    return true;
+}
+
+void AkinatorIoVPrintf(const char* format, va_list args) {
+    assert(format != NULL);
+
+    char buffer[AKINATOR_IO_OUTPUT_BUFFER_SIZE] = {};
+    char* text = buffer;
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args_copy);
+    va_end(args_copy);
+
+    if (len < 0) {
+        return;
+    }
+
+    if ((size_t)len >= sizeof(buffer)) {
+        text = (char*)calloc((size_t)len + 1, sizeof(char));
+        if (text == NULL) {
+            vprintf(format, args);
+            return;
+        }
+
+        vsnprintf(text, (size_t)len + 1, format, args);
+    }
+
+    fwrite(text, sizeof(char), (size_t)len, stdout);
+    akinator_io.output_hash = AkinatorIoHash(akinator_io.output_hash, text, (size_t)len);
+
+    if (text != buffer) {
+        PROTECTED_FREE(text);
+    }
+}
+
+void AkinatorIoSetSpeech(bool is_enabled) {
+    akinator_io.is_speech_enabled = is_enabled;
+}
+
+AkinatorIoMode AkinatorIoGetMode() {
+    return akinator_io.mode;
+}
+
+bool AkinatorIoIsSpeechEnabled() {
+    return akinator_io.is_speech_enabled;
+}
+
+static void AkinatorIoPrintValue(const char* value, FILE* stream) {
+    assert(value != NULL);
+    assert(stream != NULL);
+
+    if (strlen(value) > AKINATOR_IO_MAX_PRINT_VALUE_LEN) {
+        fprintf(stream, "%.*s...", (int)AKINATOR_IO_MAX_PRINT_VALUE_LEN, value);
+    }
+    else {
+        fprintf(stream, "%s", value);
+    }
+}
+
+static int AkinatorIoCompareNs(const void* first, const void* second) {
+    assert(first != NULL);
+    assert(second != NULL);
+
+    uint64_t first_ns = *(const uint64_t*)first;
+    uint64_t second_ns = *(const uint64_t*)second;
+
+    return (first_ns > second_ns) - (first_ns < second_ns);
+}
+
+/// Печатает задержку каждого шага рядом с записанной и сводку; шаг i начинается после ввода i - 1
+static AkinatorError AkinatorIoReplayReport(FILE* stream) {
+    assert(stream != NULL);
+
+    size_t step_count = akinator_io.step_count;
+    size_t mismatch_count = 0;
+    size_t slowest_step_i = 0;
+    uint64_t total_ns = 0;
+
+    fprintf(stream, "Воспроизведение сессии: %s\n", akinator_io.is_paced ? "с записанными паузами" : "без пауз");
+    fprintf(stream, "   шаг    работа мс    запись мс  вывод      после ввода\n");
+
+    for (size_t step_i = 0; step_i < step_count; step_i++) {
+        const AkinatorIoStep* step = &akinator_io.steps[step_i];
+
+        fprintf(stream, "%6lu %12.3f %12.3f  %s ", step_i, (double)step->work_ns / AKINATOR_IO_NS_PER_MS,
+                (double)akinator_io.events[step_i].work_ns / AKINATOR_IO_NS_PER_MS,
+                step->is_output_same ? "совпал    " : "ОТЛИЧАЕТСЯ");
+
+        if (step_i == 0) {
+            fprintf(stream, "(запуск)\n");
+        }
+        else {
+            AkinatorIoPrintValue(akinator_io.events[step_i - 1].value, stream);
+            fprintf(stream, "\n");
+        }
+
+        if (!step->is_output_same) {
+            mismatch_count++;
+        }
+
+        if (step->work_ns > akinator_io.steps[slowest_step_i].work_ns) {
+            slowest_step_i = step_i;
+        }
+
+        total_ns += step->work_ns;
+    }
+
+    uint64_t* sorted_ns = (uint64_t*)calloc(step_count + 1, sizeof(uint64_t));
+    if (sorted_ns == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    for (size_t step_i = 0; step_i < step_count; step_i++) {
+        sorted_ns[step_i] = akinator_io.steps[step_i].work_ns;
+    }
+
+    qsort(sorted_ns, step_count, sizeof(uint64_t), AkinatorIoCompareNs);
+
+    fprintf(stream, "Шагов: %lu из %lu записанных, вывод отличается: %lu%s\n", step_count, akinator_io.event_count,
+            mismatch_count, akinator_io.is_diverged ? ", порядок чтений разошелся с записью" : "");
+
+    if (step_count != 0) {
+        fprintf(stream, "Работа: всего %.3f мс, среднее %.3f мс, медиана %.3f мс, максимум %.3f мс (шаг %lu)\n",
+                (double)total_ns / AKINATOR_IO_NS_PER_MS,
+                (double)total_ns / (double)step_count / AKINATOR_IO_NS_PER_MS,
+                (double)sorted_ns[step_count / 2] / AKINATOR_IO_NS_PER_MS,
+                (double)sorted_ns[step_count - 1] / AKINATOR_IO_NS_PER_MS, slowest_step_i);
+    }
+
+    PROTECTED_FREE(sorted_ns);
+
+    bool is_same = mismatch_count == 0 && !akinator_io.is_diverged && step_count == akinator_io.event_count;
+
+    return is_same ? AKINATOR_OK : AKINATOR_SESSION_ERROR;
+}
+
+AkinatorError AkinatorIoStop(FILE* report_stream) {
+    assert(report_stream != NULL);
+
+    AkinatorError stop_err = AKINATOR_OK;
+
+    if (akinator_io.mode == AKINATOR_IO_RECORD) {
+        AkinatorIoRecordEvent(AKINATOR_IO_END, false, 0, MetricsNow() - akinator_io.step_start_ns, "");
+
+        if (fclose(akinator_io.session_file) != 0) {
+            stop_err = AKINATOR_SESSION_ERROR;
+        }
+    }
+    else if (akinator_io.mode == AKINATOR_IO_REPLAY) {
+        AkinatorIoReplayNext(AKINATOR_IO_END);
+
+        stop_err = AkinatorIoReplayReport(report_stream);
+    }
+
+    AkinatorIoReset();
+
+    return stop_err;
+}
@@ -0,0 +1,867 @@
+#include "akinator_json.hpp"
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "utils.hpp"
+
+struct JsonWriter {
+    FILE* file;
+
+    char* buffer;
+    size_t size;
+};
+
+enum JsonTokenType {
+    JSON_TOKEN_ERROR        =  0,
+    JSON_TOKEN_END          =  1,
+    JSON_TOKEN_OBJECT_BEGIN =  2,
+    JSON_TOKEN_OBJECT_END   =  3,
+    JSON_TOKEN_ARRAY_BEGIN  =  4,
+    JSON_TOKEN_ARRAY_END    =  5,
+    JSON_TOKEN_COLON        =  6,
+    JSON_TOKEN_COMMA        =  7,
+    JSON_TOKEN_STRING       =  8,
+    JSON_TOKEN_NUMBER       =  9,
+    JSON_TOKEN_LITERAL      = 10,
+    JSON_TOKEN_NULL         = 11
+};
+
+/// SAX-токенизатор поверх буферизованного чтения: значение последней строки или числа лежит в string
+struct JsonReader {
+    FILE* file;
+
+    char* buffer;
+    size_t pos;
+    size_t size;
+
+    char* string;
+    size_t string_len;
+
+    long long number;
+};
+
+enum JsonKey {
+    JSON_KEY_OTHER  =  0,
+    JSON_KEY_TEXT   =  1,
+    JSON_KEY_NO     =  2,
+    JSON_KEY_YES    =  3,
+    JSON_KEY_ID     =  4,
+    JSON_KEY_PARENT =  5,
+    JSON_KEY_SIDE   =  6
+};
+
+struct JsonFrame {
+    TreeNode* node;
+
+    bool is_first;
+};
+
+static AkinatorError JsonWriterInit(JsonWriter* writer, FILE* file) {
+    assert(writer != NULL);
+    assert(file != NULL);
+
+    writer->file = file;
+    writer->size = 0;
+    writer->buffer = (char*)calloc(AKINATOR_JSON_BUFFER_SIZE, sizeof(char));
+
+    return writer->buffer == NULL ? AKINATOR_NODE_ALLOC_ERROR : AKINATOR_OK;
+}
+
+static void JsonWriterFlush(JsonWriter* writer) {
+    assert(writer != NULL);
+
+    fwrite(writer->buffer, 1, writer->size, writer->file);
+    writer->size = 0;
+}
+
+static AkinatorError JsonWriterDestroy(JsonWriter* writer) {
+    assert(writer != NULL);
+
+    JsonWriterFlush(writer);
+    PROTECTED_FREE(writer->buffer);
+
+    return ferror(writer->file) ? AKINATOR_DATABASE_FILE_CREATE_ERROR : AKINATOR_OK;
+}
+
+static void JsonWriterPut(JsonWriter* writer, const char* data, size_t len) {
+    assert(writer != NULL);
+    assert(data != NULL);
+
+    if (writer->size + len > AKINATOR_JSON_BUFFER_SIZE) {
+        JsonWriterFlush(writer);
+
+        if (len > AKINATOR_JSON_BUFFER_SIZE) {
+            fwrite(data, 1, len, writer->file);
+            return;
+        }
+    }
+
+    memcpy(writer->buffer + writer->size, data, len);
+    writer->size += len;
+}
+
+static void JsonWriterPutLiteral(JsonWriter* writer, const char* literal) {
+    JsonWriterPut(writer, literal, strlen(literal));
+}
+
+static void JsonWriterPutNumber(JsonWriter* writer, size_t number) {
+    char digits[32] = {};
+    int len = snprintf(digits, sizeof(digits), "%lu", number);
+
+    JsonWriterPut(writer, digits, (size_t)len);
+}
+
+static void JsonWriterPutString(JsonWriter* writer, const char* str) {
+    assert(writer != NULL);
+    assert(str != NULL);
+
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+
+    JsonWriterPut(writer, "\"", 1);
+
+    const char* run_begin = str;
+    for (const char* s = str; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        JsonWriterPut(writer, run_begin, (size_t)(s - run_begin));
+        run_begin = s + 1;
+
+        if (c == '"' || c == '\\') {
+            JsonWriterPutLiteral(writer, (c == '"') ? "\\\"" : "\\\\");
+        }
+        else {
+            JsonWriterPutLiteral(writer, "\\u00");
+            JsonWriterPut(writer, &HEX_DIGITS[c >> 4], 1);
+            JsonWriterPut(writer, &HEX_DIGITS[c & 0xF], 1);
+        }
+    }
+    JsonWriterPut(writer, run_begin, strlen(run_begin));
+
+    JsonWriterPut(writer, "\"", 1);
+}
+
+static JsonFrame* JsonStackPush(JsonFrame** stack, size_t* size, size_t* capacity) {
+    assert(stack != NULL);
+    assert(size != NULL);
+    assert(capacity != NULL);
+
+    if (*size == *capacity) {
+        size_t new_capacity = (*capacity == 0) ? AKINATOR_JSON_START_STACK_CAPACITY : 2 * *capacity;
+
+        JsonFrame* new_stack = (JsonFrame*)realloc(*stack, new_capacity * sizeof(JsonFrame));
+        if (new_stack == NULL) {
+            return NULL;
+        }
+
+        *stack = new_stack;
+        *capacity = new_capacity;
+    }
+
+    return &(*stack)[(*size)++];
+}
+
+AkinatorError AkinatorJsonSave(TreeNode* first_node, FILE* json_file) {
+    assert(json_file != NULL);
+
+    JsonWriter writer = {};
+    AkinatorError writer_err = JsonWriterInit(&writer, json_file);
+    if (writer_err != AKINATOR_OK) {
+        return writer_err;
+    }
+
+    JsonFrame* stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    if (first_node == NULL) {
+        JsonWriterPutLiteral(&writer, "null");
+    }
+    else {
+        JsonFrame* frame = JsonStackPush(&stack, &stack_size, &stack_capacity);
+        if (frame == NULL) {
+            JsonWriterDestroy(&writer);
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+
+        frame->node = first_node;
+        frame->is_first = true;
+    }
+
+    while (stack_size > 0) {
+        JsonFrame* frame = &stack[stack_size - 1];
+        TreeNode* node = frame->node;
+        TreeNode* child = NULL;
+
+        if (frame->is_first) {
+            JsonWriterPutLiteral(&writer, "{\"text\":");
+            JsonWriterPutString(&writer, TreeNodeGetValue(node));
+            JsonWriterPutLiteral(&writer, ",\"no\":");
+
+            frame->is_first = false;
+            child = TreeNodeGetLeft(node);
+        }
+        else if (node != NULL) {
+            JsonWriterPutLiteral(&writer, ",\"yes\":");
+
+            frame->node = NULL;
+            child = TreeNodeGetRight(node);
+        }
+        else {
+            JsonWriterPutLiteral(&writer, "}");
+            stack_size--;
+            continue;
+        }
+
+        if (child == NULL) {
+            JsonWriterPutLiteral(&writer, "null");
+            continue;
+        }
+
+        JsonFrame* child_frame = JsonStackPush(&stack, &stack_size, &stack_capacity);
+        if (child_frame == NULL) {
+            free(stack);
+            JsonWriterDestroy(&writer);
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+
+        child_frame->node = child;
+        child_frame->is_first = true;
+    }
+
+    JsonWriterPutLiteral(&writer, "\n");
+
+    free(stack);
+
+    return JsonWriterDestroy(&writer);
+}
+
+AkinatorError AkinatorJsonLinesSave(TreeNode* first_node, FILE* json_lines_file) {
+    assert(json_lines_file != NULL);
+
+    JsonWriter writer = {};
+    AkinatorError writer_err = JsonWriterInit(&writer, json_lines_file);
+    if (writer_err != AKINATOR_OK) {
+        return writer_err;
+    }
+
+    struct LineFrame {
+        TreeNode* node;
+        size_t parent_id;
+        const char* side;
+    };
+
+    LineFrame* stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    if (first_node != NULL) {
+        stack = (LineFrame*)calloc(AKINATOR_JSON_START_STACK_CAPACITY, sizeof(LineFrame));
+        if (stack == NULL) {
+            JsonWriterDestroy(&writer);
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+
+        stack_capacity = AKINATOR_JSON_START_STACK_CAPACITY;
+        stack[stack_size++] = {first_node, 0, "root"};
+    }
+
+    size_t next_id = 0;
+
+    while (stack_size > 0) {
+        LineFrame frame = stack[--stack_size];
+        size_t id = next_id++;
+
+        JsonWriterPutLiteral(&writer, "{\"id\":");
+        JsonWriterPutNumber(&writer, id);
+        JsonWriterPutLiteral(&writer, ",\"parent\":");
+        if (id == 0) {
+            JsonWriterPutLiteral(&writer, "null");
+        }
+        else {
+            JsonWriterPutNumber(&writer, frame.parent_id);
+        }
+        JsonWriterPutLiteral(&writer, ",\"side\":\"");
+        JsonWriterPutLiteral(&writer, frame.side);
+        JsonWriterPutLiteral(&writer, "\",\"text\":");
+        JsonWriterPutString(&writer, TreeNodeGetValue(frame.node));
+        JsonWriterPutLiteral(&writer, "}\n");
+
+        if (stack_size + 2 > stack_capacity) {
+            LineFrame* new_stack = (LineFrame*)realloc(stack, 2 * stack_capacity * sizeof(LineFrame));
+            if (new_stack == NULL) {
+                free(stack);
+                JsonWriterDestroy(&writer);
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+
+            stack = new_stack;
+            stack_capacity *= 2;
+        }
+
+        if (TreeNodeGetRight(frame.node) != NULL) {
+            stack[stack_size++] = {TreeNodeGetRight(frame.node), id, "yes"};
+        }
+
+        if (TreeNodeGetLeft(frame.node) != NULL) {
+            stack[stack_size++] = {TreeNodeGetLeft(frame.node), id, "no"};
+        }
+    }
+
+    free(stack);
+
+    return JsonWriterDestroy(&writer);
+}
+
+static AkinatorError JsonReaderInit(JsonReader* reader, FILE* file) {
+    assert(reader != NULL);
+    assert(file != NULL);
+
+    reader->file = file;
+    reader->pos = 0;
+    reader->size = 0;
+    reader->string_len = 0;
+    reader->number = 0;
+
+    reader->buffer = (char*)calloc(AKINATOR_JSON_BUFFER_SIZE, sizeof(char));
+    reader->string = (char*)calloc(AKINATOR_JSON_MAX_STRING_LEN + 1, sizeof(char));
+
+    if (reader->buffer == NULL || reader->string == NULL) {
+        PROTECTED_FREE(reader->buffer);
+        PROTECTED_FREE(reader->string);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+static void JsonReaderDestroy(JsonReader* reader) {
+    assert(reader != NULL);
+
+    PROTECTED_FREE(reader->buffer);
+    PROTECTED_FREE(reader->string);
+}
+
+static int JsonReaderGet(JsonReader* reader) {
+    assert(reader != NULL);
+
+    if (reader->pos == reader->size) {
+        reader->size = fread(reader->buffer, 1, AKINATOR_JSON_BUFFER_SIZE, reader->file);
+        reader->pos = 0;
+
+        if (reader->size == 0) {
+            return EOF;
+        }
+    }
+
+    return (unsigned char)reader->buffer[reader->pos++];
+}
+
+static bool JsonReaderAppend(JsonReader* reader, uint32_t codepoint) {
+    assert(reader != NULL);
+
+    size_t len = (codepoint < 0x80) ? 1 : (codepoint < 0x800) ? 2 : (codepoint < 0x10000) ? 3 : 4;
+    if (reader->string_len + len > AKINATOR_JSON_MAX_STRING_LEN) {
+        return false;
+    }
+
+    char* encoded = reader->string + reader->string_len;
+    reader->string_len += len;
+
+    if (len == 1) {
+        encoded[0] = (char)codepoint;
+        return true;
+    }
+
+    static const unsigned char LEAD_BYTES[] = {0, 0, 0xC0, 0xE0, 0xF0};
+
+    for (size_t byte_i = len - 1; byte_i > 0; byte_i--) {
+        encoded[byte_i] = (char)(0x80 | (codepoint & 0x3F));
+        codepoint >>= 6;
+    }
+    encoded[0] = (char)(LEAD_BYTES[len] | codepoint);
+
+    return true;
+}
+
+static bool JsonReaderReadHex4(JsonReader* reader, uint32_t* value) {
+    assert(reader != NULL);
+    assert(value != NULL);
+
+    *value = 0;
+    for (int digit_i = 0; digit_i < 4; digit_i++) {
+        int c = JsonReaderGet(reader);
+
+        uint32_t digit = 0;
+        if ('0' <= c && c <= '9')      { digit = (uint32_t)(c - '0'); }
+        else if ('a' <= c && c <= 'f') { digit = (uint32_t)(c - 'a' + 10); }
+        else if ('A' <= c && c <= 'F') { digit = (uint32_t)(c - 'A' + 10); }
+        else                           { return false; }
+
+        *value = (*value << 4) | digit;
+    }
+
+    return true;
+}
+
+static JsonTokenType JsonReaderReadString(JsonReader* reader) {
+    assert(reader != NULL);
+
+    reader->string_len = 0;
+
+    while (true) {
+        int c = JsonReaderGet(reader);
+
+        if (c == EOF) {
+            return JSON_TOKEN_ERROR;
+        }
+
+        if (c == '"') {
+            reader->string[reader->string_len] = '\0';
+            return JSON_TOKEN_STRING;
+        }
+
+        if (c != '\\') {
+            if (reader->string_len == AKINATOR_JSON_MAX_STRING_LEN) {
+                return JSON_TOKEN_ERROR;
+            }
+
+            reader->string[reader->string_len++] = (char)c;
+            continue;
+        }
+
+        uint32_t codepoint = 0;
+        switch (JsonReaderGet(reader)) {
+            case '"':  codepoint = '"';  break;
+            case '\\': codepoint = '\\'; break;
+            case '/':  codepoint = '/';  break;
+            case 'b':  codepoint = '\b'; break;
+            case 'f':  codepoint = '\f'; break;
+            case 'n':  codepoint = '\n'; break;
+            case 'r':  codepoint = '\r'; break;
+            case 't':  codepoint = '\t'; break;
+            case 'u': {
+                if (!JsonReaderReadHex4(reader, &codepoint)) {
+                    return JSON_TOKEN_ERROR;
+                }
+
+                if (0xD800 <= codepoint && codepoint < 0xDC00) {
+                    uint32_t low = 0;
+                    if (JsonReaderGet(reader) != '\\' || JsonReaderGet(reader) != 'u' || !JsonReaderReadHex4(reader, &low)) {
+                        return JSON_TOKEN_ERROR;
+                    }
+
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                break;
+            }
+            default:
+                return JSON_TOKEN_ERROR;
+        }
+
+        if (!JsonReaderAppend(reader, codepoint)) {
+            return JSON_TOKEN_ERROR;
+        }
+    }
+}
+
+/// Разбирает целое по грамматике JSON (-?(0|[1-9][0-9]*)) из reader->string; дроби, экспоненты и переполнение - ошибка
+static bool JsonReaderParseInteger(JsonReader* reader) {
+    assert(reader != NULL);
+
+    const char* digits = reader->string;
+    bool is_negative = (*digits == '-');
+    if (is_negative) {
+        digits++;
+    }
+
+    if (*digits == '\0' || (digits[0] == '0' && digits[1] != '\0')) {
+        return false;
+    }
+
+    unsigned long long number = 0;
+    unsigned long long limit = (unsigned long long)LLONG_MAX + (is_negative ? 1 : 0);
+
+    for (const char* digit = digits; *digit != '\0'; digit++) {
+        if (*digit < '0' || '9' < *digit) {
+            return false;
+        }
+
+        unsigned long long digit_value = (unsigned long long)(*digit - '0');
+        if (number > (limit - digit_value) / 10) {
+            return false;
+        }
+
+        number = 10 * number + digit_value;
+    }
+
+    reader->number = is_negative ? (long long)(0 - number) : (long long)number;
+
+    return true;
+}
+
+static JsonTokenType JsonReaderNext(JsonReader* reader) {
+    assert(reader != NULL);
+
+    int c = JsonReaderGet(reader);
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        c = JsonReaderGet(reader);
+    }
+
+    switch (c) {
+        case EOF: return JSON_TOKEN_END;
+        case '{': return JSON_TOKEN_OBJECT_BEGIN;
+        case '}': return JSON_TOKEN_OBJECT_END;
+        case '[': return JSON_TOKEN_ARRAY_BEGIN;
+        case ']': return JSON_TOKEN_ARRAY_END;
+        case ':': return JSON_TOKEN_COLON;
+        case ',': return JSON_TOKEN_COMMA;
+        case '"': return JsonReaderReadString(reader);
+        default:  break;
+    }
+
+    bool is_number = (c == '-' || ('0' <= c && c <= '9'));
+
+    reader->string_len = 0;
+    reader->number = 0;
+    while (c != EOF && c != ',' && c != '}' && c != ']' && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+        if (reader->string_len == AKINATOR_JSON_MAX_STRING_LEN) {
+            return JSON_TOKEN_ERROR;
+        }
+
+        reader->string[reader->string_len++] = (char)c;
+
+        c = JsonReaderGet(reader);
+    }
+    reader->string[reader->string_len] = '\0';
+
+    if (c != EOF) {
+        reader->pos--;
+    }
+
+    if (is_number) {
+        return JsonReaderParseInteger(reader) ? JSON_TOKEN_NUMBER : JSON_TOKEN_ERROR;
+    }
+
+    if (strcmp(reader->string, "null") == 0) {
+        return JSON_TOKEN_NULL;
+    }
+
+    if (strcmp(reader->string, "true") == 0 || strcmp(reader->string, "false") == 0) {
+        return JSON_TOKEN_LITERAL;
+    }
+
+    return JSON_TOKEN_ERROR;
+}
+
+static JsonKey JsonReaderGetKey(JsonReader* reader) {
+    assert(reader != NULL);
+
+    if (strcmp(reader->string, "text") == 0)   { return JSON_KEY_TEXT; }
+    if (strcmp(reader->string, "no") == 0)     { return JSON_KEY_NO; }
+    if (strcmp(reader->string, "yes") == 0)    { return JSON_KEY_YES; }
+    if (strcmp(reader->string, "id") == 0)     { return JSON_KEY_ID; }
+    if (strcmp(reader->string, "parent") == 0) { return JSON_KEY_PARENT; }
+    if (strcmp(reader->string, "side") == 0)   { return JSON_KEY_SIDE; }
+
+    return JSON_KEY_OTHER;
+}
+
+/// Пропускает значение, первый токен которого уже прочитан
+static bool JsonReaderSkipValue(JsonReader* reader, JsonTokenType token) {
+    assert(reader != NULL);
+
+    size_t depth = 0;
+
+    do {
+        switch (token) {
+            case JSON_TOKEN_OBJECT_BEGIN:
+            case JSON_TOKEN_ARRAY_BEGIN:
+                depth++;
+                break;
+            case JSON_TOKEN_OBJECT_END:
+            case JSON_TOKEN_ARRAY_END:
+                if (depth == 0) {
+                    return false;
+                }
+                depth--;
+                break;
+            case JSON_TOKEN_ERROR:
+            case JSON_TOKEN_END:
+                return false;
+            case JSON_TOKEN_COLON:
+            case JSON_TOKEN_COMMA:
+            case JSON_TOKEN_STRING:
+            case JSON_TOKEN_NUMBER:
+            case JSON_TOKEN_LITERAL:
+            case JSON_TOKEN_NULL:
+            default:
+                break;
+        }
+
+        if (depth == 0) {
+            return true;
+        }
+
+        token = JsonReaderNext(reader);
+    } while (true);
+}
+
+static TreeNode* JsonNodeAttach(Tree* tree, TreeNode* parent, JsonKey side) {
+    assert(tree != NULL);
+    assert(parent != NULL);
+
+    TreeNode* node = TreeNodeInit("");
+    if (node == NULL) {
+        return NULL;
+    }
+
+    if (side == JSON_KEY_YES) {
+        TreeNodeLinkRight(parent, node);
+    }
+    else {
+        TreeNodeLinkLeft(parent, node);
+    }
+
+    tree->size++;
+
+    return node;
+}
+
+AkinatorError AkinatorJsonLoad(Tree* tree, FILE* json_file) {
+    assert(tree != NULL);
+    assert(json_file != NULL);
+
+    JsonReader reader = {};
+    AkinatorError reader_err = JsonReaderInit(&reader, json_file);
+    if (reader_err != AKINATOR_OK) {
+        return reader_err;
+    }
+
+    AkinatorError load_err = AKINATOR_OK;
+
+    JsonFrame* stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    if (JsonReaderNext(&reader) != JSON_TOKEN_OBJECT_BEGIN) {
+        load_err = AKINATOR_DATABASE_PARSE_ERROR;
+    }
+    else {
+        JsonFrame* frame = JsonStackPush(&stack, &stack_size, &stack_capacity);
+        TreeNode* first_node = (frame == NULL) ? NULL : JsonNodeAttach(tree, TreeGetRoot(tree), JSON_KEY_NO);
+
+        if (first_node == NULL) {
+            load_err = AKINATOR_NODE_ALLOC_ERROR;
+        }
+        else {
+            frame->node = first_node;
+        }
+    }
+
+    while (load_err == AKINATOR_OK && stack_size > 0) {
+        JsonTokenType token = JsonReaderNext(&reader);
+
+        if (token == JSON_TOKEN_OBJECT_END) {
+            stack_size--;
+            continue;
+        }
+
+        if (token == JSON_TOKEN_COMMA) {
+            continue;
+        }
+
+        if (token != JSON_TOKEN_STRING) {
+            load_err = AKINATOR_DATABASE_PARSE_ERROR;
+            break;
+        }
+
+        JsonKey key = JsonReaderGetKey(&reader);
+
+        if (JsonReaderNext(&reader) != JSON_TOKEN_COLON) {
+            load_err = AKINATOR_DATABASE_PARSE_ERROR;
+            break;
+        }
+
+        token = JsonReaderNext(&reader);
+        TreeNode* node = stack[stack_size - 1].node;
+
+        if (key == JSON_KEY_TEXT && token == JSON_TOKEN_STRING) {
+            if (!node->value.Assign(reader.string, reader.string_len)) {
+                load_err = AKINATOR_NODE_ALLOC_ERROR;
+            }
+        }
+        else if ((key == JSON_KEY_NO || key == JSON_KEY_YES) && token == JSON_TOKEN_OBJECT_BEGIN) {
+            JsonFrame* frame = JsonStackPush(&stack, &stack_size, &stack_capacity);
+            TreeNode* child = (frame == NULL) ? NULL : JsonNodeAttach(tree, node, key);
+
+            if (child == NULL) {
+                load_err = AKINATOR_NODE_ALLOC_ERROR;
+            }
+            else {
+                frame->node = child;
+            }
+        }
+        else if ((key == JSON_KEY_NO || key == JSON_KEY_YES) && token == JSON_TOKEN_NULL) {
+            continue;
+        }
+        else if (key != JSON_KEY_OTHER || !JsonReaderSkipValue(&reader, token)) {
+            load_err = AKINATOR_DATABASE_PARSE_ERROR;
+        }
+    }
+
+    free(stack);
+    JsonReaderDestroy(&reader);
+
+    return load_err;
+}
+
+static AkinatorError AkinatorJsonLinesAddNode(TreeNode*** nodes, size_t* nodes_capacity, size_t id, TreeNode* node) {
+    assert(nodes != NULL);
+    assert(nodes_capacity != NULL);
+
+    if (id >= *nodes_capacity) {
+        size_t new_capacity = (*nodes_capacity == 0) ? AKINATOR_JSON_START_STACK_CAPACITY : *nodes_capacity;
+        while (new_capacity <= id) {
+            new_capacity *= 2;
+        }
+
+        TreeNode** new_nodes = (TreeNode**)realloc(*nodes, new_capacity * sizeof(TreeNode*));
+        if (new_nodes == NULL) {
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+
+        memset(new_nodes + *nodes_capacity, 0, (new_capacity - *nodes_capacity) * sizeof(TreeNode*));
+
+        *nodes = new_nodes;
+        *nodes_capacity = new_capacity;
+    }
+
+    (*nodes)[id] = node;
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorJsonLinesLoad(Tree* tree, FILE* json_lines_file) {
+    assert(tree != NULL);
+    assert(json_lines_file != NULL);
+
+    JsonReader reader = {};
+    AkinatorError reader_err = JsonReaderInit(&reader, json_lines_file);
+    if (reader_err != AKINATOR_OK) {
+        return reader_err;
+    }
+
+    AkinatorError load_err = AKINATOR_OK;
+
+    TreeNode** nodes = NULL;
+    size_t nodes_capacity = 0;
+
+    JsonTokenType token = JsonReaderNext(&reader);
+
+    while (load_err == AKINATOR_OK && token == JSON_TOKEN_OBJECT_BEGIN) {
+        long long id = -1;
+        long long parent_id = -1;
+        JsonKey side = JSON_KEY_OTHER;
+
+        TreeNode* node = TreeNodeInit("");
+        if (node == NULL) {
+            load_err = AKINATOR_NODE_ALLOC_ERROR;
+            break;
+        }
+
+        while (load_err == AKINATOR_OK) {
+            token = JsonReaderNext(&reader);
+
+            if (token == JSON_TOKEN_OBJECT_END) {
+                break;
+            }
+
+            if (token == JSON_TOKEN_COMMA) {
+                continue;
+            }
+
+            if (token != JSON_TOKEN_STRING) {
+                load_err = AKINATOR_DATABASE_PARSE_ERROR;
+                break;
+            }
+
+            JsonKey key = JsonReaderGetKey(&reader);
+
+            if (JsonReaderNext(&reader) != JSON_TOKEN_COLON) {
+                load_err = AKINATOR_DATABASE_PARSE_ERROR;
+                break;
+            }
+
+            token = JsonReaderNext(&reader);
+
+            if (key == JSON_KEY_ID && token == JSON_TOKEN_NUMBER) {
+                id = reader.number;
+            }
+            else if (key == JSON_KEY_PARENT && (token == JSON_TOKEN_NUMBER || token == JSON_TOKEN_NULL)) {
+                parent_id = (token == JSON_TOKEN_NULL) ? -1 : reader.number;
+            }
+            else if (key == JSON_KEY_SIDE && token == JSON_TOKEN_STRING) {
+                side = JsonReaderGetKey(&reader);
+            }
+            else if (key == JSON_KEY_TEXT && token == JSON_TOKEN_STRING) {
+                if (!node->value.Assign(reader.string, reader.string_len)) {
+                    load_err = AKINATOR_NODE_ALLOC_ERROR;
+                }
+            }
+            else if (key != JSON_KEY_OTHER || !JsonReaderSkipValue(&reader, token)) {
+                load_err = AKINATOR_DATABASE_PARSE_ERROR;
+            }
+        }
+
+        bool has_parent = 0 <= parent_id && (size_t)parent_id < nodes_capacity && nodes[parent_id] != NULL;
+        bool is_new_id = 0 <= id && ((size_t)id >= nodes_capacity || nodes[id] == NULL);
+
+        if (load_err == AKINATOR_OK && !is_new_id) {
+            TreeNodeDestroy(&node);
+            load_err = AKINATOR_DATABASE_PARSE_ERROR;
+            break;
+        }
+
+        if (load_err == AKINATOR_OK && id >= 0 && parent_id < 0 && TreeNodeGetLeft(TreeGetRoot(tree)) == NULL) {
+            TreeNodeLinkLeft(TreeGetRoot(tree), node);
+        }
+        else if (load_err == AKINATOR_OK && id >= 0 && has_parent && side == JSON_KEY_NO && TreeNodeGetLeft(nodes[parent_id]) == NULL) {
+            TreeNodeLinkLeft(nodes[parent_id], node);
+        }
+        else if (load_err == AKINATOR_OK && id >= 0 && has_parent && side == JSON_KEY_YES && TreeNodeGetRight(nodes[parent_id]) == NULL) {
+            TreeNodeLinkRight(nodes[parent_id], node);
+        }
+        else {
+            TreeNodeDestroy(&node);
+            if (load_err == AKINATOR_OK) {
+                load_err = AKINATOR_DATABASE_PARSE_ERROR;
+            }
+            break;
+        }
+
+        tree->size++;
+
+        load_err = AkinatorJsonLinesAddNode(&nodes, &nodes_capacity, (size_t)id, node);
+
+        token = JsonReaderNext(&reader);
+    }
+
+    if (load_err == AKINATOR_OK && token != JSON_TOKEN_END) {
+        load_err = AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    if (load_err == AKINATOR_OK && TreeNodeGetLeft(TreeGetRoot(tree)) == NULL) {
+        load_err = AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    free(nodes);
+    JsonReaderDestroy(&reader);
+
+    return load_err;
+}
@@ -0,0 +1,597 @@
+#include "akinator_lazy.hpp"
+
+#include <stdio.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "tree_hash.hpp"
+#include "utils.hpp"
+
+static const uint64_t AKINATOR_LAZY_EXPANDED = 1ull << 63;
+
+static uint64_t AkinatorLazyMapHash(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 27;
+    key *= 0x94D049BB133111EBull;
+    key ^= key >> 31;
+
+    return key;
+}
+
+/// Возвращает ячейку с ключом key или пустую ячейку, куда его можно положить
+static AkinatorLazyMapEntry* AkinatorLazyMapSlot(AkinatorLazyMapEntry* entries, size_t capacity, uint64_t key) {
+    assert(entries != NULL);
+    assert(key != 0);
+
+    size_t slot = AkinatorLazyMapHash(key) & (capacity - 1);
+
+    while (entries[slot].key != 0 && entries[slot].key != key) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return &entries[slot];
+}
+
+static bool AkinatorLazyMapPut(AkinatorLazyMap* map, uint64_t key, uint64_t value) {
+    assert(map != NULL);
+
+    if (2 * (map->size + 1) > map->capacity) {
+        size_t new_capacity = (map->capacity == 0) ? AKINATOR_LAZY_START_CAPACITY : 2 * map->capacity;
+
+        AkinatorLazyMapEntry* new_entries = (AkinatorLazyMapEntry*)calloc(new_capacity, sizeof(AkinatorLazyMapEntry));
+        if (new_entries == NULL) {
+            return false;
+        }
+
+        for (size_t entry_i = 0; entry_i < map->capacity; entry_i++) {
+            if (map->entries[entry_i].key != 0) {
+                *AkinatorLazyMapSlot(new_entries, new_capacity, map->entries[entry_i].key) = map->entries[entry_i];
+            }
+        }
+
+        PROTECTED_FREE(map->entries);
+
+        map->entries = new_entries;
+        map->capacity = new_capacity;
+    }
+
+    AkinatorLazyMapEntry* entry = AkinatorLazyMapSlot(map->entries, map->capacity, key);
+    if (entry->key == 0) {
+        map->size++;
+    }
+
+    *entry = {key, value};
+
+    return true;
+}
+
+static bool AkinatorLazyMapGet(AkinatorLazyMap* map, uint64_t key, uint64_t* value) {
+    assert(map != NULL);
+    assert(value != NULL);
+
+    if (map->capacity == 0) {
+        return false;
+    }
+
+    AkinatorLazyMapEntry* entry = AkinatorLazyMapSlot(map->entries, map->capacity, key);
+    if (entry->key == 0) {
+        return false;
+    }
+
+    *value = entry->value;
+
+    return true;
+}
+
+struct AkinatorLazyBuildFrame {
+    uint32_t id;
+    uint32_t child_count;
+};
+
+static bool AkinatorLazyIsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// Один проход по тексту базы без создания вершин: та же грамматика, что у AkinatorTreeBuild
+static AkinatorError AkinatorLazyBuildIndex(AkinatorLazy* lazy) {
+    assert(lazy != NULL);
+
+    const char* text = lazy->database;
+    size_t size = lazy->database_size;
+    size_t pos = 0;
+
+    AkinatorLazyIndexRecord* records = NULL;
+    size_t records_size = 0;
+    size_t records_capacity = 0;
+
+    AkinatorLazyBuildFrame* stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    AkinatorError build_err = AKINATOR_OK;
+
+    while (build_err == AKINATOR_OK) {
+        while (pos < size && AkinatorLazyIsSpace(text[pos])) {
+            pos++;
+        }
+
+        if (pos == size) {
+            break;
+        }
+
+        if (text[pos] == '}') {
+            pos++;
+
+            if (stack_size == 0 || stack[stack_size - 1].child_count != 2) {
+                build_err = AKINATOR_DATABASE_PARSE_ERROR;
+            }
+            else {
+                stack_size--;
+            }
+
+            continue;
+        }
+
+        if (text[pos] != '{') {
+            build_err = AKINATOR_DATABASE_PARSE_ERROR;
+            continue;
+        }
+
+        pos++;
+        while (pos < size && AkinatorLazyIsSpace(text[pos])) {
+            pos++;
+        }
+
+        const char* line_end = (const char*)memchr(text + pos, '\n', size - pos);
+        size_t value_end = (line_end == NULL) ? size : (size_t)(line_end - text);
+
+        size_t value_offset = pos;
+        size_t value_len = value_end - value_offset;
+        pos = value_end;
+
+        bool is_nil = (value_len == 4 && memcmp(text + value_offset, "nil}", 4) == 0);
+
+        uint32_t child = AKINATOR_LAZY_NIL;
+
+        if (!is_nil) {
+            if (records_size >= AKINATOR_LAZY_NIL || (records_size > 0 && stack_size == 0)) {
+                build_err = AKINATOR_DATABASE_PARSE_ERROR;
+                continue;
+            }
+
+            if (records_size == records_capacity) {
+                size_t new_capacity = (records_capacity == 0) ? AKINATOR_LAZY_START_CAPACITY : 2 * records_capacity;
+
+                AkinatorLazyIndexRecord* new_records = (AkinatorLazyIndexRecord*)realloc(records, new_capacity * sizeof(AkinatorLazyIndexRecord));
+                if (new_records == NULL) {
+                    build_err = AKINATOR_NODE_ALLOC_ERROR;
+                    continue;
+                }
+
+                records = new_records;
+                records_capacity = new_capacity;
+            }
+
+            child = (uint32_t)records_size;
+
+            records[records_size++] = {value_offset,
+                                       (uint32_t)((value_len < MAX_TREE_CHAR_SIZE) ? value_len : MAX_TREE_CHAR_SIZE),
+                                       AKINATOR_LAZY_NIL, AKINATOR_LAZY_NIL,
+                                       (stack_size == 0) ? AKINATOR_LAZY_NIL : stack[stack_size - 1].id};
+        }
+        else if (stack_size == 0) {
+            build_err = AKINATOR_DATABASE_PARSE_ERROR;
+            continue;
+        }
+
+        if (stack_size > 0) {
+            AkinatorLazyBuildFrame* top = &stack[stack_size - 1];
+
+            if (top->child_count == 0) {
+                records[top->id].left = child;
+            }
+            else if (top->child_count == 1) {
+                records[top->id].right = child;
+            }
+            else {
+                build_err = AKINATOR_DATABASE_PARSE_ERROR;
+                continue;
+            }
+
+            top->child_count++;
+        }
+
+        if (is_nil) {
+            continue;
+        }
+
+        if (stack_size == stack_capacity) {
+            size_t new_capacity = (stack_capacity == 0) ? AKINATOR_LAZY_START_CAPACITY : 2 * stack_capacity;
+
+            AkinatorLazyBuildFrame* new_stack = (AkinatorLazyBuildFrame*)realloc(stack, new_capacity * sizeof(AkinatorLazyBuildFrame));
+            if (new_stack == NULL) {
+                build_err = AKINATOR_NODE_ALLOC_ERROR;
+                continue;
+            }
+
+            stack = new_stack;
+            stack_capacity = new_capacity;
+        }
+
+        stack[stack_size++] = {child, 0};
+    }
+
+    if (build_err == AKINATOR_OK && (stack_size != 0 || records_size == 0)) {
+        build_err = AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    PROTECTED_FREE(stack);
+
+    if (build_err != AKINATOR_OK) {
+        PROTECTED_FREE(records);
+        return build_err;
+    }
+
+    lazy->index_buffer = records;
+    lazy->records = records;
+    lazy->node_count = records_size;
+
+    return AKINATOR_OK;
+}
+
+/// Отображает в память индекс, если он есть и построен по этой же версии базы
+static bool AkinatorLazyMapIndex(AkinatorLazy* lazy, const char* index_file_name, const struct stat* database_stat) {
+    assert(lazy != NULL);
+    assert(index_file_name != NULL);
+    assert(database_stat != NULL);
+
+    int index_fd = open(index_file_name, O_RDONLY);
+    if (index_fd < 0) {
+        return false;
+    }
+
+    struct stat index_stat = {};
+    bool is_mapped = false;
+
+    if (fstat(index_fd, &index_stat) == 0 && (size_t)index_stat.st_size >= sizeof(AkinatorLazyIndexHeader)) {
+        void* index_map = mmap(NULL, (size_t)index_stat.st_size, PROT_READ, MAP_PRIVATE, index_fd, 0);
+
+        if (index_map != MAP_FAILED) {
+            const AkinatorLazyIndexHeader* header = (const AkinatorLazyIndexHeader*)index_map;
+
+            is_mapped = header->magic == AKINATOR_LAZY_INDEX_MAGIC
+                        && header->node_count > 0
+                        && header->database_size == (uint64_t)database_stat->st_size
+                        && header->database_mtime_sec == (int64_t)database_stat->st_mtim.tv_sec
+                        && header->database_mtime_nsec == (int64_t)database_stat->st_mtim.tv_nsec
+                        && (size_t)index_stat.st_size == sizeof(AkinatorLazyIndexHeader)
+                                                         + header->node_count * sizeof(AkinatorLazyIndexRecord);
+
+            if (is_mapped) {
+                lazy->index_map = index_map;
+                lazy->index_map_size = (size_t)index_stat.st_size;
+                lazy->records = (const AkinatorLazyIndexRecord*)(header + 1);
+                lazy->node_count = header->node_count;
+            }
+            else {
+                munmap(index_map, (size_t)index_stat.st_size);
+            }
+        }
+    }
+
+    close(index_fd);
+
+    return is_mapped;
+}
+
+/// Сохраняет построенный индекс рядом с базой; если записать не удалось, индекс просто остается в памяти
+static void AkinatorLazyWriteIndex(AkinatorLazy* lazy, const char* index_file_name, const struct stat* database_stat) {
+    assert(lazy != NULL);
+    assert(index_file_name != NULL);
+    assert(database_stat != NULL);
+
+    FILE* index_file = fopen(index_file_name, "wb");
+    if (index_file == NULL) {
+        return;
+    }
+
+    AkinatorLazyIndexHeader header = {AKINATOR_LAZY_INDEX_MAGIC, lazy->node_count, (uint64_t)database_stat->st_size,
+                                      (int64_t)database_stat->st_mtim.tv_sec, (int64_t)database_stat->st_mtim.tv_nsec};
+
+    bool is_written = fwrite(&header, sizeof(header), 1, index_file) == 1
+                      && fwrite(lazy->records, sizeof(AkinatorLazyIndexRecord), lazy->node_count, index_file) == lazy->node_count;
+
+    if (fclose(index_file) != 0 || !is_written) {
+        remove(index_file_name);
+    }
+}
+
+/// Создает вершину номер id и запоминает ее; у листьев нечего раскрывать, поэтому они сразу помечены раскрытыми
+static TreeNode* AkinatorLazyCreateNode(AkinatorLazy* lazy, uint32_t id) {
+    assert(lazy != NULL);
+    assert(id < lazy->node_count);
+
+    const AkinatorLazyIndexRecord* record = &lazy->records[id];
+
+    TreeNode* node = TreeNodeInit(TreeString(lazy->database + record->value_offset, record->value_len));
+    if (node == NULL) {
+        return NULL;
+    }
+
+    bool is_leaf = record->left == AKINATOR_LAZY_NIL && record->right == AKINATOR_LAZY_NIL;
+
+    if (!AkinatorLazyMapPut(&lazy->node_ids, (uintptr_t)node, id | (is_leaf ? AKINATOR_LAZY_EXPANDED : 0))
+        || !AkinatorLazyMapPut(&lazy->id_nodes, id + 1ull, (uintptr_t)node)) {
+        TreeNodeDestroy(&node);
+        return NULL;
+    }
+
+    lazy->loaded_count++;
+
+    return node;
+}
+
+AkinatorError AkinatorLazyLoadFile(Akinator* akinator, const char* database_file_name) {
+    assert(akinator != NULL);
+    assert(database_file_name != NULL);
+    assert(akinator->lazy == NULL);
+
+    TRACE_SCOPE("AkinatorLazyLoadFile", TRACE_WORK);
+
+    uint64_t start_ns = MetricsNow();
+
+    char index_file_name[MAX_FILE_NAME_LEN + sizeof(AKINATOR_LAZY_INDEX_EXTENSION)] = {};
+    snprintf(index_file_name, sizeof(index_file_name), "%s%s", database_file_name, AKINATOR_LAZY_INDEX_EXTENSION);
+
+    int database_fd = open(database_file_name, O_RDONLY);
+    if (database_fd < 0) {
+        return AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    }
+
+    struct stat database_stat = {};
+    if (fstat(database_fd, &database_stat) != 0 || database_stat.st_size == 0) {
+        close(database_fd);
+        return AKINATOR_DATABASE_PARSE_ERROR;
+    }
+
+    void* database = mmap(NULL, (size_t)database_stat.st_size, PROT_READ, MAP_PRIVATE, database_fd, 0);
+    close(database_fd);
+
+    if (database == MAP_FAILED) {
+        return AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    }
+
+    AkinatorLazy* lazy = (AkinatorLazy*)calloc(1, sizeof(AkinatorLazy));
+    if (lazy == NULL) {
+        munmap(database, (size_t)database_stat.st_size);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    lazy->database = (char*)database;
+    lazy->database_size = (size_t)database_stat.st_size;
+    akinator->lazy = lazy;
+
+    if (!AkinatorLazyMapIndex(lazy, index_file_name, &database_stat)) {
+        AkinatorError build_err = TRACE_CALL("AkinatorLazyBuildIndex", TRACE_WORK, AkinatorLazyBuildIndex(lazy));
+        if (build_err != AKINATOR_OK) {
+            return build_err;
+        }
+
+        AkinatorLazyWriteIndex(lazy, index_file_name, &database_stat);
+    }
+
+    TreeNode* first_node = AkinatorLazyCreateNode(lazy, 0);
+    if (first_node == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    TreeNodeLinkLeft(TreeGetRoot(&akinator->tree), first_node);
+    akinator->tree.size = 1;
+
+    MetricsRecord(METRICS_LOAD, MetricsNow() - start_ns);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorLazyDestroy(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    AkinatorLazy* lazy = akinator->lazy;
+    if (lazy == NULL) {
+        return AKINATOR_OK;
+    }
+
+    munmap(lazy->database, lazy->database_size);
+
+    if (lazy->index_map != NULL) {
+        munmap(lazy->index_map, lazy->index_map_size);
+    }
+
+    PROTECTED_FREE(lazy->index_buffer);
+    PROTECTED_FREE(lazy->node_ids.entries);
+    PROTECTED_FREE(lazy->id_nodes.entries);
+    PROTECTED_FREE(akinator->lazy);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorLazyExpand(Akinator* akinator, TreeNode* node) {
+    assert(akinator != NULL);
+    assert(node != NULL);
+
+    AkinatorLazy* lazy = akinator->lazy;
+    if (lazy == NULL) {
+        return AKINATOR_OK;
+    }
+
+    uint64_t state = 0;
+    if (!AkinatorLazyMapGet(&lazy->node_ids, (uintptr_t)node, &state) || (state & AKINATOR_LAZY_EXPANDED) != 0) {
+        return AKINATOR_OK;
+    }
+
+    const AkinatorLazyIndexRecord* record = &lazy->records[state];
+
+    TreeNode* left = (record->left == AKINATOR_LAZY_NIL) ? NULL : AkinatorLazyCreateNode(lazy, record->left);
+    TreeNode* right = (record->right == AKINATOR_LAZY_NIL) ? NULL : AkinatorLazyCreateNode(lazy, record->right);
+
+    if ((record->left != AKINATOR_LAZY_NIL && left == NULL) || (record->right != AKINATOR_LAZY_NIL && right == NULL)) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    TreeNodeLinkLeft(node, left);
+    TreeNodeLinkRight(node, right);
+    akinator->tree.size += (size_t)(left != NULL) + (size_t)(right != NULL);
+
+    if (!AkinatorLazyMapPut(&lazy->node_ids, (uintptr_t)node, state | AKINATOR_LAZY_EXPANDED)) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorLazyExpandAll(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    if (akinator->lazy == NULL) {
+        return AKINATOR_OK;
+    }
+
+    TRACE_SCOPE("AkinatorLazyExpandAll", TRACE_WORK);
+
+    TreeNode** stack = (TreeNode**)calloc(AKINATOR_LAZY_START_CAPACITY, sizeof(TreeNode*));
+    if (stack == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    size_t stack_size = 0;
+    size_t stack_capacity = AKINATOR_LAZY_START_CAPACITY;
+
+    stack[stack_size++] = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    while (stack_size > 0) {
+        TreeNode* node = stack[--stack_size];
+
+        AkinatorError expand_err = AkinatorLazyExpand(akinator, node);
+        if (expand_err != AKINATOR_OK) {
+            PROTECTED_FREE(stack);
+            return expand_err;
+        }
+
+        if (stack_size + 2 > stack_capacity) {
+            TreeNode** new_stack = (TreeNode**)realloc(stack, 2 * stack_capacity * sizeof(TreeNode*));
+            if (new_stack == NULL) {
+                PROTECTED_FREE(stack);
+                return AKINATOR_NODE_ALLOC_ERROR;
+            }
+
+            stack = new_stack;
+            stack_capacity *= 2;
+        }
+
+        if (TreeNodeGetRight(node) != NULL) {
+            stack[stack_size++] = TreeNodeGetRight(node);
+        }
+
+        if (TreeNodeGetLeft(node) != NULL) {
+            stack[stack_size++] = TreeNodeGetLeft(node);
+        }
+    }
+
+    PROTECTED_FREE(stack);
+
+    AkinatorLazyDestroy(akinator);
+
+    if (TreeHashSubTree(TreeGetRoot(&akinator->tree)) != TREE_OK) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    NameIndexDestroy(&akinator->name_index);
+    if (NameIndexInit(&akinator->name_index) != NAME_INDEX_OK || NameIndexBuild(&akinator->name_index, first_node) != NAME_INDEX_OK) {
+        return AKINATOR_NAME_INDEX_ERROR;
+    }
+
+    RadixTrieDestroy(&akinator->value_trie);
+    if (RadixTrieInit(&akinator->value_trie) != RADIX_TRIE_OK || RadixTrieBuild(&akinator->value_trie, first_node) != RADIX_TRIE_OK) {
+        return AKINATOR_RADIX_TRIE_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+TreeNode* AkinatorLazyFind(Akinator* akinator, const char* name) {
+    assert(akinator != NULL);
+    assert(name != NULL);
+
+    AkinatorLazy* lazy = akinator->lazy;
+    if (lazy == NULL) {
+        return NULL;
+    }
+
+    TRACE_SCOPE("AkinatorLazyFind", TRACE_WORK);
+
+    size_t name_len = strlen(name);
+    uint32_t leaf_id = AKINATOR_LAZY_NIL;
+
+    for (size_t id = 0; id < lazy->node_count; id++) {
+        const AkinatorLazyIndexRecord* record = &lazy->records[id];
+
+        if (record->left == AKINATOR_LAZY_NIL && record->right == AKINATOR_LAZY_NIL && record->value_len == name_len
+            && memcmp(lazy->database + record->value_offset, name, name_len) == 0) {
+            leaf_id = (uint32_t)id;
+            break;
+        }
+    }
+
+    if (leaf_id == AKINATOR_LAZY_NIL) {
+        return NULL;
+    }
+
+    uint32_t* path = NULL;
+    size_t path_size = 0;
+    size_t path_capacity = 0;
+
+    uint64_t node_value = 0;
+    uint32_t id = leaf_id;
+
+    while (!AkinatorLazyMapGet(&lazy->id_nodes, id + 1ull, &node_value)) {
+        if (path_size == path_capacity) {
+            size_t new_capacity = (path_capacity == 0) ? AKINATOR_LAZY_START_CAPACITY : 2 * path_capacity;
+
+            uint32_t* new_path = (uint32_t*)realloc(path, new_capacity * sizeof(uint32_t));
+            if (new_path == NULL) {
+                PROTECTED_FREE(path);
+                return NULL;
+            }
+
+            path = new_path;
+            path_capacity = new_capacity;
+        }
+
+        path[path_size++] = id;
+        id = lazy->records[id].parent;
+    }
+
+    TreeNode* node = (TreeNode*)node_value;
+
+    while (path_size > 0) {
+        if (AkinatorLazyExpand(akinator, node) != AKINATOR_OK
+            || !AkinatorLazyMapGet(&lazy->id_nodes, path[--path_size] + 1ull, &node_value)) {
+            PROTECTED_FREE(path);
+            return NULL;
+        }
+
+        node = (TreeNode*)node_value;
+    }
+
+    PROTECTED_FREE(path);
+
+    return node;
+}
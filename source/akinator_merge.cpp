@@ -0,0 +1,730 @@
+#include "akinator_merge.hpp"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdarg.h>
+
+#include "utils.hpp"
+
+enum AkinatorMergeTokenType {
+    AKINATOR_MERGE_TOKEN_NODE  =  0,
+    AKINATOR_MERGE_TOKEN_NIL   =  1,
+    AKINATOR_MERGE_TOKEN_CLOSE =  2,
+    AKINATOR_MERGE_TOKEN_END   =  3,
+    AKINATOR_MERGE_TOKEN_ERROR =  4
+};
+
+struct AkinatorMergeToken {
+    AkinatorMergeTokenType type;
+
+    char value[1 + MAX_TREE_CHAR_SIZE];
+};
+
+/// Читает лексемы текстового формата построчно и позволяет заглянуть на AKINATOR_MERGE_LOOKAHEAD вперед
+struct AkinatorMergeReader {
+    FILE* file;
+
+    AkinatorMergeToken tokens[AKINATOR_MERGE_LOOKAHEAD];
+    size_t head;
+    size_t count;
+
+    char line[MAX_TREE_CHAR_SIZE + 3];
+};
+
+enum AkinatorMergeFrameType {
+    AKINATOR_MERGE_FRAME_SUBTREE =  0,
+    AKINATOR_MERGE_FRAME_CLOSE   =  1
+};
+
+struct AkinatorMergeFrame {
+    AkinatorMergeFrameType type;
+
+    size_t depth;
+    char answer;
+};
+
+struct AkinatorMerger {
+    AkinatorMergeReader base;
+    AkinatorMergeReader first;
+    AkinatorMergeReader second;
+
+    FILE* merged_file;
+    FILE* report;
+
+    AkinatorMergeFrame* frames;
+    size_t frames_size;
+    size_t frames_capacity;
+
+    char* path;
+    size_t path_capacity;
+
+    AkinatorMergeStats* stats;
+};
+
+/// Возвращает строку без ведущих пробелов и перевода строки или NULL в конце файла; отступы пропускаются
+/// до чтения в буфер, как в fscanf(" %[^\n]"), поэтому глубина вершины не ограничивает длину строки
+static char* AkinatorMergeReadLine(AkinatorMergeReader* reader, bool* is_too_long) {
+    assert(reader != NULL);
+    assert(is_too_long != NULL);
+
+    *is_too_long = false;
+
+    int symbol = getc(reader->file);
+    while (symbol != EOF && isspace(symbol)) {
+        symbol = getc(reader->file);
+    }
+
+    if (symbol == EOF || ungetc(symbol, reader->file) == EOF) {
+        return NULL;
+    }
+
+    if (fgets(reader->line, sizeof(reader->line), reader->file) == NULL) {
+        return NULL;
+    }
+
+    size_t line_len = strlen(reader->line);
+
+    if (line_len > 0 && reader->line[line_len - 1] == '\n') {
+        reader->line[--line_len] = '\0';
+    }
+    else if (!feof(reader->file)) {
+        *is_too_long = true;
+        return NULL;
+    }
+
+    return reader->line;
+}
+
+static void AkinatorMergeReadToken(AkinatorMergeReader* reader, AkinatorMergeToken* token) {
+    assert(reader != NULL);
+    assert(token != NULL);
+
+    bool is_too_long = false;
+
+    char* text = AkinatorMergeReadLine(reader, &is_too_long);
+    if (text == NULL) {
+        token->type = is_too_long ? AKINATOR_MERGE_TOKEN_ERROR : AKINATOR_MERGE_TOKEN_END;
+        return;
+    }
+
+    if (strcmp(text, "}") == 0) {
+        token->type = AKINATOR_MERGE_TOKEN_CLOSE;
+        return;
+    }
+
+    if (*text != '{') {
+        token->type = AKINATOR_MERGE_TOKEN_ERROR;
+        return;
+    }
+
+    text++;
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+
+    if (strcmp(text, "nil}") == 0) {
+        token->type = AKINATOR_MERGE_TOKEN_NIL;
+        return;
+    }
+
+    if (*text == '\0') {
+        text = AkinatorMergeReadLine(reader, &is_too_long);
+        if (text == NULL) {
+            token->type = AKINATOR_MERGE_TOKEN_ERROR;
+            return;
+        }
+    }
+
+    token->type = AKINATOR_MERGE_TOKEN_NODE;
+    strncpy(token->value, text, MAX_TREE_CHAR_SIZE);
+    token->value[MAX_TREE_CHAR_SIZE] = '\0';
+}
+
+static const AkinatorMergeToken* AkinatorMergePeek(AkinatorMergeReader* reader, size_t offset) {
+    assert(reader != NULL);
+    assert(offset < AKINATOR_MERGE_LOOKAHEAD);
+
+    while (reader->count <= offset) {
+        AkinatorMergeReadToken(reader, &reader->tokens[(reader->head + reader->count) % AKINATOR_MERGE_LOOKAHEAD]);
+        reader->count++;
+    }
+
+    return &reader->tokens[(reader->head + offset) % AKINATOR_MERGE_LOOKAHEAD];
+}
+
+static void AkinatorMergeSkip(AkinatorMergeReader* reader, size_t token_count) {
+    assert(reader != NULL);
+
+    for (size_t token_i = 0; token_i < token_count; token_i++) {
+        AkinatorMergePeek(reader, 0);
+
+        reader->head = (reader->head + 1) % AKINATOR_MERGE_LOOKAHEAD;
+        reader->count--;
+    }
+}
+
+/// Проверяет, что впереди лист, и возвращает его текст
+static const char* AkinatorMergePeekLeaf(AkinatorMergeReader* reader) {
+    assert(reader != NULL);
+
+    const AkinatorMergeToken* node = AkinatorMergePeek(reader, 0);
+
+    bool is_leaf = node->type == AKINATOR_MERGE_TOKEN_NODE
+                   && AkinatorMergePeek(reader, 1)->type == AKINATOR_MERGE_TOKEN_NIL
+                   && AkinatorMergePeek(reader, 2)->type == AKINATOR_MERGE_TOKEN_NIL
+                   && AkinatorMergePeek(reader, 3)->type == AKINATOR_MERGE_TOKEN_CLOSE;
+
+    return is_leaf ? node->value : NULL;
+}
+
+/// Место читателя в файле вместе с уже прочитанными вперед лексемами
+struct AkinatorMergeMark {
+    long position;
+
+    AkinatorMergeToken tokens[AKINATOR_MERGE_LOOKAHEAD];
+    size_t head;
+    size_t count;
+};
+
+static bool AkinatorMergeSetMark(AkinatorMergeReader* reader, AkinatorMergeMark* mark) {
+    assert(reader != NULL);
+    assert(mark != NULL);
+
+    mark->position = ftell(reader->file);
+    memcpy(mark->tokens, reader->tokens, sizeof(mark->tokens));
+    mark->head = reader->head;
+    mark->count = reader->count;
+
+    return mark->position >= 0;
+}
+
+static bool AkinatorMergeRewind(AkinatorMergeReader* reader, const AkinatorMergeMark* mark) {
+    assert(reader != NULL);
+    assert(mark != NULL);
+
+    memcpy(reader->tokens, mark->tokens, sizeof(reader->tokens));
+    reader->head = mark->head;
+    reader->count = mark->count;
+
+    return fseek(reader->file, mark->position, SEEK_SET) == 0;
+}
+
+/// Сравнивает поддеревья впереди в first и second по лексемам и возвращает обоих читателей на место,
+/// так что память не зависит от размера поддеревьев
+static AkinatorError AkinatorMergeIsSameSubtree(AkinatorMergeReader* first, AkinatorMergeReader* second, bool* is_same) {
+    assert(first != NULL);
+    assert(second != NULL);
+    assert(is_same != NULL);
+
+    AkinatorMergeMark first_mark = {};
+    AkinatorMergeMark second_mark = {};
+
+    if (!AkinatorMergeSetMark(first, &first_mark) || !AkinatorMergeSetMark(second, &second_mark)) {
+        return AKINATOR_MERGE_ERROR;
+    }
+
+    *is_same = true;
+    size_t level = 0;
+
+    do {
+        const AkinatorMergeToken* first_token = AkinatorMergePeek(first, 0);
+        const AkinatorMergeToken* second_token = AkinatorMergePeek(second, 0);
+
+        if (first_token->type != second_token->type
+            || (first_token->type == AKINATOR_MERGE_TOKEN_NODE && strcmp(first_token->value, second_token->value) != 0)
+            || first_token->type == AKINATOR_MERGE_TOKEN_END || first_token->type == AKINATOR_MERGE_TOKEN_ERROR
+            || (first_token->type == AKINATOR_MERGE_TOKEN_CLOSE && level == 0)) {
+            *is_same = false;
+            break;
+        }
+
+        if (first_token->type == AKINATOR_MERGE_TOKEN_NODE) {
+            level++;
+        }
+        else if (first_token->type == AKINATOR_MERGE_TOKEN_CLOSE) {
+            level--;
+        }
+
+        AkinatorMergeSkip(first, 1);
+        AkinatorMergeSkip(second, 1);
+    } while (level > 0);
+
+    if (!AkinatorMergeRewind(first, &first_mark) || !AkinatorMergeRewind(second, &second_mark)) {
+        return AKINATOR_MERGE_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+static void AkinatorMergeWriteTabs(FILE* merged_file, size_t depth) {
+    assert(merged_file != NULL);
+
+    if (depth > MAX_INDENT_DEPTH) {
+        depth = MAX_INDENT_DEPTH;
+    }
+
+    for (size_t tab_i = 0; tab_i < depth; tab_i++) {
+        fputc('\t', merged_file);
+    }
+}
+
+static void AkinatorMergeWriteToken(FILE* merged_file, const AkinatorMergeToken* token, size_t depth) {
+    assert(token != NULL);
+
+    if (merged_file == NULL) {
+        return;
+    }
+
+    AkinatorMergeWriteTabs(merged_file, depth);
+
+    switch (token->type) {
+        case AKINATOR_MERGE_TOKEN_NODE:
+            fprintf(merged_file, "{\n");
+            AkinatorMergeWriteTabs(merged_file, depth);
+            fprintf(merged_file, "%s\n", token->value);
+            break;
+        case AKINATOR_MERGE_TOKEN_NIL:
+            fprintf(merged_file, "{nil}\n");
+            break;
+        case AKINATOR_MERGE_TOKEN_CLOSE:
+            fprintf(merged_file, "}\n");
+            break;
+        case AKINATOR_MERGE_TOKEN_END:
+        case AKINATOR_MERGE_TOKEN_ERROR:
+        default:
+            break;
+    }
+}
+
+/// Переписывает поддерево из reader в merged_file (или пропускает, если merged_file NULL).
+/// Если задан leaf_value, первый такой лист заменяется поддеревом из replacement, а *is_replaced становится true
+static AkinatorError AkinatorMergeCopy(AkinatorMergeReader* reader, FILE* merged_file, size_t depth,
+                                       const char* leaf_value, AkinatorMergeReader* replacement, bool* is_replaced) {
+    assert(reader != NULL);
+
+    size_t level = 0;
+
+    do {
+        if (leaf_value != NULL && !*is_replaced) {
+            const char* value = AkinatorMergePeekLeaf(reader);
+
+            if (value != NULL && strcmp(value, leaf_value) == 0) {
+                AkinatorMergeSkip(reader, AKINATOR_MERGE_LOOKAHEAD);
+                *is_replaced = true;
+
+                AkinatorError replace_err = AkinatorMergeCopy(replacement, merged_file, depth + level, NULL, NULL, NULL);
+                if (replace_err != AKINATOR_OK) {
+                    return replace_err;
+                }
+
+                continue;
+            }
+        }
+
+        const AkinatorMergeToken* token = AkinatorMergePeek(reader, 0);
+
+        switch (token->type) {
+            case AKINATOR_MERGE_TOKEN_NODE:
+                AkinatorMergeWriteToken(merged_file, token, depth + level);
+                level++;
+                break;
+            case AKINATOR_MERGE_TOKEN_NIL:
+                AkinatorMergeWriteToken(merged_file, token, depth + level);
+                break;
+            case AKINATOR_MERGE_TOKEN_CLOSE:
+                if (level == 0) {
+                    return AKINATOR_DATABASE_PARSE_ERROR;
+                }
+                level--;
+                AkinatorMergeWriteToken(merged_file, token, depth + level);
+                break;
+            case AKINATOR_MERGE_TOKEN_END:
+            case AKINATOR_MERGE_TOKEN_ERROR:
+            default:
+                return AKINATOR_DATABASE_PARSE_ERROR;
+        }
+
+        AkinatorMergeSkip(reader, 1);
+    } while (level > 0);
+
+    return AKINATOR_OK;
+}
+
+static void AkinatorMergeReport(AkinatorMerger* merger, size_t depth, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+static void AkinatorMergeReport(AkinatorMerger* merger, size_t depth, const char* format, ...) {
+    assert(merger != NULL);
+    assert(format != NULL);
+
+    if (merger->report == NULL) {
+        return;
+    }
+
+    fprintf(merger->report, "конфликт ");
+    if (depth == 0) {
+        fputc('.', merger->report);
+    }
+    else {
+        fwrite(merger->path, 1, depth, merger->report);
+    }
+    fprintf(merger->report, ": ");
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(merger->report, format, args);
+    va_end(args);
+
+    fputc('\n', merger->report);
+}
+
+static bool AkinatorMergePushFrame(AkinatorMerger* merger, AkinatorMergeFrame frame) {
+    assert(merger != NULL);
+
+    if (merger->frames_size == merger->frames_capacity) {
+        size_t new_capacity = (merger->frames_capacity == 0) ? AKINATOR_MERGE_START_STACK_CAPACITY : 2 * merger->frames_capacity;
+
+        AkinatorMergeFrame* new_frames = (AkinatorMergeFrame*)realloc(merger->frames, new_capacity * sizeof(AkinatorMergeFrame));
+        if (new_frames == NULL) {
+            return false;
+        }
+
+        merger->frames = new_frames;
+        merger->frames_capacity = new_capacity;
+    }
+
+    merger->frames[merger->frames_size++] = frame;
+
+    return true;
+}
+
+static bool AkinatorMergeSetPath(AkinatorMerger* merger, size_t depth, char answer) {
+    assert(merger != NULL);
+
+    if (depth == 0) {
+        return true;
+    }
+
+    if (depth > merger->path_capacity) {
+        size_t new_capacity = (merger->path_capacity == 0) ? AKINATOR_MERGE_START_STACK_CAPACITY : 2 * merger->path_capacity;
+
+        char* new_path = (char*)realloc(merger->path, new_capacity);
+        if (new_path == NULL) {
+            return false;
+        }
+
+        merger->path = new_path;
+        merger->path_capacity = new_capacity;
+    }
+
+    merger->path[depth - 1] = answer;
+
+    return true;
+}
+
+/// Все три базы стоят на месте, где в исходной базе пустой ребенок
+static AkinatorError AkinatorMergeNil(AkinatorMerger* merger, size_t depth) {
+    assert(merger != NULL);
+
+    bool is_first_nil = AkinatorMergePeek(&merger->first, 0)->type == AKINATOR_MERGE_TOKEN_NIL;
+    bool is_second_nil = AkinatorMergePeek(&merger->second, 0)->type == AKINATOR_MERGE_TOKEN_NIL;
+
+    AkinatorMergeSkip(&merger->base, 1);
+
+    if (is_first_nil && is_second_nil) {
+        AkinatorMergeWriteToken(merger->merged_file, AkinatorMergePeek(&merger->first, 0), depth);
+        AkinatorMergeSkip(&merger->first, 1);
+        AkinatorMergeSkip(&merger->second, 1);
+        return AKINATOR_OK;
+    }
+
+    if (is_first_nil) {
+        merger->stats->second_change_count++;
+        AkinatorMergeSkip(&merger->first, 1);
+        return AkinatorMergeCopy(&merger->second, merger->merged_file, depth, NULL, NULL, NULL);
+    }
+
+    merger->stats->first_change_count++;
+
+    if (!is_second_nil) {
+        bool is_same = false;
+
+        AkinatorError same_err = AkinatorMergeIsSameSubtree(&merger->first, &merger->second, &is_same);
+        if (same_err != AKINATOR_OK) {
+            return same_err;
+        }
+
+        merger->stats->second_change_count++;
+
+        if (!is_same) {
+            merger->stats->conflict_count++;
+            AkinatorMergeReport(merger, depth, "обе базы добавили поддерево на пустое место, взято из первой");
+        }
+    }
+
+    AkinatorError skip_err = is_second_nil ? (AkinatorMergeSkip(&merger->second, 1), AKINATOR_OK)
+                                           : AkinatorMergeCopy(&merger->second, NULL, depth, NULL, NULL, NULL);
+    if (skip_err != AKINATOR_OK) {
+        return skip_err;
+    }
+
+    return AkinatorMergeCopy(&merger->first, merger->merged_file, depth, NULL, NULL, NULL);
+}
+
+/// Все три базы стоят на листе исходной базы: его могли разделить одна, другая или обе базы
+static AkinatorError AkinatorMergeLeaf(AkinatorMerger* merger, size_t depth, const char* leaf_value) {
+    assert(merger != NULL);
+    assert(leaf_value != NULL);
+
+    const char* first_leaf = AkinatorMergePeekLeaf(&merger->first);
+    const char* second_leaf = AkinatorMergePeekLeaf(&merger->second);
+
+    bool is_first_same = first_leaf != NULL && strcmp(first_leaf, leaf_value) == 0;
+    bool is_second_same = second_leaf != NULL && strcmp(second_leaf, leaf_value) == 0;
+
+    if (is_first_same) {
+        AkinatorMergeSkip(&merger->first, AKINATOR_MERGE_LOOKAHEAD);
+
+        if (!is_second_same) {
+            merger->stats->second_change_count++;
+        }
+
+        return AkinatorMergeCopy(&merger->second, merger->merged_file, depth, NULL, NULL, NULL);
+    }
+
+    merger->stats->first_change_count++;
+
+    if (is_second_same) {
+        AkinatorMergeSkip(&merger->second, AKINATOR_MERGE_LOOKAHEAD);
+        return AkinatorMergeCopy(&merger->first, merger->merged_file, depth, NULL, NULL, NULL);
+    }
+
+    merger->stats->second_change_count++;
+
+    bool is_same = false;
+
+    AkinatorError same_err = AkinatorMergeIsSameSubtree(&merger->first, &merger->second, &is_same);
+    if (same_err != AKINATOR_OK) {
+        return same_err;
+    }
+
+    if (is_same) {
+        AkinatorError skip_err = AkinatorMergeCopy(&merger->second, NULL, depth, NULL, NULL, NULL);
+        if (skip_err != AKINATOR_OK) {
+            return skip_err;
+        }
+
+        return AkinatorMergeCopy(&merger->first, merger->merged_file, depth, NULL, NULL, NULL);
+    }
+
+    merger->stats->conflict_count++;
+
+    if (first_leaf != NULL || second_leaf != NULL) {
+        AkinatorMergeReport(merger, depth, "\"%s\" изменен в обеих базах не обучением, взят вариант первой", leaf_value);
+
+        AkinatorError skip_err = AkinatorMergeCopy(&merger->second, NULL, depth, NULL, NULL, NULL);
+        if (skip_err != AKINATOR_OK) {
+            return skip_err;
+        }
+
+        return AkinatorMergeCopy(&merger->first, merger->merged_file, depth, NULL, NULL, NULL);
+    }
+
+    AkinatorMergeReport(merger, depth, "\"%s\" разделен в обеих базах: \"%s\" и \"%s\", поддерево второй встало на место листа в первой",
+                        leaf_value, AkinatorMergePeek(&merger->first, 0)->value, AkinatorMergePeek(&merger->second, 0)->value);
+
+    bool is_replaced = false;
+
+    AkinatorError copy_err = AkinatorMergeCopy(&merger->first, merger->merged_file, depth, leaf_value, &merger->second, &is_replaced);
+    if (copy_err != AKINATOR_OK) {
+        return copy_err;
+    }
+
+    if (!is_replaced) {
+        AkinatorMergeReport(merger, depth, "в первой базе не осталось листа \"%s\", поддерево второй пропущено", leaf_value);
+        return AkinatorMergeCopy(&merger->second, NULL, depth, NULL, NULL, NULL);
+    }
+
+    return AKINATOR_OK;
+}
+
+/// Все три базы стоят на вопросе исходной базы: обучение не меняет вопросы, поэтому спускаемся в детей
+static AkinatorError AkinatorMergeQuestion(AkinatorMerger* merger, size_t depth, const char* base_value) {
+    assert(merger != NULL);
+    assert(base_value != NULL);
+
+    const AkinatorMergeToken* first = AkinatorMergePeek(&merger->first, 0);
+    const AkinatorMergeToken* second = AkinatorMergePeek(&merger->second, 0);
+
+    if (first->type != AKINATOR_MERGE_TOKEN_NODE || second->type != AKINATOR_MERGE_TOKEN_NODE) {
+        AkinatorMergeReport(merger, depth, "вопрос \"%s\" удален, базы не происходят от общей", base_value);
+        return AKINATOR_MERGE_ERROR;
+    }
+
+    bool is_first_changed = strcmp(first->value, base_value) != 0;
+    bool is_second_changed = strcmp(second->value, base_value) != 0;
+
+    const AkinatorMergeToken* merged = first;
+
+    if (is_first_changed) {
+        merger->stats->first_change_count++;
+    }
+
+    if (is_second_changed) {
+        merger->stats->second_change_count++;
+
+        if (!is_first_changed) {
+            merged = second;
+        }
+        else if (strcmp(first->value, second->value) != 0) {
+            merger->stats->conflict_count++;
+            AkinatorMergeReport(merger, depth, "вопрос \"%s\" изменен в обеих базах: \"%s\" и \"%s\", взят вариант первой",
+                                base_value, first->value, second->value);
+        }
+    }
+
+    AkinatorMergeWriteToken(merger->merged_file, merged, depth);
+
+    AkinatorMergeSkip(&merger->first, 1);
+    AkinatorMergeSkip(&merger->second, 1);
+
+    bool is_pushed = AkinatorMergePushFrame(merger, {AKINATOR_MERGE_FRAME_CLOSE, depth, '\0'})
+                     && AkinatorMergePushFrame(merger, {AKINATOR_MERGE_FRAME_SUBTREE, depth + 1, 'y'})
+                     && AkinatorMergePushFrame(merger, {AKINATOR_MERGE_FRAME_SUBTREE, depth + 1, 'n'});
+
+    return is_pushed ? AKINATOR_OK : AKINATOR_NODE_ALLOC_ERROR;
+}
+
+static AkinatorError AkinatorMergeSubtree(AkinatorMerger* merger, size_t depth) {
+    assert(merger != NULL);
+
+    const AkinatorMergeToken* base = AkinatorMergePeek(&merger->base, 0);
+
+    for (AkinatorMergeReader* reader : {&merger->base, &merger->first, &merger->second}) {
+        AkinatorMergeTokenType type = AkinatorMergePeek(reader, 0)->type;
+
+        if (type != AKINATOR_MERGE_TOKEN_NODE && type != AKINATOR_MERGE_TOKEN_NIL) {
+            return AKINATOR_DATABASE_PARSE_ERROR;
+        }
+    }
+
+    if (base->type == AKINATOR_MERGE_TOKEN_NIL) {
+        return AkinatorMergeNil(merger, depth);
+    }
+
+    char base_value[1 + MAX_TREE_CHAR_SIZE] = {};
+    strncpy(base_value, base->value, MAX_TREE_CHAR_SIZE);
+
+    if (AkinatorMergePeekLeaf(&merger->base) != NULL) {
+        AkinatorMergeSkip(&merger->base, AKINATOR_MERGE_LOOKAHEAD);
+        return AkinatorMergeLeaf(merger, depth, base_value);
+    }
+
+    AkinatorMergeSkip(&merger->base, 1);
+    return AkinatorMergeQuestion(merger, depth, base_value);
+}
+
+static AkinatorError AkinatorMergeClose(AkinatorMerger* merger, size_t depth) {
+    assert(merger != NULL);
+
+    for (AkinatorMergeReader* reader : {&merger->base, &merger->first, &merger->second}) {
+        if (AkinatorMergePeek(reader, 0)->type != AKINATOR_MERGE_TOKEN_CLOSE) {
+            return AKINATOR_DATABASE_PARSE_ERROR;
+        }
+    }
+
+    AkinatorMergeWriteToken(merger->merged_file, AkinatorMergePeek(&merger->base, 0), depth);
+
+    AkinatorMergeSkip(&merger->base, 1);
+    AkinatorMergeSkip(&merger->first, 1);
+    AkinatorMergeSkip(&merger->second, 1);
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorMergeRun(AkinatorMerger* merger) {
+    assert(merger != NULL);
+
+    if (!AkinatorMergePushFrame(merger, {AKINATOR_MERGE_FRAME_SUBTREE, 0, '\0'})) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    while (merger->frames_size > 0) {
+        AkinatorMergeFrame frame = merger->frames[--merger->frames_size];
+
+        AkinatorError frame_err = AKINATOR_OK;
+
+        if (frame.type == AKINATOR_MERGE_FRAME_CLOSE) {
+            frame_err = AkinatorMergeClose(merger, frame.depth);
+        }
+        else if (!AkinatorMergeSetPath(merger, frame.depth, frame.answer)) {
+            frame_err = AKINATOR_NODE_ALLOC_ERROR;
+        }
+        else {
+            frame_err = AkinatorMergeSubtree(merger, frame.depth);
+        }
+
+        if (frame_err != AKINATOR_OK) {
+            return frame_err;
+        }
+    }
+
+    for (AkinatorMergeReader* reader : {&merger->base, &merger->first, &merger->second}) {
+        if (AkinatorMergePeek(reader, 0)->type != AKINATOR_MERGE_TOKEN_END) {
+            return AKINATOR_DATABASE_PARSE_ERROR;
+        }
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorMerge(const char* base_file_name, const char* first_file_name, const char* second_file_name,
+                            const char* merged_file_name, FILE* report, AkinatorMergeStats* stats) {
+    assert(base_file_name != NULL);
+    assert(first_file_name != NULL);
+    assert(second_file_name != NULL);
+    assert(merged_file_name != NULL);
+    assert(stats != NULL);
+
+    *stats = {};
+
+    AkinatorMerger* merger = (AkinatorMerger*)calloc(1, sizeof(AkinatorMerger));
+    if (merger == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    merger->report = report;
+    merger->stats = stats;
+
+    merger->base.file = fopen(base_file_name, "r");
+    merger->first.file = fopen(first_file_name, "r");
+    merger->second.file = fopen(second_file_name, "r");
+    merger->merged_file = fopen(merged_file_name, "w");
+
+    AkinatorError merge_err = AKINATOR_OK;
+
+    if (merger->base.file == NULL || merger->first.file == NULL || merger->second.file == NULL) {
+        merge_err = AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    }
+    else if (merger->merged_file == NULL) {
+        merge_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+    else {
+        for (FILE* file : {merger->base.file, merger->first.file, merger->second.file, merger->merged_file}) {
+            setvbuf(file, NULL, _IOFBF, AKINATOR_MERGE_BUFFER_SIZE);
+        }
+
+        merge_err = AkinatorMergeRun(merger);
+    }
+
+    for (FILE* file : {merger->base.file, merger->first.file, merger->second.file, merger->merged_file}) {
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+
+    PROTECTED_FREE(merger->frames);
+    PROTECTED_FREE(merger->path);
+    PROTECTED_FREE(merger);
+
+    return merge_err;
+}
@@ -0,0 +1,297 @@
+#include "akinator_reload.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <libgen.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <system_error>
+
+static const size_t AKINATOR_WATCH_EVENT_BUFFER_SIZE = 4096;
+
+static void AkinatorReloaderLoaderRun(AkinatorReloader* reloader) {
+    assert(reloader != NULL);
+
+    while (true) {
+        char database_file_name[MAX_FILE_NAME_LEN + 1] = {};
+        bool is_user_requested = false;
+        {
+            std::lock_guard<std::mutex> lock(reloader->mutex);
+            strncpy(database_file_name, reloader->database_file_name, MAX_FILE_NAME_LEN);
+            is_user_requested = reloader->is_user_requested;
+            reloader->is_user_requested = false;
+        }
+
+        Akinator* new_akinator = (Akinator*)calloc(1, sizeof(Akinator));
+        AkinatorError load_err = (new_akinator == NULL) ? AKINATOR_NODE_ALLOC_ERROR : AkinatorTreeInit(new_akinator);
+
+        if (load_err == AKINATOR_OK) {
+            load_err = AkinatorTreeLoadFile(new_akinator, database_file_name);
+        }
+
+        if (load_err != AKINATOR_OK) {
+            if (new_akinator != NULL) {
+                AkinatorTreeDestroy(new_akinator);
+                free(new_akinator);
+            }
+        }
+        else {
+            Akinator* stale = NULL;
+            {
+                std::lock_guard<std::mutex> lock(reloader->mutex);
+                stale = reloader->ready.exchange(new_akinator);
+                reloader->is_ready_user_requested = is_user_requested || (stale != NULL && reloader->is_ready_user_requested);
+            }
+
+            if (stale != NULL) {
+                AkinatorTreeDestroy(stale);
+                free(stale);
+            }
+        }
+
+        reloader->last_error = load_err;
+
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        if (!reloader->is_reload_requested) {
+            reloader->is_loading = false;
+            return;
+        }
+        reloader->is_reload_requested = false;
+    }
+}
+
+static void AkinatorReloaderWatcherRun(AkinatorReloader* reloader, int inotify_fd, char* watched_name) {
+    assert(reloader != NULL);
+    assert(watched_name != NULL);
+
+    alignas(struct inotify_event) char events[AKINATOR_WATCH_EVENT_BUFFER_SIZE];
+
+    while (reloader->is_watching) {
+        struct pollfd poll_fd = {inotify_fd, POLLIN, 0};
+        if (poll(&poll_fd, 1, AKINATOR_WATCH_POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        ssize_t events_size = read(inotify_fd, events, sizeof(events));
+        bool is_changed = false;
+
+        for (ssize_t offset = 0; offset < events_size; ) {
+            const struct inotify_event* event = (const struct inotify_event*)(events + offset);
+
+            if (event->len > 0 && strcmp(event->name, watched_name) == 0) {
+                is_changed = true;
+            }
+
+            offset += (ssize_t)(sizeof(struct inotify_event) + event->len);
+        }
+
+        if (is_changed) {
+            AkinatorReloaderRequest(reloader, NULL, false);
+        }
+    }
+
+    close(inotify_fd);
+    free(watched_name);
+}
+
+static void AkinatorReloaderUnwatch(AkinatorReloader* reloader) {
+    assert(reloader != NULL);
+
+    reloader->is_watching = false;
+
+    if (reloader->watcher.joinable()) {
+        reloader->watcher.join();
+    }
+}
+
+AkinatorError AkinatorReloaderInit(AkinatorReloader* reloader, const char* database_file_name) {
+    assert(reloader != NULL);
+    assert(database_file_name != NULL);
+
+    strncpy(reloader->database_file_name, database_file_name, MAX_FILE_NAME_LEN);
+
+    reloader->is_loading = false;
+    reloader->is_reload_requested = false;
+    reloader->is_user_requested = false;
+    reloader->is_ready_user_requested = false;
+    reloader->ready = NULL;
+    reloader->last_error = AKINATOR_OK;
+    reloader->is_watching = false;
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorReloaderDestroy(AkinatorReloader* reloader) {
+    assert(reloader != NULL);
+
+    AkinatorReloaderUnwatch(reloader);
+
+    AkinatorReloaderWait(reloader);
+
+    Akinator* stale = reloader->ready.exchange(NULL);
+    if (stale != NULL) {
+        AkinatorTreeDestroy(stale);
+        free(stale);
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorReloaderRequest(AkinatorReloader* reloader, const char* database_file_name, bool is_user_requested) {
+    assert(reloader != NULL);
+
+    std::thread finished_loader;
+
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+
+        if (database_file_name != NULL) {
+            strncpy(reloader->database_file_name, database_file_name, MAX_FILE_NAME_LEN);
+        }
+
+        if (is_user_requested) {
+            reloader->is_user_requested = true;
+        }
+
+        if (reloader->is_loading) {
+            reloader->is_reload_requested = true;
+            return AKINATOR_OK;
+        }
+
+        finished_loader = std::move(reloader->loader);
+
+        try {
+            reloader->loader = std::thread(AkinatorReloaderLoaderRun, reloader);
+        }
+        catch (const std::system_error&) {
+            return AKINATOR_RELOAD_ERROR;
+        }
+
+        reloader->is_loading = true;
+    }
+
+    if (finished_loader.joinable()) {
+        finished_loader.join();
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorReloaderWait(AkinatorReloader* reloader) {
+    assert(reloader != NULL);
+
+    std::thread loader;
+
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        loader = std::move(reloader->loader);
+    }
+
+    if (loader.joinable()) {
+        loader.join();
+    }
+
+    return reloader->last_error;
+}
+
+/// Прочитанный файл - тот же, с которым akinator совпадал при последней загрузке или сохранении: время изменения
+/// не сдвинулось (событие от собственного сохранения) или совпал хеш корня (файл переписан тем же содержимым)
+static bool AkinatorReloaderIsSynced(Akinator* akinator, const Akinator* new_akinator) {
+    assert(akinator != NULL);
+    assert(new_akinator != NULL);
+
+    if (strlen(akinator->synced_file_name) == 0
+        || strcmp(akinator->synced_file_name, new_akinator->synced_file_name) != 0) {
+        return false;
+    }
+
+    if (akinator->synced_mtime.tv_sec == new_akinator->synced_mtime.tv_sec
+        && akinator->synced_mtime.tv_nsec == new_akinator->synced_mtime.tv_nsec) {
+        return true;
+    }
+
+    if (akinator->lazy != NULL || akinator->synced_hash != new_akinator->synced_hash) {
+        return false;
+    }
+
+    akinator->synced_mtime = new_akinator->synced_mtime;
+
+    return true;
+}
+
+bool AkinatorReloaderPoll(AkinatorReloader* reloader, Akinator* akinator) {
+    assert(reloader != NULL);
+    assert(akinator != NULL);
+
+    Akinator* new_akinator = NULL;
+    bool is_user_requested = false;
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        new_akinator = reloader->ready.exchange(NULL);
+        is_user_requested = reloader->is_ready_user_requested;
+        reloader->is_ready_user_requested = false;
+    }
+
+    if (new_akinator == NULL) {
+        return false;
+    }
+
+    if (!is_user_requested && AkinatorReloaderIsSynced(akinator, new_akinator)) {
+        AkinatorTreeDestroy(new_akinator);
+        free(new_akinator);
+        return false;
+    }
+
+    AkinatorTreeDestroy(akinator);
+    *akinator = *new_akinator;
+    free(new_akinator);
+
+    return true;
+}
+
+AkinatorError AkinatorReloaderWatch(AkinatorReloader* reloader) {
+    assert(reloader != NULL);
+
+    AkinatorReloaderUnwatch(reloader);
+
+    char dir_buffer[MAX_FILE_NAME_LEN + 1] = {};
+    char base_buffer[MAX_FILE_NAME_LEN + 1] = {};
+    {
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        strncpy(dir_buffer, reloader->database_file_name, MAX_FILE_NAME_LEN);
+        strncpy(base_buffer, reloader->database_file_name, MAX_FILE_NAME_LEN);
+    }
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        return AKINATOR_RELOAD_ERROR;
+    }
+
+    if (inotify_add_watch(inotify_fd, dirname(dir_buffer), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(inotify_fd);
+        return AKINATOR_RELOAD_ERROR;
+    }
+
+    char* watched_name = strdup(basename(base_buffer));
+    if (watched_name == NULL) {
+        close(inotify_fd);
+        return AKINATOR_RELOAD_ERROR;
+    }
+
+    reloader->is_watching = true;
+
+    try {
+        reloader->watcher = std::thread(AkinatorReloaderWatcherRun, reloader, inotify_fd, watched_name);
+    }
+    catch (const std::system_error&) {
+        reloader->is_watching = false;
+        close(inotify_fd);
+        free(watched_name);
+        return AKINATOR_RELOAD_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
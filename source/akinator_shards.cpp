@@ -0,0 +1,605 @@
+#include "akinator_shards.hpp"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#include "tree_parallel.hpp"
+#include "utils.hpp"
+
+static const uint64_t AKINATOR_SHARD_HASH_SEED = 0xCBF29CE484222325ull;
+static const uint64_t AKINATOR_SHARD_HASH_PRIME = 0x100000001B3ull;
+static const uint64_t AKINATOR_SHARD_NIL_MARK = 0x9E3779B97F4A7C15ull;
+static const uint64_t AKINATOR_SHARD_MOUNT_MARK = 0xBF58476D1CE4E5B9ull;
+
+/// Вершина в стеке обхода шарда; node == NULL - отсутствующий ребенок
+struct AkinatorShardFrame {
+    TreeNode* node;
+    size_t depth;
+
+    bool is_leave;
+};
+
+struct AkinatorShardStack {
+    AkinatorShardFrame* frames;
+    size_t size;
+    size_t capacity;
+};
+
+typedef void (*AkinatorShardJob)(AkinatorShards* shards, AkinatorShard* shard);
+
+static int AkinatorShardCompare(const void* first, const void* second) {
+    assert(first != NULL);
+    assert(second != NULL);
+
+    const AkinatorShard* first_shard = (const AkinatorShard*)first;
+    const AkinatorShard* second_shard = (const AkinatorShard*)second;
+
+    size_t first_len = strlen(first_shard->path);
+    size_t second_len = strlen(second_shard->path);
+
+    if (first_len != second_len) {
+        return (first_len < second_len) ? -1 : 1;
+    }
+
+    return strcmp(first_shard->path, second_shard->path);
+}
+
+static int AkinatorShardNodeCompare(const void* first, const void* second) {
+    assert(first != NULL);
+    assert(second != NULL);
+
+    uintptr_t first_node = (uintptr_t)*(TreeNode* const*)first;
+    uintptr_t second_node = (uintptr_t)*(TreeNode* const*)second;
+
+    return (first_node < second_node) ? -1 : (first_node > second_node);
+}
+
+static bool AkinatorShardIsNested(AkinatorShards* shards, AkinatorShard* shard, TreeNode* node) {
+    assert(shards != NULL);
+    assert(shard != NULL);
+    assert(node != NULL);
+
+    if (node == shard->mount_node) {
+        return false;
+    }
+
+    return bsearch(&node, shards->mount_nodes, shards->count, sizeof(TreeNode*), AkinatorShardNodeCompare) != NULL;
+}
+
+static bool AkinatorShardStackPush(AkinatorShardStack* stack, TreeNode* node, size_t depth, bool is_leave) {
+    assert(stack != NULL);
+
+    if (stack->size == stack->capacity) {
+        size_t new_capacity = (stack->capacity == 0) ? AKINATOR_SHARD_START_CAPACITY : stack->capacity * 2;
+
+        AkinatorShardFrame* new_frames = (AkinatorShardFrame*)realloc(stack->frames, new_capacity * sizeof(AkinatorShardFrame));
+        if (new_frames == NULL) {
+            return false;
+        }
+
+        stack->frames = new_frames;
+        stack->capacity = new_capacity;
+    }
+
+    stack->frames[stack->size++] = {node, depth, is_leave};
+
+    return true;
+}
+
+static uint64_t AkinatorShardHashMix(uint64_t hash, uint64_t value) {
+    hash ^= value;
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+
+    return hash;
+}
+
+static uint64_t AkinatorShardHashText(const char* text) {
+    assert(text != NULL);
+
+    uint64_t hash = AKINATOR_SHARD_HASH_SEED;
+
+    for (const unsigned char* symbol = (const unsigned char*)text; *symbol != '\0'; symbol++) {
+        hash ^= *symbol;
+        hash *= AKINATOR_SHARD_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+static void AkinatorShardHashJob(AkinatorShards* shards, AkinatorShard* shard) {
+    assert(shards != NULL);
+    assert(shard != NULL);
+
+    AkinatorShardStack stack = {};
+    uint64_t hash = AKINATOR_SHARD_HASH_SEED;
+
+    if (!AkinatorShardStackPush(&stack, shard->mount_node, 0, false)) {
+        shard->error = AKINATOR_NODE_ALLOC_ERROR;
+        return;
+    }
+
+    while (stack.size > 0) {
+        TreeNode* node = stack.frames[--stack.size].node;
+
+        if (node == NULL) {
+            hash = AkinatorShardHashMix(hash, AKINATOR_SHARD_NIL_MARK);
+            continue;
+        }
+
+        if (AkinatorShardIsNested(shards, shard, node)) {
+            hash = AkinatorShardHashMix(hash, AKINATOR_SHARD_MOUNT_MARK);
+            continue;
+        }
+
+        hash = AkinatorShardHashMix(hash, AkinatorShardHashText(TreeNodeGetValue(node)));
+
+        if (!AkinatorShardStackPush(&stack, TreeNodeGetRight(node), 0, false)
+            || !AkinatorShardStackPush(&stack, TreeNodeGetLeft(node), 0, false)) {
+            shard->error = AKINATOR_NODE_ALLOC_ERROR;
+            break;
+        }
+    }
+
+    PROTECTED_FREE(stack.frames);
+
+    shard->hash = hash;
+}
+
+static void AkinatorShardPrintTabs(FILE* shard_file, size_t tab_count) {
+    assert(shard_file != NULL);
+
+    if (tab_count > MAX_INDENT_DEPTH) {
+        tab_count = MAX_INDENT_DEPTH;
+    }
+
+    for (size_t tab_i = 0; tab_i < tab_count; tab_i++) {
+        fputc('\t', shard_file);
+    }
+}
+
+static void AkinatorShardWriteJob(AkinatorShards* shards, AkinatorShard* shard) {
+    assert(shards != NULL);
+    assert(shard != NULL);
+
+    if (shard->error != AKINATOR_OK || shard->hash == shard->saved_hash) {
+        return;
+    }
+
+    FILE* shard_file = fopen(shard->file_name, "w");
+    if (shard_file == NULL) {
+        shard->error = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+        return;
+    }
+
+    setvbuf(shard_file, NULL, _IOFBF, AKINATOR_SHARD_BUFFER_SIZE);
+
+    AkinatorShardStack stack = {};
+
+    if (!AkinatorShardStackPush(&stack, shard->mount_node, 0, false)) {
+        shard->error = AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    while (stack.size > 0 && shard->error == AKINATOR_OK) {
+        AkinatorShardFrame frame = stack.frames[--stack.size];
+
+        if (frame.node == NULL) {
+            AkinatorShardPrintTabs(shard_file, frame.depth);
+            fputs("{nil}\n", shard_file);
+            continue;
+        }
+
+        if (frame.is_leave) {
+            AkinatorShardPrintTabs(shard_file, frame.depth);
+            fputs("}\n", shard_file);
+            continue;
+        }
+
+        AkinatorShardPrintTabs(shard_file, frame.depth);
+        fputs("{\n", shard_file);
+        AkinatorShardPrintTabs(shard_file, frame.depth);
+        fprintf(shard_file, "%s\n", TreeNodeGetValue(frame.node));
+
+        bool is_nested = AkinatorShardIsNested(shards, shard, frame.node);
+
+        if (!AkinatorShardStackPush(&stack, frame.node, frame.depth, true)
+            || !AkinatorShardStackPush(&stack, is_nested ? NULL : TreeNodeGetRight(frame.node), frame.depth + 1, false)
+            || !AkinatorShardStackPush(&stack, is_nested ? NULL : TreeNodeGetLeft(frame.node), frame.depth + 1, false)) {
+            shard->error = AKINATOR_NODE_ALLOC_ERROR;
+        }
+    }
+
+    PROTECTED_FREE(stack.frames);
+
+    if (fclose(shard_file) != 0 && shard->error == AKINATOR_OK) {
+        shard->error = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    if (shard->error == AKINATOR_OK) {
+        shard->saved_hash = shard->hash;
+    }
+}
+
+static void AkinatorShardReadJob(AkinatorShards*, AkinatorShard* shard) {
+    assert(shard != NULL);
+
+    shard->error = AkinatorTreeReadFile(&shard->tree, shard->file_name);
+}
+
+static void AkinatorShardsRun(AkinatorShards* shards, AkinatorShardJob job) {
+    assert(shards != NULL);
+    assert(job != NULL);
+
+    std::atomic<size_t> next_shard(0);
+
+    auto worker = [shards, job, &next_shard]() {
+        for (size_t shard_i = next_shard++; shard_i < shards->count; shard_i = next_shard++) {
+            job(shards, &shards->shards[shard_i]);
+        }
+    };
+
+    size_t thread_count = TreeParallelThreadCount();
+    if (thread_count > shards->count) {
+        thread_count = shards->count;
+    }
+
+    std::thread threads[TREE_PARALLEL_MAX_THREADS];
+    size_t started_count = 0;
+
+    for (; started_count + 1 < thread_count; started_count++) {
+        try {
+            threads[started_count] = std::thread(worker);
+        }
+        catch (const std::system_error&) {
+            break;
+        }
+    }
+
+    worker();
+
+    for (size_t thread_i = 0; thread_i < started_count; thread_i++) {
+        threads[thread_i].join();
+    }
+}
+
+static AkinatorError AkinatorShardsFirstError(AkinatorShards* shards) {
+    assert(shards != NULL);
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        if (shards->shards[shard_i].error != AKINATOR_OK) {
+            return shards->shards[shard_i].error;
+        }
+    }
+
+    return AKINATOR_OK;
+}
+
+static TreeNode* AkinatorShardsFindNode(Akinator* akinator, const char* path) {
+    assert(akinator != NULL);
+    assert(path != NULL);
+
+    TreeNode* node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    for (; node != NULL && *path != '\0'; path++) {
+        node = (*path == 'n') ? TreeNodeGetLeft(node) : TreeNodeGetRight(node);
+    }
+
+    return node;
+}
+
+static char* AkinatorShardsTrim(char* line) {
+    assert(line != NULL);
+
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+
+    size_t line_len = strlen(line);
+    while (line_len > 0 && isspace((unsigned char)line[line_len - 1])) {
+        line[--line_len] = '\0';
+    }
+
+    return line;
+}
+
+static AkinatorError AkinatorShardsAdd(AkinatorShards* shards, const char* manifest_file_name, char* line) {
+    assert(shards != NULL);
+    assert(manifest_file_name != NULL);
+    assert(line != NULL);
+
+    size_t path_len = strcspn(line, " \t");
+    if (line[path_len] == '\0') {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    line[path_len] = '\0';
+    const char* file_name = AkinatorShardsTrim(line + path_len + 1);
+
+    if (strcmp(line, ".") == 0) {
+        line[0] = '\0';
+        path_len = 0;
+    }
+    else if (path_len > AKINATOR_SHARD_MAX_PATH_LEN || strspn(line, "ny") != path_len) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    if (*file_name == '\0' || AkinatorGetDatabaseFormat(file_name) != AKINATOR_FORMAT_TEXT) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    size_t dir_len = 0;
+    const char* last_slash = strrchr(manifest_file_name, '/');
+    if (*file_name != '/' && last_slash != NULL) {
+        dir_len = (size_t)(last_slash - manifest_file_name) + 1;
+    }
+
+    if (dir_len + strlen(file_name) > MAX_FILE_NAME_LEN) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    AkinatorShard* shard = &shards->shards[shards->count++];
+
+    strcpy(shard->path, line);
+    memcpy(shard->file_name, manifest_file_name, dir_len);
+    strcpy(shard->file_name + dir_len, file_name);
+
+    return AKINATOR_OK;
+}
+
+/// Читает следующую непустую строку манифеста без комментария; *content == NULL в конце файла
+static AkinatorError AkinatorShardsNextLine(FILE* manifest_file, char* line, size_t line_size, char** content) {
+    assert(manifest_file != NULL);
+    assert(line != NULL);
+    assert(content != NULL);
+
+    *content = NULL;
+
+    while (fgets(line, (int)line_size, manifest_file) != NULL) {
+        if (strchr(line, '\n') == NULL && !feof(manifest_file)) {
+            return AKINATOR_SHARD_ERROR;
+        }
+
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        char* trimmed = AkinatorShardsTrim(line);
+        if (*trimmed != '\0') {
+            *content = trimmed;
+            return AKINATOR_OK;
+        }
+    }
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorShardsParseManifest(AkinatorShards* shards, const char* manifest_file_name) {
+    assert(shards != NULL);
+    assert(manifest_file_name != NULL);
+
+    FILE* manifest_file = fopen(manifest_file_name, "r");
+    if (manifest_file == NULL) {
+        return AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    }
+
+    char line[AKINATOR_SHARD_MAX_LINE_LEN + 2] = {};
+    char* content = NULL;
+    size_t line_count = 0;
+    AkinatorError parse_err = AKINATOR_OK;
+
+    while ((parse_err = AkinatorShardsNextLine(manifest_file, line, sizeof(line), &content)) == AKINATOR_OK && content != NULL) {
+        line_count++;
+    }
+
+    if (parse_err == AKINATOR_OK && line_count > 0) {
+        shards->shards = (AkinatorShard*)calloc(line_count, sizeof(AkinatorShard));
+        if (shards->shards == NULL) {
+            parse_err = AKINATOR_NODE_ALLOC_ERROR;
+        }
+    }
+
+    rewind(manifest_file);
+
+    while (parse_err == AKINATOR_OK && shards->count < line_count) {
+        parse_err = AkinatorShardsNextLine(manifest_file, line, sizeof(line), &content);
+
+        if (parse_err == AKINATOR_OK) {
+            parse_err = (content == NULL) ? AKINATOR_SHARD_ERROR : AkinatorShardsAdd(shards, manifest_file_name, content);
+        }
+    }
+
+    fclose(manifest_file);
+
+    if (parse_err != AKINATOR_OK) {
+        return parse_err;
+    }
+
+    if (shards->count == 0) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    qsort(shards->shards, shards->count, sizeof(AkinatorShard), AkinatorShardCompare);
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        bool is_root = (shards->shards[shard_i].path[0] == '\0');
+        bool is_duplicate = (shard_i > 0 && strcmp(shards->shards[shard_i - 1].path, shards->shards[shard_i].path) == 0);
+
+        if (is_root != (shard_i == 0) || is_duplicate) {
+            return AKINATOR_SHARD_ERROR;
+        }
+    }
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorShardsMount(Akinator* akinator, AkinatorShard* shard) {
+    assert(akinator != NULL);
+    assert(shard != NULL);
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&shard->tree));
+    if (first_node == NULL) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    TreeNode* mount_node = TreeGetRoot(&akinator->tree);
+    TreeNode* placeholder = NULL;
+
+    if (shard->path[0] != '\0') {
+        placeholder = AkinatorShardsFindNode(akinator, shard->path);
+        if (placeholder == NULL || TreeNodeGetLeft(placeholder) != NULL || TreeNodeGetRight(placeholder) != NULL) {
+            return AKINATOR_SHARD_ERROR;
+        }
+
+        mount_node = TreeNodeGetParent(placeholder);
+    }
+
+    TreeNodeLinkLeft(TreeGetRoot(&shard->tree), NULL);
+
+    if (placeholder == NULL || TreeNodeGetLeft(mount_node) == placeholder) {
+        TreeNodeLinkLeft(mount_node, first_node);
+    }
+    else {
+        TreeNodeLinkRight(mount_node, first_node);
+    }
+
+    akinator->tree.size += TreeGetSize(&shard->tree) - (size_t)(placeholder != NULL);
+
+    TreeNodeDestroy(&placeholder);
+    TreeDestroy(&shard->tree);
+
+    return AKINATOR_OK;
+}
+
+static AkinatorError AkinatorShardsRehash(Akinator* akinator) {
+    assert(akinator != NULL);
+    assert(akinator->shards != NULL);
+
+    AkinatorShards* shards = akinator->shards;
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        AkinatorShard* shard = &shards->shards[shard_i];
+
+        shard->mount_node = AkinatorShardsFindNode(akinator, shard->path);
+        if (shard->mount_node == NULL) {
+            return AKINATOR_SHARD_ERROR;
+        }
+
+        shard->error = AKINATOR_OK;
+        shards->mount_nodes[shard_i] = shard->mount_node;
+    }
+
+    qsort(shards->mount_nodes, shards->count, sizeof(TreeNode*), AkinatorShardNodeCompare);
+
+    AkinatorShardsRun(shards, AkinatorShardHashJob);
+
+    return AkinatorShardsFirstError(shards);
+}
+
+AkinatorError AkinatorShardsLoad(Akinator* akinator, const char* manifest_file_name) {
+    assert(akinator != NULL);
+    assert(manifest_file_name != NULL);
+
+    if (strlen(manifest_file_name) > MAX_FILE_NAME_LEN) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    AkinatorShardsDestroy(akinator);
+
+    akinator->shards = (AkinatorShards*)calloc(1, sizeof(AkinatorShards));
+    if (akinator->shards == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorShards* shards = akinator->shards;
+    strcpy(shards->manifest_file_name, manifest_file_name);
+
+    AkinatorError parse_err = AkinatorShardsParseManifest(shards, manifest_file_name);
+    if (parse_err != AKINATOR_OK) {
+        return parse_err;
+    }
+
+    shards->mount_nodes = (TreeNode**)calloc(shards->count, sizeof(TreeNode*));
+    if (shards->mount_nodes == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        if (TreeInit(&shards->shards[shard_i].tree) != TREE_OK) {
+            return AKINATOR_NODE_ALLOC_ERROR;
+        }
+    }
+
+    AkinatorShardsRun(shards, AkinatorShardReadJob);
+
+    AkinatorError read_err = AkinatorShardsFirstError(shards);
+    if (read_err != AKINATOR_OK) {
+        return read_err;
+    }
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        AkinatorError mount_err = AkinatorShardsMount(akinator, &shards->shards[shard_i]);
+        if (mount_err != AKINATOR_OK) {
+            return mount_err;
+        }
+    }
+
+    AkinatorError hash_err = AkinatorShardsRehash(akinator);
+    if (hash_err != AKINATOR_OK) {
+        return hash_err;
+    }
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        shards->shards[shard_i].saved_hash = shards->shards[shard_i].hash;
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorShardsSave(Akinator* akinator, const char* manifest_file_name) {
+    assert(akinator != NULL);
+    assert(manifest_file_name != NULL);
+
+    if (akinator->shards == NULL || strcmp(akinator->shards->manifest_file_name, manifest_file_name) != 0) {
+        return AKINATOR_SHARD_ERROR;
+    }
+
+    AkinatorError hash_err = AkinatorShardsRehash(akinator);
+    if (hash_err != AKINATOR_OK) {
+        return hash_err;
+    }
+
+    AkinatorShardsRun(akinator->shards, AkinatorShardWriteJob);
+
+    return AkinatorShardsFirstError(akinator->shards);
+}
+
+AkinatorError AkinatorShardsDestroy(Akinator* akinator) {
+    assert(akinator != NULL);
+
+    AkinatorShards* shards = akinator->shards;
+    if (shards == NULL) {
+        return AKINATOR_OK;
+    }
+
+    for (size_t shard_i = 0; shard_i < shards->count; shard_i++) {
+        if (TreeGetRoot(&shards->shards[shard_i].tree) != NULL) {
+            TreeDestroy(&shards->shards[shard_i].tree);
+        }
+    }
+
+    PROTECTED_FREE(shards->shards);
+    PROTECTED_FREE(shards->mount_nodes);
+    PROTECTED_FREE(akinator->shards);
+
+    return AKINATOR_OK;
+}
@@ -0,0 +1,565 @@
+#include "akinator_similarity.hpp"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#include "trace.hpp"
+#include "tree_parallel.hpp"
+#include "utils.hpp"
+
+enum AkinatorSimilarityStage {
+    AKINATOR_SIMILARITY_ENTER = 0,
+    AKINATOR_SIMILARITY_MID   = 1,
+    AKINATOR_SIMILARITY_EXIT  = 2
+};
+
+/// Вершина обхода; на MID левое поддерево уже пройдено, на EXIT - оба
+struct AkinatorSimilarityFrame {
+    TreeNode* node;
+    size_t depth;
+    size_t block_i;
+
+    AkinatorSimilarityStage stage;
+};
+
+struct AkinatorSimilarityStack {
+    AkinatorSimilarityFrame* frames;
+    size_t size;
+    size_t capacity;
+};
+
+/// Списки ближайших для полосы строк; строка row полосы занимает top_count ячеек с row * top_count
+struct AkinatorSimilarityTile {
+    size_t row_begin;
+    size_t row_end;
+
+    size_t* top_leaves;
+    size_t* top_similarities;
+    size_t* top_counts;
+};
+
+static bool AkinatorSimilarityPushFrame(AkinatorSimilarityStack* stack, TreeNode* node, size_t depth, size_t block_i, AkinatorSimilarityStage stage) {
+    assert(stack != NULL);
+    assert(node != NULL);
+
+    if (stack->size == stack->capacity) {
+        size_t new_capacity = (stack->capacity == 0) ? AKINATOR_SIMILARITY_START_CAPACITY : stack->capacity * 2;
+
+        AkinatorSimilarityFrame* new_frames = (AkinatorSimilarityFrame*)realloc(stack->frames, new_capacity * sizeof(AkinatorSimilarityFrame));
+        if (new_frames == NULL) {
+            return false;
+        }
+
+        stack->frames = new_frames;
+        stack->capacity = new_capacity;
+    }
+
+    stack->frames[stack->size++] = {node, depth, block_i, stage};
+
+    return true;
+}
+
+/// neighbour_similarity - сходство с предыдущим листом, у первого листа не используется
+static bool AkinatorSimilarityPushLeaf(AkinatorSimilarity* similarity, TreeNode* leaf, size_t depth, size_t neighbour_similarity) {
+    assert(similarity != NULL);
+    assert(leaf != NULL);
+
+    if (similarity->leaf_count == similarity->leaf_capacity) {
+        size_t new_capacity = (similarity->leaf_capacity == 0) ? AKINATOR_SIMILARITY_START_CAPACITY : similarity->leaf_capacity * 2;
+
+        TreeNode** new_leaves = (TreeNode**)realloc(similarity->leaves, new_capacity * sizeof(TreeNode*));
+        if (new_leaves == NULL) {
+            return false;
+        }
+
+        similarity->leaves = new_leaves;
+
+        size_t* new_depths = (size_t*)realloc(similarity->leaf_depths, new_capacity * sizeof(size_t));
+        if (new_depths == NULL) {
+            return false;
+        }
+
+        similarity->leaf_depths = new_depths;
+
+        size_t* new_neighbour_similarities = (size_t*)realloc(similarity->neighbour_similarities, new_capacity * sizeof(size_t));
+        if (new_neighbour_similarities == NULL) {
+            return false;
+        }
+
+        similarity->neighbour_similarities = new_neighbour_similarities;
+        similarity->leaf_capacity = new_capacity;
+    }
+
+    if (similarity->leaf_count > 0) {
+        similarity->neighbour_similarities[similarity->leaf_count - 1] = neighbour_similarity;
+    }
+
+    similarity->leaves[similarity->leaf_count] = leaf;
+    similarity->leaf_depths[similarity->leaf_count] = depth;
+    similarity->leaf_count++;
+
+    return true;
+}
+
+static bool AkinatorSimilarityPushBlock(AkinatorSimilarity* similarity, size_t depth, size_t* block_i) {
+    assert(similarity != NULL);
+    assert(block_i != NULL);
+
+    if (similarity->block_count == similarity->block_capacity) {
+        size_t new_capacity = (similarity->block_capacity == 0) ? AKINATOR_SIMILARITY_START_CAPACITY : similarity->block_capacity * 2;
+
+        AkinatorSimilarityBlock* new_blocks = (AkinatorSimilarityBlock*)realloc(similarity->blocks, new_capacity * sizeof(AkinatorSimilarityBlock));
+        if (new_blocks == NULL) {
+            return false;
+        }
+
+        similarity->blocks = new_blocks;
+        similarity->block_capacity = new_capacity;
+    }
+
+    *block_i = similarity->block_count++;
+    similarity->blocks[*block_i] = {depth, similarity->leaf_count, similarity->leaf_count, similarity->leaf_count};
+
+    return true;
+}
+
+/// Пустые блоки (вопрос с одним ребенком) выбрасываются, по остальным считается число пар на каждом уровне сходства
+static bool AkinatorSimilarityCountPairs(AkinatorSimilarity* similarity) {
+    assert(similarity != NULL);
+
+    size_t block_count = 0;
+    for (size_t block_i = 0; block_i < similarity->block_count; block_i++) {
+        AkinatorSimilarityBlock* block = &similarity->blocks[block_i];
+
+        if (block->row_begin == block->col_begin || block->col_begin == block->col_end) {
+            continue;
+        }
+
+        if (block->similarity + 1 > similarity->level_count) {
+            similarity->level_count = block->similarity + 1;
+        }
+
+        similarity->blocks[block_count++] = *block;
+    }
+
+    similarity->block_count = block_count;
+
+    similarity->pair_counts = (size_t*)calloc(similarity->level_count + 1, sizeof(size_t));
+    if (similarity->pair_counts == NULL) {
+        return false;
+    }
+
+    for (size_t block_i = 0; block_i < similarity->block_count; block_i++) {
+        AkinatorSimilarityBlock* block = &similarity->blocks[block_i];
+
+        similarity->pair_counts[block->similarity] += (block->col_begin - block->row_begin) * (block->col_end - block->col_begin);
+    }
+
+    return true;
+}
+
+AkinatorError AkinatorSimilarityBuild(Akinator* akinator, AkinatorSimilarity* similarity) {
+    assert(akinator != NULL);
+    assert(similarity != NULL);
+
+    TRACE_SCOPE("AkinatorSimilarityBuild", TRACE_WORK);
+
+    *similarity = {};
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+    if (first_node == NULL) {
+        return AKINATOR_TREE_ERROR;
+    }
+
+    AkinatorSimilarityStack stack = {};
+    bool is_ok = AkinatorSimilarityPushFrame(&stack, first_node, 0, 0, AKINATOR_SIMILARITY_ENTER);
+
+    size_t neighbour_similarity = 0;
+
+    while (is_ok && stack.size > 0) {
+        AkinatorSimilarityFrame frame = stack.frames[--stack.size];
+        TreeNode* left = TreeNodeGetLeft(frame.node);
+        TreeNode* right = TreeNodeGetRight(frame.node);
+
+        switch (frame.stage) {
+            case AKINATOR_SIMILARITY_ENTER: {
+                if (left == NULL && right == NULL) {
+                    is_ok = AkinatorSimilarityPushLeaf(similarity, frame.node, frame.depth, neighbour_similarity);
+                    break;
+                }
+
+                size_t block_i = 0;
+                is_ok = AkinatorSimilarityPushBlock(similarity, frame.depth, &block_i)
+                        && AkinatorSimilarityPushFrame(&stack, frame.node, frame.depth, block_i, AKINATOR_SIMILARITY_MID)
+                        && (left == NULL || AkinatorSimilarityPushFrame(&stack, left, frame.depth + 1, 0, AKINATOR_SIMILARITY_ENTER));
+                break;
+            }
+            case AKINATOR_SIMILARITY_MID:
+                similarity->blocks[frame.block_i].col_begin = similarity->leaf_count;
+
+                if (left != NULL && right != NULL) {
+                    neighbour_similarity = frame.depth;
+                }
+
+                is_ok = AkinatorSimilarityPushFrame(&stack, frame.node, frame.depth, frame.block_i, AKINATOR_SIMILARITY_EXIT)
+                        && (right == NULL || AkinatorSimilarityPushFrame(&stack, right, frame.depth + 1, 0, AKINATOR_SIMILARITY_ENTER));
+                break;
+            case AKINATOR_SIMILARITY_EXIT:
+                similarity->blocks[frame.block_i].col_end = similarity->leaf_count;
+                break;
+            default:
+                assert(0 && "Unknown similarity stage");
+                break;
+        }
+    }
+
+    PROTECTED_FREE(stack.frames);
+
+    if (!is_ok || !AkinatorSimilarityCountPairs(similarity)) {
+        AkinatorSimilarityDestroy(similarity);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorSimilarityDestroy(AkinatorSimilarity* similarity) {
+    assert(similarity != NULL);
+
+    PROTECTED_FREE(similarity->leaves);
+    PROTECTED_FREE(similarity->leaf_depths);
+    PROTECTED_FREE(similarity->neighbour_similarities);
+    PROTECTED_FREE(similarity->blocks);
+    PROTECTED_FREE(similarity->pair_counts);
+
+    *similarity = {};
+
+    return AKINATOR_OK;
+}
+
+size_t AkinatorSimilarityTop(const AkinatorSimilarity* similarity, size_t leaf_i, size_t top_count,
+                             size_t* top_leaves, size_t* top_similarities) {
+    assert(similarity != NULL);
+    assert(leaf_i < similarity->leaf_count);
+    assert(top_leaves != NULL);
+    assert(top_similarities != NULL);
+
+    const size_t* neighbour_similarities = similarity->neighbour_similarities;
+
+    size_t left_i = leaf_i;
+    size_t right_i = leaf_i;
+    bool has_left = left_i > 0;
+    bool has_right = right_i + 1 < similarity->leaf_count;
+    size_t left_similarity = has_left ? neighbour_similarities[left_i - 1] : 0;
+    size_t right_similarity = has_right ? neighbour_similarities[right_i] : 0;
+
+    size_t found_count = 0;
+
+    for (; found_count < top_count && (has_left || has_right); found_count++) {
+        if (has_left && (!has_right || left_similarity >= right_similarity)) {
+            left_i--;
+            top_leaves[found_count] = left_i;
+            top_similarities[found_count] = left_similarity;
+
+            has_left = left_i > 0;
+            if (has_left && neighbour_similarities[left_i - 1] < left_similarity) {
+                left_similarity = neighbour_similarities[left_i - 1];
+            }
+        }
+        else {
+            right_i++;
+            top_leaves[found_count] = right_i;
+            top_similarities[found_count] = right_similarity;
+
+            has_right = right_i + 1 < similarity->leaf_count;
+            if (has_right && neighbour_similarities[right_i] < right_similarity) {
+                right_similarity = neighbour_similarities[right_i];
+            }
+        }
+    }
+
+    return found_count;
+}
+
+static void AkinatorSimilarityFillTile(const AkinatorSimilarity* similarity, size_t top_count, AkinatorSimilarityTile* tile) {
+    assert(similarity != NULL);
+    assert(tile != NULL);
+
+    size_t chunk_count = (tile->row_end - tile->row_begin + AKINATOR_SIMILARITY_CHUNK_ROWS - 1) / AKINATOR_SIMILARITY_CHUNK_ROWS;
+    std::atomic<size_t> next_chunk(0);
+
+    auto worker = [similarity, top_count, tile, chunk_count, &next_chunk]() {
+        for (size_t chunk_i = next_chunk++; chunk_i < chunk_count; chunk_i = next_chunk++) {
+            size_t row_begin = tile->row_begin + chunk_i * AKINATOR_SIMILARITY_CHUNK_ROWS;
+            size_t row_end = (row_begin + AKINATOR_SIMILARITY_CHUNK_ROWS < tile->row_end) ? row_begin + AKINATOR_SIMILARITY_CHUNK_ROWS : tile->row_end;
+
+            for (size_t row_i = row_begin; row_i < row_end; row_i++) {
+                size_t cell_i = (row_i - tile->row_begin) * top_count;
+
+                tile->top_counts[row_i - tile->row_begin] = AkinatorSimilarityTop(similarity, row_i, top_count, &tile->top_leaves[cell_i],
+                                                                                  &tile->top_similarities[cell_i]);
+            }
+        }
+    };
+
+    size_t thread_count = TreeParallelThreadCount();
+    if (thread_count > chunk_count) {
+        thread_count = chunk_count;
+    }
+
+    std::thread threads[TREE_PARALLEL_MAX_THREADS];
+    size_t started_count = 0;
+
+    for (; started_count + 1 < thread_count; started_count++) {
+        try {
+            threads[started_count] = std::thread(worker);
+        }
+        catch (const std::system_error&) {
+            break;
+        }
+    }
+
+    worker();
+
+    for (size_t thread_i = 0; thread_i < started_count; thread_i++) {
+        threads[thread_i].join();
+    }
+}
+
+static AkinatorError AkinatorSimilarityWriteTop(const AkinatorSimilarity* similarity, size_t top_count, FILE* stream) {
+    assert(similarity != NULL);
+    assert(stream != NULL);
+
+    AkinatorSimilarityTile tile = {};
+    tile.top_leaves = (size_t*)calloc(AKINATOR_SIMILARITY_TILE_ROWS * top_count, sizeof(size_t));
+    tile.top_similarities = (size_t*)calloc(AKINATOR_SIMILARITY_TILE_ROWS * top_count, sizeof(size_t));
+    tile.top_counts = (size_t*)calloc(AKINATOR_SIMILARITY_TILE_ROWS, sizeof(size_t));
+
+    if (tile.top_leaves == NULL || tile.top_similarities == NULL || tile.top_counts == NULL) {
+        PROTECTED_FREE(tile.top_leaves);
+        PROTECTED_FREE(tile.top_similarities);
+        PROTECTED_FREE(tile.top_counts);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    fprintf(stream, "top %lu\n", top_count);
+
+    for (tile.row_begin = 0; tile.row_begin < similarity->leaf_count; tile.row_begin = tile.row_end) {
+        tile.row_end = tile.row_begin + AKINATOR_SIMILARITY_TILE_ROWS;
+        if (tile.row_end > similarity->leaf_count) {
+            tile.row_end = similarity->leaf_count;
+        }
+
+        AkinatorSimilarityFillTile(similarity, top_count, &tile);
+
+        for (size_t row_i = tile.row_begin; row_i < tile.row_end; row_i++) {
+            size_t cell_i = (row_i - tile.row_begin) * top_count;
+
+            fprintf(stream, "%lu", row_i);
+            for (size_t top_i = 0; top_i < tile.top_counts[row_i - tile.row_begin]; top_i++) {
+                fprintf(stream, " %lu:%lu", tile.top_leaves[cell_i + top_i], tile.top_similarities[cell_i + top_i]);
+            }
+            fputc('\n', stream);
+        }
+    }
+
+    PROTECTED_FREE(tile.top_leaves);
+    PROTECTED_FREE(tile.top_similarities);
+    PROTECTED_FREE(tile.top_counts);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorSimilarityWrite(const AkinatorSimilarity* similarity, size_t top_count, FILE* stream) {
+    assert(similarity != NULL);
+    assert(stream != NULL);
+
+    TRACE_SCOPE("AkinatorSimilarityWrite", TRACE_WORK);
+
+    if (top_count > AKINATOR_SIMILARITY_MAX_TOP) {
+        return AKINATOR_SIMILARITY_ERROR;
+    }
+
+    fprintf(stream, "# objects: <номер> <вопросов до ответа> <имя>\n");
+    fprintf(stream, "# blocks: <сходство> <первая строка> <первый столбец> <конец столбцов>, строки идут до первого столбца\n");
+    fprintf(stream, "# top: <номер> <номер>:<сходство> ... по убыванию сходства\n");
+
+    fprintf(stream, "objects %lu\n", similarity->leaf_count);
+    for (size_t leaf_i = 0; leaf_i < similarity->leaf_count; leaf_i++) {
+        fprintf(stream, "%lu %lu %s\n", leaf_i, similarity->leaf_depths[leaf_i], TreeNodeGetValue(similarity->leaves[leaf_i]));
+    }
+
+    fprintf(stream, "blocks %lu\n", similarity->block_count);
+    for (size_t block_i = 0; block_i < similarity->block_count; block_i++) {
+        const AkinatorSimilarityBlock* block = &similarity->blocks[block_i];
+
+        fprintf(stream, "%lu %lu %lu %lu\n", block->similarity, block->row_begin, block->col_begin, block->col_end);
+    }
+
+    if (top_count == 0) {
+        return AKINATOR_OK;
+    }
+
+    return AkinatorSimilarityWriteTop(similarity, top_count, stream);
+}
+
+/// Сходство перебором: подъем по родителям до общего предка
+static size_t AkinatorSimilarityBruteForce(const AkinatorSimilarity* similarity, size_t first_i, size_t second_i) {
+    assert(similarity != NULL);
+    assert(first_i < similarity->leaf_count);
+    assert(second_i < similarity->leaf_count);
+
+    TreeNode* first = similarity->leaves[first_i];
+    TreeNode* second = similarity->leaves[second_i];
+    size_t first_depth = similarity->leaf_depths[first_i];
+    size_t second_depth = similarity->leaf_depths[second_i];
+
+    for (; first_depth > second_depth; first_depth--) {
+        first = TreeNodeGetParent(first);
+    }
+
+    for (; second_depth > first_depth; second_depth--) {
+        second = TreeNodeGetParent(second);
+    }
+
+    for (; first != second; first_depth--) {
+        first = TreeNodeGetParent(first);
+        second = TreeNodeGetParent(second);
+    }
+
+    return first_depth;
+}
+
+static int AkinatorSimilarityCompareDescending(const void* first, const void* second) {
+    assert(first != NULL);
+    assert(second != NULL);
+
+    size_t first_similarity = *(const size_t*)first;
+    size_t second_similarity = *(const size_t*)second;
+
+    return (first_similarity > second_similarity) ? -1 : (first_similarity < second_similarity);
+}
+
+/// Каждая пара должна лежать ровно в одном блоке с верным сходством
+static bool AkinatorSimilarityCheckBlocks(const AkinatorSimilarity* similarity) {
+    assert(similarity != NULL);
+
+    size_t leaf_count = similarity->leaf_count;
+
+    bool* is_covered = (bool*)calloc(leaf_count * leaf_count, sizeof(bool));
+    if (is_covered == NULL) {
+        return false;
+    }
+
+    bool is_ok = true;
+
+    for (size_t block_i = 0; block_i < similarity->block_count && is_ok; block_i++) {
+        const AkinatorSimilarityBlock* block = &similarity->blocks[block_i];
+
+        for (size_t row_i = block->row_begin; row_i < block->col_begin && is_ok; row_i++) {
+            for (size_t col_i = block->col_begin; col_i < block->col_end && is_ok; col_i++) {
+                is_ok = !is_covered[row_i * leaf_count + col_i]
+                        && AkinatorSimilarityBruteForce(similarity, row_i, col_i) == block->similarity;
+
+                is_covered[row_i * leaf_count + col_i] = true;
+            }
+        }
+    }
+
+    for (size_t row_i = 0; row_i < leaf_count && is_ok; row_i++) {
+        for (size_t col_i = row_i + 1; col_i < leaf_count && is_ok; col_i++) {
+            is_ok = is_covered[row_i * leaf_count + col_i];
+        }
+    }
+
+    PROTECTED_FREE(is_covered);
+
+    return is_ok;
+}
+
+/// Списки ближайших должны совпадать по сходствам с отсортированной строкой перебора
+static bool AkinatorSimilarityCheckTop(const AkinatorSimilarity* similarity, size_t top_count) {
+    assert(similarity != NULL);
+
+    size_t leaf_count = similarity->leaf_count;
+
+    size_t* row_similarities = (size_t*)calloc(leaf_count, sizeof(size_t));
+    size_t top_leaves[AKINATOR_SIMILARITY_MAX_TOP] = {};
+    size_t top_similarities[AKINATOR_SIMILARITY_MAX_TOP] = {};
+
+    if (row_similarities == NULL) {
+        return false;
+    }
+
+    size_t expected_count = (top_count < leaf_count - 1) ? top_count : leaf_count - 1;
+    bool is_ok = true;
+
+    for (size_t row_i = 0; row_i < leaf_count && is_ok; row_i++) {
+        size_t other_count = 0;
+        for (size_t col_i = 0; col_i < leaf_count; col_i++) {
+            if (col_i != row_i) {
+                row_similarities[other_count++] = AkinatorSimilarityBruteForce(similarity, row_i, col_i);
+            }
+        }
+
+        qsort(row_similarities, other_count, sizeof(size_t), AkinatorSimilarityCompareDescending);
+
+        is_ok = AkinatorSimilarityTop(similarity, row_i, top_count, top_leaves, top_similarities) == expected_count;
+
+        for (size_t top_i = 0; top_i < expected_count && is_ok; top_i++) {
+            is_ok = top_leaves[top_i] != row_i
+                    && top_similarities[top_i] == row_similarities[top_i]
+                    && AkinatorSimilarityBruteForce(similarity, row_i, top_leaves[top_i]) == top_similarities[top_i];
+        }
+    }
+
+    PROTECTED_FREE(row_similarities);
+
+    return is_ok;
+}
+
+AkinatorError AkinatorSimilarityCheck(const AkinatorSimilarity* similarity, size_t top_count) {
+    assert(similarity != NULL);
+
+    TRACE_SCOPE("AkinatorSimilarityCheck", TRACE_WORK);
+
+    if (top_count > AKINATOR_SIMILARITY_MAX_TOP) {
+        return AKINATOR_SIMILARITY_ERROR;
+    }
+
+    if (similarity->leaf_count > AKINATOR_SIMILARITY_MAX_CHECK_LEAVES) {
+        return AKINATOR_SIMILARITY_CHECK_ERROR;
+    }
+
+    if (similarity->leaf_count < 2) {
+        return AKINATOR_OK;
+    }
+
+    if (!AkinatorSimilarityCheckBlocks(similarity) || !AkinatorSimilarityCheckTop(similarity, top_count)) {
+        return AKINATOR_SIMILARITY_CHECK_ERROR;
+    }
+
+    return AKINATOR_OK;
+}
+
+void AkinatorSimilarityPrint(const AkinatorSimilarity* similarity, FILE* stream) {
+    assert(similarity != NULL);
+    assert(stream != NULL);
+
+    size_t pair_count = 0;
+    for (size_t level_i = 0; level_i < similarity->level_count; level_i++) {
+        pair_count += similarity->pair_counts[level_i];
+    }
+
+    fprintf(stream, "Объектов: %lu, пар: %lu, блоков матрицы: %lu\n", similarity->leaf_count, pair_count, similarity->block_count);
+    fprintf(stream, "Пар по числу общих вопросов:\n");
+
+    for (size_t level_i = 0; level_i < similarity->level_count; level_i++) {
+        if (similarity->pair_counts[level_i] != 0) {
+            fprintf(stream, "    %lu: %lu\n", level_i, similarity->pair_counts[level_i]);
+        }
+    }
+}
@@ -0,0 +1,645 @@
+#include "akinator_stats.hpp"
+
+#include <assert.h>
+#include <string.h>
+#include <atomic>
+#include <system_error>
+#include <thread>
+
+#include "utils.hpp"
+
+static const size_t AKINATOR_STATS_START_CAPACITY = 64;
+
+struct AkinatorStatsValues {
+    const char** values;
+    size_t size;
+    size_t capacity;
+};
+
+enum AkinatorStatsStage {
+    AKINATOR_STATS_ENTER      = 0,
+    AKINATOR_STATS_LEFT_DONE  = 1,
+    AKINATOR_STATS_RIGHT_DONE = 2
+};
+
+/// Вершина обхода; left_size запоминается, пока обходится правое поддерево
+struct AkinatorStatsFrame {
+    TreeNode* node;
+    size_t depth;
+    size_t left_size;
+
+    AkinatorStatsStage stage;
+};
+
+struct AkinatorStatsStack {
+    AkinatorStatsFrame* frames;
+    size_t size;
+    size_t capacity;
+};
+
+struct AkinatorStatsPartial {
+    size_t node_count;
+    size_t leaf_count;
+    size_t internal_count;
+
+    AkinatorStatsLevel* levels;
+    size_t level_count;
+
+    size_t questions_sum;
+    size_t max_questions;
+
+    size_t string_bytes;
+    size_t heap_string_bytes;
+
+    AkinatorStatsValues leaf_values;
+    AkinatorStatsValues question_values;
+
+    bool is_alloc_failed;
+};
+
+struct AkinatorStatsTask {
+    TreeNode* node;
+    size_t depth;
+
+    size_t size;
+};
+
+struct AkinatorStatsFrontier {
+    AkinatorStatsTask* tasks;
+    size_t task_count;
+};
+
+static bool AkinatorStatsValuesPush(AkinatorStatsValues* values, const char* value) {
+    assert(values != NULL);
+
+    if (values->size == values->capacity) {
+        size_t new_capacity = (values->capacity == 0) ? AKINATOR_STATS_START_CAPACITY : 2 * values->capacity;
+
+        const char** new_values = (const char**)realloc(values->values, new_capacity * sizeof(const char*));
+        if (new_values == NULL) {
+            return false;
+        }
+
+        values->values = new_values;
+        values->capacity = new_capacity;
+    }
+
+    values->values[values->size++] = value;
+
+    return true;
+}
+
+static bool AkinatorStatsValuesAppend(AkinatorStatsValues* values, const AkinatorStatsValues* other) {
+    assert(values != NULL);
+    assert(other != NULL);
+
+    for (size_t value_i = 0; value_i < other->size; value_i++) {
+        if (!AkinatorStatsValuesPush(values, other->values[value_i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static AkinatorStatsLevel* AkinatorStatsGetLevel(AkinatorStatsLevel** levels, size_t* level_count, size_t depth) {
+    assert(levels != NULL);
+    assert(level_count != NULL);
+
+    if (depth >= *level_count) {
+        size_t new_count = (*level_count == 0) ? AKINATOR_STATS_START_CAPACITY : *level_count;
+        while (new_count <= depth) {
+            new_count *= 2;
+        }
+
+        AkinatorStatsLevel* new_levels = (AkinatorStatsLevel*)realloc(*levels, new_count * sizeof(AkinatorStatsLevel));
+        if (new_levels == NULL) {
+            return NULL;
+        }
+
+        memset(new_levels + *level_count, 0, (new_count - *level_count) * sizeof(AkinatorStatsLevel));
+
+        *levels = new_levels;
+        *level_count = new_count;
+    }
+
+    return &(*levels)[depth];
+}
+
+static bool AkinatorStatsFindFrontier(const AkinatorStatsFrontier* frontier, TreeNode* node, size_t* size) {
+    assert(size != NULL);
+
+    if (frontier == NULL) {
+        return false;
+    }
+
+    for (size_t task_i = 0; task_i < frontier->task_count; task_i++) {
+        if (frontier->tasks[task_i].node == node) {
+            *size = frontier->tasks[task_i].size;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Учитывает вершину и ее уровень; размеры поддеревьев досчитываются в AkinatorStatsLeave
+static void AkinatorStatsEnter(TreeNode* node, size_t depth, AkinatorStatsPartial* partial) {
+    assert(node != NULL);
+    assert(partial != NULL);
+
+    AkinatorStatsLevel* level = AkinatorStatsGetLevel(&partial->levels, &partial->level_count, depth);
+    if (level == NULL) {
+        partial->is_alloc_failed = true;
+        return;
+    }
+
+    partial->node_count++;
+    level->node_count++;
+
+    size_t value_bytes = node->value.Size() + 1;
+    partial->string_bytes += value_bytes;
+    if (node->value.IsHeap()) {
+        partial->heap_string_bytes += value_bytes;
+    }
+
+    if (TreeNodeGetLeft(node) == NULL && TreeNodeGetRight(node) == NULL) {
+        partial->leaf_count++;
+        level->leaf_count++;
+
+        partial->questions_sum += depth;
+        if (depth > partial->max_questions) {
+            partial->max_questions = depth;
+        }
+
+        if (!AkinatorStatsValuesPush(&partial->leaf_values, TreeNodeGetValue(node))) {
+            partial->is_alloc_failed = true;
+        }
+
+        return;
+    }
+
+    partial->internal_count++;
+    if (!AkinatorStatsValuesPush(&partial->question_values, TreeNodeGetValue(node))) {
+        partial->is_alloc_failed = true;
+    }
+}
+
+static void AkinatorStatsLeave(size_t depth, size_t left_size, size_t right_size, AkinatorStatsPartial* partial) {
+    assert(partial != NULL);
+
+    if (depth >= partial->level_count) {
+        return;
+    }
+
+    AkinatorStatsLevel* level = &partial->levels[depth];
+    size_t imbalance = (left_size > right_size) ? left_size - right_size : right_size - left_size;
+
+    level->internal_count++;
+    level->imbalance_sum += imbalance;
+    if (imbalance > level->max_imbalance) {
+        level->max_imbalance = imbalance;
+    }
+}
+
+static bool AkinatorStatsPushFrame(AkinatorStatsStack* stack, TreeNode* node, size_t depth) {
+    assert(stack != NULL);
+
+    if (stack->size == stack->capacity) {
+        size_t new_capacity = (stack->capacity == 0) ? AKINATOR_STATS_START_CAPACITY : stack->capacity * 2;
+
+        AkinatorStatsFrame* new_frames = (AkinatorStatsFrame*)realloc(stack->frames, new_capacity * sizeof(AkinatorStatsFrame));
+        if (new_frames == NULL) {
+            return false;
+        }
+
+        stack->frames = new_frames;
+        stack->capacity = new_capacity;
+    }
+
+    stack->frames[stack->size++] = {node, depth, 0, AKINATOR_STATS_ENTER};
+
+    return true;
+}
+
+/// Обходит поддерево и возвращает число вершин в нем; вершины фронта уже посчитаны потоками и только отдают размер.
+/// Стек вершин лежит в куче, поэтому глубина дерева ограничена только памятью
+static size_t AkinatorStatsVisit(TreeNode* node, size_t depth, AkinatorStatsPartial* partial, const AkinatorStatsFrontier* frontier) {
+    assert(partial != NULL);
+
+    AkinatorStatsStack stack = {};
+    if (!AkinatorStatsPushFrame(&stack, node, depth)) {
+        partial->is_alloc_failed = true;
+        return 0;
+    }
+
+    size_t last_size = 0;
+
+    while (stack.size > 0) {
+        AkinatorStatsFrame* frame = &stack.frames[stack.size - 1];
+        TreeNode* frame_node = frame->node;
+        size_t frame_depth = frame->depth;
+
+        size_t frontier_size = 0;
+
+        switch (frame->stage) {
+            case AKINATOR_STATS_ENTER:
+                if (frame_node == NULL) {
+                    last_size = 0;
+                    stack.size--;
+                    break;
+                }
+
+                if (AkinatorStatsFindFrontier(frontier, frame_node, &frontier_size)) {
+                    last_size = frontier_size;
+                    stack.size--;
+                    break;
+                }
+
+                AkinatorStatsEnter(frame_node, frame_depth, partial);
+
+                if (TreeNodeGetLeft(frame_node) == NULL && TreeNodeGetRight(frame_node) == NULL) {
+                    last_size = 1;
+                    stack.size--;
+                    break;
+                }
+
+                frame->stage = AKINATOR_STATS_LEFT_DONE;
+                if (!AkinatorStatsPushFrame(&stack, TreeNodeGetLeft(frame_node), frame_depth + 1)) {
+                    partial->is_alloc_failed = true;
+                    stack.size = 0;
+                }
+                break;
+            case AKINATOR_STATS_LEFT_DONE:
+                frame->left_size = last_size;
+                frame->stage = AKINATOR_STATS_RIGHT_DONE;
+                if (!AkinatorStatsPushFrame(&stack, TreeNodeGetRight(frame_node), frame_depth + 1)) {
+                    partial->is_alloc_failed = true;
+                    stack.size = 0;
+                }
+                break;
+            case AKINATOR_STATS_RIGHT_DONE:
+                AkinatorStatsLeave(frame_depth, frame->left_size, last_size, partial);
+                last_size = 1 + frame->left_size + last_size;
+                stack.size--;
+                break;
+            default:
+                assert(0 && "Unknown stats stage");
+                break;
+        }
+    }
+
+    PROTECTED_FREE(stack.frames);
+
+    return last_size;
+}
+
+static void AkinatorStatsPartialDestroy(AkinatorStatsPartial* partial) {
+    assert(partial != NULL);
+
+    PROTECTED_FREE(partial->levels);
+    PROTECTED_FREE(partial->leaf_values.values);
+    PROTECTED_FREE(partial->question_values.values);
+}
+
+static bool AkinatorStatsMerge(AkinatorStatsPartial* total, const AkinatorStatsPartial* partial) {
+    assert(total != NULL);
+    assert(partial != NULL);
+
+    total->node_count += partial->node_count;
+    total->leaf_count += partial->leaf_count;
+    total->internal_count += partial->internal_count;
+    total->questions_sum += partial->questions_sum;
+    total->string_bytes += partial->string_bytes;
+    total->heap_string_bytes += partial->heap_string_bytes;
+
+    if (partial->max_questions > total->max_questions) {
+        total->max_questions = partial->max_questions;
+    }
+
+    for (size_t depth = partial->level_count; depth > 0; depth--) {
+        const AkinatorStatsLevel* level = &partial->levels[depth - 1];
+        if (level->node_count == 0) {
+            continue;
+        }
+
+        AkinatorStatsLevel* total_level = AkinatorStatsGetLevel(&total->levels, &total->level_count, depth - 1);
+        if (total_level == NULL) {
+            return false;
+        }
+
+        total_level->node_count += level->node_count;
+        total_level->leaf_count += level->leaf_count;
+        total_level->internal_count += level->internal_count;
+        total_level->imbalance_sum += level->imbalance_sum;
+        if (level->max_imbalance > total_level->max_imbalance) {
+            total_level->max_imbalance = level->max_imbalance;
+        }
+    }
+
+    return !partial->is_alloc_failed
+           && AkinatorStatsValuesAppend(&total->leaf_values, &partial->leaf_values)
+           && AkinatorStatsValuesAppend(&total->question_values, &partial->question_values);
+}
+
+static int AkinatorStatsValueCmp(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static void AkinatorStatsFindDuplicates(AkinatorStatsValues* values, AkinatorStatsDuplicates* duplicates) {
+    assert(values != NULL);
+    assert(duplicates != NULL);
+
+    qsort(values->values, values->size, sizeof(const char*), AkinatorStatsValueCmp);
+
+    for (size_t begin = 0; begin < values->size; ) {
+        size_t end = begin + 1;
+        while (end < values->size && strcmp(values->values[begin], values->values[end]) == 0) {
+            end++;
+        }
+
+        if (end - begin > 1) {
+            duplicates->group_count++;
+            duplicates->extra_count += end - begin - 1;
+
+            if (duplicates->example_count < AKINATOR_STATS_MAX_REPORTED_DUPLICATES) {
+                duplicates->examples[duplicates->example_count] = values->values[begin];
+                duplicates->example_counts[duplicates->example_count] = end - begin;
+                duplicates->example_count++;
+            }
+        }
+
+        begin = end;
+    }
+}
+
+/// Раскрывает верхушку дерева, пока не наберется достаточно поддеревьев для раздачи потокам
+static AkinatorError AkinatorStatsBuildFrontier(TreeNode* first_node, size_t target, AkinatorStatsFrontier* frontier) {
+    assert(frontier != NULL);
+
+    frontier->tasks = (AkinatorStatsTask*)calloc(2 * target + 2, sizeof(AkinatorStatsTask));
+    if (frontier->tasks == NULL) {
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorStatsTask* next_tasks = (AkinatorStatsTask*)calloc(2 * target + 2, sizeof(AkinatorStatsTask));
+    if (next_tasks == NULL) {
+        PROTECTED_FREE(frontier->tasks);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    frontier->task_count = 0;
+    frontier->tasks[frontier->task_count++] = {first_node, 0, 0};
+
+    bool is_expanded = true;
+    while (frontier->task_count < target && is_expanded) {
+        is_expanded = false;
+        size_t next_count = 0;
+
+        for (size_t task_i = 0; task_i < frontier->task_count; task_i++) {
+            AkinatorStatsTask task = frontier->tasks[task_i];
+            TreeNode* left = TreeNodeGetLeft(task.node);
+            TreeNode* right = TreeNodeGetRight(task.node);
+
+            if ((left == NULL && right == NULL) || next_count + 2 > 2 * target + 2) {
+                next_tasks[next_count++] = task;
+                continue;
+            }
+
+            if (left != NULL) {
+                next_tasks[next_count++] = {left, task.depth + 1, 0};
+            }
+
+            if (right != NULL) {
+                next_tasks[next_count++] = {right, task.depth + 1, 0};
+            }
+
+            is_expanded = true;
+        }
+
+        AkinatorStatsTask* tmp = frontier->tasks;
+        frontier->tasks = next_tasks;
+        next_tasks = tmp;
+        frontier->task_count = next_count;
+    }
+
+    free(next_tasks);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorStatsCollect(Akinator* akinator, AkinatorStats* stats) {
+    assert(akinator != NULL);
+    assert(stats != NULL);
+
+    memset(stats, 0, sizeof(AkinatorStats));
+
+    AkinatorError index_err = AkinatorEnsureIndexes(akinator);
+    if (index_err != AKINATOR_OK) {
+        return index_err;
+    }
+
+    TreeNode* first_node = TreeNodeGetLeft(TreeGetRoot(&akinator->tree));
+
+    size_t thread_count = std::thread::hardware_concurrency();
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+
+    AkinatorStatsFrontier frontier = {};
+    if (first_node != NULL) {
+        AkinatorError frontier_err = AkinatorStatsBuildFrontier(first_node, AKINATOR_STATS_TASKS_PER_THREAD * thread_count, &frontier);
+        if (frontier_err != AKINATOR_OK) {
+            return frontier_err;
+        }
+    }
+
+    if (frontier.task_count < thread_count) {
+        thread_count = (frontier.task_count == 0) ? 1 : frontier.task_count;
+    }
+
+    AkinatorStatsPartial* partials = (AkinatorStatsPartial*)calloc(thread_count + 1, sizeof(AkinatorStatsPartial));
+    if (partials == NULL) {
+        free(frontier.tasks);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    std::atomic<size_t> next_task(0);
+    auto worker = [&](size_t thread_i) {
+        for (size_t task_i = next_task++; task_i < frontier.task_count; task_i = next_task++) {
+            AkinatorStatsTask* task = &frontier.tasks[task_i];
+            task->size = AkinatorStatsVisit(task->node, task->depth, &partials[thread_i], NULL);
+        }
+    };
+
+    std::thread* threads = new (std::nothrow) std::thread[thread_count];
+    size_t started_count = 0;
+    if (threads != NULL) {
+        for (; started_count < thread_count; started_count++) {
+            try {
+                threads[started_count] = std::thread(worker, started_count);
+            }
+            catch (const std::system_error&) {
+                break;
+            }
+        }
+    }
+
+    worker(thread_count);
+
+    for (size_t thread_i = 0; thread_i < started_count; thread_i++) {
+        threads[thread_i].join();
+    }
+    delete[] threads;
+
+    AkinatorStatsPartial total = {};
+    AkinatorStatsVisit(first_node, 0, &total, &frontier);
+
+    bool is_merged = !total.is_alloc_failed;
+    for (size_t thread_i = 0; thread_i <= thread_count; thread_i++) {
+        is_merged = AkinatorStatsMerge(&total, &partials[thread_i]) && is_merged;
+        AkinatorStatsPartialDestroy(&partials[thread_i]);
+    }
+
+    free(partials);
+    free(frontier.tasks);
+
+    if (!is_merged) {
+        AkinatorStatsPartialDestroy(&total);
+        return AKINATOR_NODE_ALLOC_ERROR;
+    }
+
+    AkinatorStatsFindDuplicates(&total.leaf_values, &stats->duplicate_leaves);
+    AkinatorStatsFindDuplicates(&total.question_values, &stats->duplicate_questions);
+
+    stats->node_count = total.node_count;
+    stats->leaf_count = total.leaf_count;
+    stats->internal_count = total.internal_count;
+    stats->questions_sum = total.questions_sum;
+    stats->max_questions = total.max_questions;
+    stats->string_bytes = total.string_bytes;
+    stats->heap_string_bytes = total.heap_string_bytes;
+    stats->node_bytes = total.node_count * sizeof(TreeNode);
+    stats->trie = RadixTrieGetMemoryStats(&akinator->value_trie);
+    stats->thread_count = started_count + 1;
+
+    stats->levels = total.levels;
+    stats->level_count = total.level_count;
+    while (stats->level_count > 0 && stats->levels[stats->level_count - 1].node_count == 0) {
+        stats->level_count--;
+    }
+
+    free(total.leaf_values.values);
+    free(total.question_values.values);
+
+    return AKINATOR_OK;
+}
+
+AkinatorError AkinatorStatsDestroy(AkinatorStats* stats) {
+    assert(stats != NULL);
+
+    PROTECTED_FREE(stats->levels);
+    stats->level_count = 0;
+
+    return AKINATOR_OK;
+}
+
+static double AkinatorStatsAverageQuestions(const AkinatorStats* stats) {
+    assert(stats != NULL);
+
+    return (stats->leaf_count == 0) ? 0 : (double)stats->questions_sum / (double)stats->leaf_count;
+}
+
+static void AkinatorStatsPrintDuplicates(const AkinatorStatsDuplicates* duplicates, FILE* stream) {
+    assert(duplicates != NULL);
+    assert(stream != NULL);
+
+    for (size_t example_i = 0; example_i < duplicates->example_count; example_i++) {
+        fprintf(stream, "    %s (x%lu)\n", duplicates->examples[example_i], duplicates->example_counts[example_i]);
+    }
+}
+
+void AkinatorStatsPrint(const AkinatorStats* stats, FILE* stream) {
+    assert(stats != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "Вершин: %lu (листьев: %lu, вопросов: %lu)\n", stats->node_count, stats->leaf_count, stats->internal_count);
+    fprintf(stream, "Вопросов до ответа: в среднем %.2f, максимум %lu\n", AkinatorStatsAverageQuestions(stats), stats->max_questions);
+
+    fprintf(stream, "Уровни (глубина: вершин / листьев / средний и максимальный перекос):\n");
+    for (size_t depth = 0; depth < stats->level_count; depth++) {
+        const AkinatorStatsLevel* level = &stats->levels[depth];
+        double average_imbalance = (level->internal_count == 0) ? 0 : (double)level->imbalance_sum / (double)level->internal_count;
+
+        fprintf(stream, "    %lu: %lu / %lu / %.2f / %lu\n", depth, level->node_count, level->leaf_count, average_imbalance, level->max_imbalance);
+    }
+
+    fprintf(stream, "Повторяющихся имен: %lu (лишних листьев: %lu)\n", stats->duplicate_leaves.group_count, stats->duplicate_leaves.extra_count);
+    AkinatorStatsPrintDuplicates(&stats->duplicate_leaves, stream);
+
+    fprintf(stream, "Повторяющихся вопросов: %lu (лишних вершин: %lu)\n", stats->duplicate_questions.group_count, stats->duplicate_questions.extra_count);
+    AkinatorStatsPrintDuplicates(&stats->duplicate_questions, stream);
+
+    fprintf(stream, "Память: вершины %lu байт, строки %lu байт (из них в куче %lu)\n", stats->node_bytes, stats->string_bytes, stats->heap_string_bytes);
+    fprintf(stream, "Префиксное дерево: %lu вершин, %lu байт на %lu байт строк (x%.2f)\n", stats->trie.node_count, stats->trie.trie_bytes, stats->trie.raw_bytes, stats->trie.overhead);
+    fprintf(stream, "Потоков: %lu\n", stats->thread_count);
+}
+
+static void AkinatorStatsPrintJsonString(const char* str, FILE* stream) {
+    assert(str != NULL);
+    assert(stream != NULL);
+
+    fputc('"', stream);
+    for (const char* s = str; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', stream);
+            fputc(*s, stream);
+        }
+        else if ((unsigned char)*s < 0x20) {
+            fprintf(stream, "\\u%04x", (unsigned)*s);
+        }
+        else {
+            fputc(*s, stream);
+        }
+    }
+    fputc('"', stream);
+}
+
+static void AkinatorStatsPrintJsonDuplicates(const AkinatorStatsDuplicates* duplicates, FILE* stream) {
+    assert(duplicates != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "{\"groups\":%lu,\"extra\":%lu,\"examples\":[", duplicates->group_count, duplicates->extra_count);
+    for (size_t example_i = 0; example_i < duplicates->example_count; example_i++) {
+        fprintf(stream, "%s{\"text\":", (example_i == 0) ? "" : ",");
+        AkinatorStatsPrintJsonString(duplicates->examples[example_i], stream);
+        fprintf(stream, ",\"count\":%lu}", duplicates->example_counts[example_i]);
+    }
+    fprintf(stream, "]}");
+}
+
+void AkinatorStatsPrintJson(const AkinatorStats* stats, FILE* stream) {
+    assert(stats != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "{\"nodes\":%lu,\"leaves\":%lu,\"internal\":%lu,", stats->node_count, stats->leaf_count, stats->internal_count);
+    fprintf(stream, "\"questions\":{\"average\":%.4f,\"max\":%lu},", AkinatorStatsAverageQuestions(stats), stats->max_questions);
+
+    fprintf(stream, "\"levels\":[");
+    for (size_t depth = 0; depth < stats->level_count; depth++) {
+        const AkinatorStatsLevel* level = &stats->levels[depth];
+
+        fprintf(stream, "%s{\"depth\":%lu,\"nodes\":%lu,\"leaves\":%lu,\"imbalance_sum\":%lu,\"max_imbalance\":%lu}",
+                (depth == 0) ? "" : ",", depth, level->node_count, level->leaf_count, level->imbalance_sum, level->max_imbalance);
+    }
+    fprintf(stream, "],");
+
+    fprintf(stream, "\"duplicate_leaves\":");
+    AkinatorStatsPrintJsonDuplicates(&stats->duplicate_leaves, stream);
+    fprintf(stream, ",\"duplicate_questions\":");
+    AkinatorStatsPrintJsonDuplicates(&stats->duplicate_questions, stream);
+
+    fprintf(stream, ",\"bytes\":{\"nodes\":%lu,\"strings\":%lu,\"heap_strings\":%lu,\"trie\":%lu,\"trie_raw\":%lu},",
+            stats->node_bytes, stats->string_bytes, stats->heap_string_bytes, stats->trie.trie_bytes, stats->trie.raw_bytes);
+    fprintf(stream, "\"threads\":%lu}\n", stats->thread_count);
+}
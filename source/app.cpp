@@ -1,39 +1,502 @@
 #include "app.hpp"
 #include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/stat.h>
 
 #include "akinator.hpp"
+#include "akinator_bench.hpp"
+#include "akinator_diff.hpp"
+#include "akinator_embedded.hpp"
+#include "akinator_eval.hpp"
+#include "akinator_io.hpp"
+#include "akinator_merge.hpp"
+#include "akinator_reload.hpp"
+#include "akinator_similarity.hpp"
+#include "akinator_stats.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
 #include "tree.hpp"
 #include "utils.hpp"
 
+/// Закрывает записываемую или воспроизводимую сессию, сохраняет метрики и трассу в файлы и освобождает их;
+/// вызывается после остановки фоновых потоков. Возвращает app_err, а если он AKINATOR_OK - ошибку сессии,
+/// чтобы расхождение воспроизведения попадало в код выхода на любом пути
+static AkinatorError AkinatorReportsDump(const char* metrics_file_name, const char* trace_file_name, AkinatorError app_err) {
+    assert(metrics_file_name != NULL);
+    assert(trace_file_name != NULL);
+
+    AkinatorError session_err = AkinatorIoStop(stdout);
+    if (session_err != AKINATOR_OK) {
+        AKINATOR_PRINT_ERROR(session_err);
+    }
+
+    if (strlen(metrics_file_name) != 0) {
+        MetricsError metrics_err = MetricsDump(metrics_file_name);
+        if (metrics_err != METRICS_OK) {
+            METRICS_PRINT_ERROR(metrics_err);
+        }
+    }
+
+    MetricsDestroy();
+
+    TRACE_FLUSH(trace_file_name);
+
+    return (app_err != AKINATOR_OK) ? app_err : session_err;
+}
+
+/// Печатает отличия базы diff_file_name от уже загруженной
+static AkinatorError AkinatorAppDiff(Akinator* akinator, const char* diff_file_name) {
+    assert(akinator != NULL);
+    assert(diff_file_name != NULL);
+
+    Akinator other = {};
+    AkinatorError diff_err = AkinatorTreeInit(&other);
+
+    if (diff_err == AKINATOR_OK) {
+        diff_err = AkinatorTreeLoadFile(&other, diff_file_name);
+    }
+
+    AkinatorDiffStats stats = {};
+    if (diff_err == AKINATOR_OK) {
+        diff_err = AkinatorDiff(akinator, &other, stdout, &stats);
+    }
+
+    if (diff_err == AKINATOR_OK) {
+        printf("Изменено: %lu, добавлено: %lu, удалено: %lu (просмотрено пар вершин: %lu)\n",
+               stats.changed_count, stats.added_count, stats.removed_count, stats.visited_count);
+    }
+
+    AkinatorTreeDestroy(&other);
+
+    return diff_err;
+}
+
+/// Печатает размеры исходной и новой базы и скорость разбора новой
+static AkinatorError AkinatorAppConvertReport(const char* database_file_name, const char* convert_file_name) {
+    assert(database_file_name != NULL);
+    assert(convert_file_name != NULL);
+
+    struct stat database_stat = {};
+    struct stat convert_stat = {};
+
+    if (stat(database_file_name, &database_stat) != 0 || stat(convert_file_name, &convert_stat) != 0) {
+        return AKINATOR_DATABASE_FILE_OPEN_ERROR;
+    }
+
+    Akinator converted = {};
+    AkinatorError report_err = AkinatorTreeInit(&converted);
+
+    uint64_t start_ns = MetricsNow();
+
+    if (report_err == AKINATOR_OK) {
+        report_err = AkinatorTreeLoadFile(&converted, convert_file_name);
+    }
+
+    uint64_t load_ns = MetricsNow() - start_ns;
+
+    if (report_err == AKINATOR_OK) {
+        double ratio = (convert_stat.st_size == 0) ? 0 : (double)database_stat.st_size / (double)convert_stat.st_size;
+        double load_ms = (double)load_ns / 1e6;
+
+        printf("%s: %ld байт, %s: %ld байт, сжатие в %.2f раза\n",
+               database_file_name, database_stat.st_size, convert_file_name, convert_stat.st_size, ratio);
+        printf("Загрузка %s вместе с индексами: %.1f мс, %.1f МБ/с\n",
+               convert_file_name, load_ms, (load_ns == 0) ? 0 : (double)convert_stat.st_size / 1e6 / (load_ms / 1e3));
+    }
+
+    AkinatorTreeDestroy(&converted);
+
+    return report_err;
+}
+
+/// Сливает базы merge_file_names[1] и merge_file_names[2], выведенные из merge_file_names[0], в merge_file_names[3]
+static AkinatorError AkinatorAppMerge(const char* const* merge_file_names) {
+    assert(merge_file_names != NULL);
+
+    AkinatorMergeStats stats = {};
+    AkinatorError merge_err = AkinatorMerge(merge_file_names[0], merge_file_names[1], merge_file_names[2],
+                                            merge_file_names[3], stdout, &stats);
+
+    if (merge_err == AKINATOR_OK) {
+        printf("Изменений в первой базе: %lu, во второй: %lu, конфликтов: %lu\n",
+               stats.first_change_count, stats.second_change_count, stats.conflict_count);
+    }
+
+    return merge_err;
+}
+
+/// Разбирает неотрицательное десятичное число; false, если в строке есть что-то кроме цифр
+static bool AkinatorAppParseCount(const char* str, size_t* count) {
+    assert(str != NULL);
+    assert(count != NULL);
+
+    char* end = NULL;
+    unsigned long value = strtoul(str, &end, 10);
+
+    if (str[0] < '0' || str[0] > '9' || *end != '\0') {
+        return false;
+    }
+
+    *count = value;
+
+    return true;
+}
+
+/// Пишет синтетическую базу: gen_args - файл, число листьев, форма дерева и длина значений
+static AkinatorError AkinatorAppGenerate(const char* const* gen_args) {
+    assert(gen_args != NULL);
+
+    size_t leaf_count = 0;
+    size_t value_len = 0;
+    AkinatorBenchShape shape = AKINATOR_BENCH_BALANCED;
+
+    if (!AkinatorAppParseCount(gen_args[1], &leaf_count) || !AkinatorBenchParseShape(gen_args[2], &shape)
+        || !AkinatorAppParseCount(gen_args[3], &value_len)) {
+        return AKINATOR_BENCH_ERROR;
+    }
+
+    return AkinatorBenchGenerate(gen_args[0], leaf_count, shape, value_len);
+}
+
+/// Запускает бенчмарк: bench_args - база, файл CSV, число учитываемых повторов и число прогревочных
+static AkinatorError AkinatorAppBench(const char* const* bench_args) {
+    assert(bench_args != NULL);
+
+    size_t repeat_count = 0;
+    size_t warmup_count = 0;
+
+    if (!AkinatorAppParseCount(bench_args[2], &repeat_count) || !AkinatorAppParseCount(bench_args[3], &warmup_count)) {
+        return AKINATOR_BENCH_ERROR;
+    }
+
+    return AkinatorBenchRun(bench_args[0], bench_args[1], repeat_count, warmup_count);
+}
+
+/// Играет за каждый лист базы и печатает, сколько вопросов нужно до ответа; error_rate_str - доля ошибок оракула
+static AkinatorError AkinatorAppEval(Akinator* akinator, const char* error_rate_str) {
+    assert(akinator != NULL);
+    assert(error_rate_str != NULL);
+
+    char* end = NULL;
+    double error_rate = strtod(error_rate_str, &end);
+    if (end == error_rate_str || *end != '\0') {
+        return AKINATOR_EVAL_ERROR;
+    }
+
+    AkinatorEvalResult result = {};
+    AkinatorError eval_err = AkinatorEvalRun(akinator, error_rate, &result);
+
+    if (eval_err == AKINATOR_OK) {
+        AkinatorEvalPrint(&result, stdout);
+    }
+
+    AkinatorEvalDestroy(&result);
+
+    return eval_err;
+}
+
+/// Пишет матрицу сходства объектов в similarity_args[0] и по similarity_args[1] ближайших к каждому объекту;
+/// с is_check сначала сверяет их с перебором всех пар
+static AkinatorError AkinatorAppSimilarity(Akinator* akinator, const char* const* similarity_args, bool is_check) {
+    assert(akinator != NULL);
+    assert(similarity_args != NULL);
+
+    size_t top_count = 0;
+    if (!AkinatorAppParseCount(similarity_args[1], &top_count) || top_count > AKINATOR_SIMILARITY_MAX_TOP) {
+        return AKINATOR_SIMILARITY_ERROR;
+    }
+
+    AkinatorSimilarity similarity = {};
+    AkinatorError similarity_err = AkinatorSimilarityBuild(akinator, &similarity);
+
+    if (similarity_err == AKINATOR_OK && is_check) {
+        similarity_err = AkinatorSimilarityCheck(&similarity, top_count);
+    }
+
+    FILE* similarity_file = NULL;
+    if (similarity_err == AKINATOR_OK) {
+        similarity_file = fopen(similarity_args[0], "w");
+        if (similarity_file == NULL) {
+            similarity_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+        }
+    }
+
+    if (similarity_err == AKINATOR_OK) {
+        similarity_err = AkinatorSimilarityWrite(&similarity, top_count, similarity_file);
+    }
+
+    if (similarity_file != NULL && fclose(similarity_file) != 0 && similarity_err == AKINATOR_OK) {
+        similarity_err = AKINATOR_DATABASE_FILE_CREATE_ERROR;
+    }
+
+    if (similarity_err == AKINATOR_OK) {
+        AkinatorSimilarityPrint(&similarity, stdout);
+    }
+
+    AkinatorSimilarityDestroy(&similarity);
+
+    return similarity_err;
+}
+
+/// Подменяет дерево готовым фоновым разбором и печатает ошибку разбора, если она была
+static void AkinatorAppPollReload(AkinatorReloader* reloader, Akinator* akinator) {
+    assert(reloader != NULL);
+    assert(akinator != NULL);
+
+    if (AkinatorReloaderPoll(reloader, akinator)) {
+        AkinatorPrintf("База данных перезагружена\n");
+    }
+
+    AkinatorError reload_err = reloader->last_error.exchange(AKINATOR_OK);
+    if (reload_err != AKINATOR_OK) {
+        AKINATOR_PRINT_ERROR(reload_err);
+    }
+}
+
 AkinatorError AkinatorApp(int argc, const char** argv) {
-    Tree akinator_tree = {};
+    Akinator akinator = {};
 
     bool is_fast_load = false;
+    bool is_watch = false;
+    bool is_lazy = false;
+    bool is_stats = false;
+    bool is_json = false;
+    bool is_embedded = false;
     char database_file_name[MAX_FILE_NAME_LEN + 1] = {};
-    if (argc == 3) {
-        if (strcmp(argv[1], "-f") == 0 || strcmp(argv[1], "-file") == 0) {
+    char convert_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    char metrics_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    char diff_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    char embed_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    char trace_file_name[MAX_FILE_NAME_LEN + 1] = {};
+    const char* merge_file_names[4] = {};
+    const char* gen_args[4] = {};
+    const char* bench_args[4] = {};
+    const char* eval_error_rate = NULL;
+    const char* similarity_args[2] = {};
+    bool is_similarity_check = false;
+    const char* record_file_name = NULL;
+    const char* replay_file_name = NULL;
+    bool is_paced = false;
+    strncpy(trace_file_name, TRACE_DEFAULT_FILE_NAME, MAX_FILE_NAME_LEN);
+    for (int arg_i = 1; arg_i < argc; arg_i++) {
+        if ((strcmp(argv[arg_i], "-f") == 0 || strcmp(argv[arg_i], "-file") == 0) && arg_i + 1 < argc) {
             is_fast_load = true;
-            strncpy(database_file_name, argv[2], MAX_FILE_NAME_LEN);
+            strncpy(database_file_name, argv[++arg_i], MAX_FILE_NAME_LEN);
+        }
+        else if (strcmp(argv[arg_i], "-w") == 0 || strcmp(argv[arg_i], "-watch") == 0) {
+            is_watch = true;
+        }
+        else if (strcmp(argv[arg_i], "-e") == 0 || strcmp(argv[arg_i], "-embedded") == 0) {
+            is_embedded = true;
+        }
+        else if (strcmp(argv[arg_i], "-embed") == 0 && arg_i + 1 < argc) {
+            strncpy(embed_file_name, argv[++arg_i], MAX_FILE_NAME_LEN);
+        }
+        else if (strcmp(argv[arg_i], "-l") == 0 || strcmp(argv[arg_i], "-lazy") == 0) {
+            is_lazy = true;
+        }
+        else if (strcmp(argv[arg_i], "-s") == 0 || strcmp(argv[arg_i], "-stats") == 0) {
+            is_stats = true;
+        }
+        else if (strcmp(argv[arg_i], "-eval") == 0 && arg_i + 1 < argc) {
+            eval_error_rate = argv[++arg_i];
+        }
+        else if (strcmp(argv[arg_i], "-similarity") == 0 && arg_i + 2 < argc) {
+            similarity_args[0] = argv[++arg_i];
+            similarity_args[1] = argv[++arg_i];
+        }
+        else if (strcmp(argv[arg_i], "-check") == 0) {
+            is_similarity_check = true;
+        }
+        else if (strcmp(argv[arg_i], "-record") == 0 && arg_i + 1 < argc) {
+            record_file_name = argv[++arg_i];
+        }
+        else if (strcmp(argv[arg_i], "-replay") == 0 && arg_i + 1 < argc) {
+            replay_file_name = argv[++arg_i];
+        }
+        else if (strcmp(argv[arg_i], "-paced") == 0) {
+            is_paced = true;
+        }
+        else if (strcmp(argv[arg_i], "-q") == 0 || strcmp(argv[arg_i], "-quiet") == 0) {
+            AkinatorIoSetSpeech(false);
+        }
+        else if (strcmp(argv[arg_i], "-j") == 0 || strcmp(argv[arg_i], "-json") == 0) {
+            is_json = true;
+        }
+        else if ((strcmp(argv[arg_i], "-d") == 0 || strcmp(argv[arg_i], "-diff") == 0) && arg_i + 1 < argc) {
+            strncpy(diff_file_name, argv[++arg_i], MAX_FILE_NAME_LEN);
+        }
+        else if (strcmp(argv[arg_i], "-merge") == 0 && arg_i + 4 < argc) {
+            for (size_t file_i = 0; file_i < 4; file_i++) {
+                merge_file_names[file_i] = argv[++arg_i];
+            }
         }
+        else if (strcmp(argv[arg_i], "-gen") == 0 && arg_i + 4 < argc) {
+            for (size_t gen_arg_i = 0; gen_arg_i < 4; gen_arg_i++) {
+                gen_args[gen_arg_i] = argv[++arg_i];
+            }
+        }
+        else if (strcmp(argv[arg_i], "-bench") == 0 && arg_i + 4 < argc) {
+            for (size_t bench_arg_i = 0; bench_arg_i < 4; bench_arg_i++) {
+                bench_args[bench_arg_i] = argv[++arg_i];
+            }
+        }
+        else if ((strcmp(argv[arg_i], "-c") == 0 || strcmp(argv[arg_i], "-convert") == 0) && arg_i + 1 < argc) {
+            strncpy(convert_file_name, argv[++arg_i], MAX_FILE_NAME_LEN);
+        }
+        else if ((strcmp(argv[arg_i], "-m") == 0 || strcmp(argv[arg_i], "-metrics") == 0) && arg_i + 1 < argc) {
+            strncpy(metrics_file_name, argv[++arg_i], MAX_FILE_NAME_LEN);
+        }
+        else if ((strcmp(argv[arg_i], "-t") == 0 || strcmp(argv[arg_i], "-trace") == 0) && arg_i + 1 < argc) {
+            strncpy(trace_file_name, argv[++arg_i], MAX_FILE_NAME_LEN);
+        }
+    }
+
+    if (record_file_name != NULL || replay_file_name != NULL) {
+        AkinatorError session_err = (replay_file_name != NULL) ? AkinatorIoReplayStart(replay_file_name, is_paced)
+                                                                : AkinatorIoRecordStart(record_file_name);
+        if (session_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(session_err);
+            return AkinatorReportsDump(metrics_file_name, trace_file_name, session_err);
+        }
+    }
+
+    if (merge_file_names[0] != NULL) {
+        AkinatorError merge_err = AkinatorAppMerge(merge_file_names);
+        if (merge_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(merge_err);
+        }
+
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, merge_err);
     }
 
-    AkinatorError init_error = AkinatorTreeInit(&akinator_tree);
-    if (init_error != AKINATOR_OK) {
-        AKINATOR_PRINT_ERROR(init_error);
-        TREE_DUMP(&akinator_tree);
-        return init_error;
+    if (gen_args[0] != NULL || bench_args[0] != NULL) {
+        AkinatorError bench_err = (gen_args[0] != NULL) ? AkinatorAppGenerate(gen_args) : AKINATOR_OK;
+
+        if (bench_err == AKINATOR_OK && bench_args[0] != NULL) {
+            bench_err = AkinatorAppBench(bench_args);
+        }
+
+        if (bench_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(bench_err);
+        }
+
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, bench_err);
     }
 
-    AkinatorError load_err = AkinatorTreeLoad(&akinator_tree, is_fast_load, database_file_name);
+    bool is_whole_tree_mode = is_stats || eval_error_rate != NULL || similarity_args[0] != NULL
+                              || strlen(diff_file_name) != 0 || strlen(convert_file_name) != 0 || strlen(embed_file_name) != 0;
+
+    if (!is_embedded) {
+        AkinatorError init_error = AkinatorTreeInit(&akinator);
+        if (init_error != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(init_error);
+            TREE_DUMP(&akinator.tree);
+            return AkinatorReportsDump(metrics_file_name, trace_file_name, init_error);
+        }
+    }
+
+    AkinatorError load_err = is_embedded ? AkinatorEmbeddedLoad(&akinator)
+                                         : AkinatorTreeLoad(&akinator, is_fast_load, is_lazy && !is_whole_tree_mode, database_file_name);
     if (load_err != AKINATOR_OK) {
-        AKINATOR_PRINT_ERROR(init_error);
-        TREE_DUMP(&akinator_tree);
-        return load_err;
+        AKINATOR_PRINT_ERROR(load_err);
+        TREE_DUMP(&akinator.tree);
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, load_err);
     }
 
-    TREE_DUMP(&akinator_tree);
+    if (is_stats) {
+        AkinatorStats stats = {};
+        AkinatorError stats_err = AkinatorStatsCollect(&akinator, &stats);
+
+        if (stats_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(stats_err);
+        }
+        else if (is_json) {
+            AkinatorStatsPrintJson(&stats, stdout);
+        }
+        else {
+            AkinatorStatsPrint(&stats, stdout);
+        }
+
+        AkinatorStatsDestroy(&stats);
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, stats_err);
+    }
+
+    if (eval_error_rate != NULL) {
+        AkinatorError eval_err = AkinatorAppEval(&akinator, eval_error_rate);
+        if (eval_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(eval_err);
+        }
+
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, eval_err);
+    }
+
+    if (similarity_args[0] != NULL) {
+        AkinatorError similarity_err = AkinatorAppSimilarity(&akinator, similarity_args, is_similarity_check);
+        if (similarity_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(similarity_err);
+        }
+
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, similarity_err);
+    }
+
+    if (strlen(diff_file_name) != 0) {
+        AkinatorError diff_err = AkinatorAppDiff(&akinator, diff_file_name);
+        if (diff_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(diff_err);
+        }
+
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, diff_err);
+    }
+
+    if (strlen(convert_file_name) != 0) {
+        AkinatorError convert_err = AkinatorTreeSaveFile(&akinator, convert_file_name);
+        if (convert_err == AKINATOR_OK) {
+            convert_err = AkinatorAppConvertReport(database_file_name, convert_file_name);
+        }
+
+        if (convert_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(convert_err);
+        }
+
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, convert_err);
+    }
+
+    if (strlen(embed_file_name) != 0) {
+        const char* source_name = is_embedded ? akinator_embedded_source_name : database_file_name;
+
+        AkinatorError embed_err = AkinatorEmbeddedGenerate(&akinator, source_name, embed_file_name);
+        if (embed_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(embed_err);
+        }
+
+        AkinatorTreeDestroy(&akinator);
+        return AkinatorReportsDump(metrics_file_name, trace_file_name, embed_err);
+    }
+
+    if (!is_embedded) {
+        TREE_DUMP(&akinator.tree);
+    }
+
+    AkinatorReloader reloader = {};
+    AkinatorReloaderInit(&reloader, database_file_name);
+
+    if (is_watch) {
+        AkinatorError watch_err = AkinatorReloaderWatch(&reloader);
+        if (watch_err != AKINATOR_OK) {
+            AKINATOR_PRINT_ERROR(watch_err);
+        }
+    }
 
     bool run = true;
+    bool is_input_closed = false;
 
     while (run) {
         AkinatorPrintf("Что вы хотите сделать?\n");
@@ -43,11 +506,20 @@ AkinatorError AkinatorApp(int argc, const char** argv) {
         AkinatorPrintf("4) Сохранить\n");
         AkinatorPrintf("5) Загрузить\n");
         AkinatorPrintf("6) Выйти\n");
+        AkinatorPrintf("7) Показать метрики\n");
+        AkinatorPrintf("8) Отменить обучение\n");
+        AkinatorPrintf("9) Повторить обучение\n");
+        AkinatorPrintf("10) Сохранить снимок\n");
+        AkinatorPrintf("11) Вернуться к снимку\n");
 
 
         int mode_num = 0;
-        scanf("%d", &mode_num);
-        CleanBuffer();
+        if (!TRACE_CALL("input", TRACE_WAIT, AkinatorIoReadInt(&mode_num))) {
+            is_input_closed = true;
+            break;
+        }
+
+        AkinatorAppPollReload(&reloader, &akinator);
 
         AkinatorAppMode mode = (AkinatorAppMode)(mode_num - 1);
 
@@ -55,38 +527,70 @@ AkinatorError AkinatorApp(int argc, const char** argv) {
 
         switch (mode) {
             case PLAY: 
-                mode_error = AkinatorRequest(&akinator_tree);
+                mode_error = AkinatorRequest(&akinator);
                 break;
             case FIND:
-                mode_error = AkinatorFind(&akinator_tree);
+                mode_error = AkinatorFind(&akinator);
                 break;
             case COMPARE:
-                mode_error = AkinatorCompare(&akinator_tree);
+                mode_error = AkinatorCompare(&akinator);
                 break;
             case SAVE:
-                mode_error = AkinatorTreeSave(&akinator_tree);
+                mode_error = AkinatorTreeSave(&akinator);
                 break;
             case LOAD:
-                mode_error = AkinatorTreeLoad(&akinator_tree, false, NULL);
+                AkinatorAskDatabaseFileName(database_file_name);
+                mode_error = AkinatorReloaderRequest(&reloader, database_file_name, true);
+                if (mode_error == AKINATOR_OK && is_watch) {
+                    mode_error = AkinatorReloaderWatch(&reloader);
+                }
+                AkinatorPrintf("База данных загружается в фоне\n");
+                if (mode_error == AKINATOR_OK && AkinatorIoGetMode() != AKINATOR_IO_LIVE) {
+                    AkinatorReloaderWait(&reloader);
+                    AkinatorAppPollReload(&reloader, &akinator);
+                }
                 break;
             case QUIT:
                 run = false;
                 break;
+            case METRICS: {
+                MetricsReport metrics_report = {};
+                MetricsCollect(&metrics_report);
+                MetricsPrint(&metrics_report, stdout);
+                break;
+            }
+            case UNDO:
+                mode_error = AkinatorUndo(&akinator);
+                break;
+            case REDO:
+                mode_error = AkinatorRedo(&akinator);
+                break;
+            case SNAPSHOT:
+                mode_error = AkinatorSnapshotSave(&akinator);
+                break;
+            case RESTORE:
+                mode_error = AkinatorSnapshotRestore(&akinator);
+                break;
             default:
                 AkinatorPrintf("Неправильная команда\n");
                 break;
         }
 
         if (mode_error != AKINATOR_OK) {
-            AkinatorTreeDestroy(&akinator_tree);
-            return mode_error;
+            AkinatorReloaderDestroy(&reloader);
+            AkinatorTreeDestroy(&akinator);
+            return AkinatorReportsDump(metrics_file_name, trace_file_name, mode_error);
         }
     }
 
-    AkinatorTreeSave(&akinator_tree);
+    AkinatorReloaderDestroy(&reloader);
+
+    if (!is_input_closed) {
+        AkinatorTreeSave(&akinator);
+    }
 
-    AkinatorTreeDestroy(&akinator_tree);
+    AkinatorTreeDestroy(&akinator);
 
-    return AKINATOR_OK;
+    return AkinatorReportsDump(metrics_file_name, trace_file_name, AKINATOR_OK);
 }
 
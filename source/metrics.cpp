@@ -0,0 +1,264 @@
+#include "metrics.hpp"
+
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+
+static const uint64_t METRICS_NS_PER_SEC = 1000000000;
+static const double METRICS_NS_PER_MS = 1e6;
+
+static std::atomic<MetricsThread*> metrics_threads(NULL);
+static thread_local MetricsThread* metrics_current_thread = NULL;
+
+const char* MetricsStrError(MetricsError error) {
+    switch (error) {
+        case METRICS_OK:
+            return "Выполнено без ошибок";
+        case METRICS_FILE_OPEN_ERROR:
+            return "Ошибка при создании файла метрик";
+        default:
+            return "Непредвиденная ошибка";
+    }
+}
+
+void MetricsPrintError(MetricsError error, const char* file, int line) {
+    assert(file != NULL);
+    assert(line > 0);
+
+    fprintf(stderr, "Error in %s:%d:\n%s\n", file, line, MetricsStrError(error));
+}
+
+const char* MetricsStrOperation(MetricsOperation operation) {
+    switch (operation) {
+        case METRICS_LOAD:
+            return "load";
+        case METRICS_SAVE:
+            return "save";
+        case METRICS_FIND:
+            return "find";
+        case METRICS_COMPARE:
+            return "compare";
+        case METRICS_QUESTION:
+            return "question";
+        case METRICS_DUMP:
+            return "dump";
+        case METRICS_SPEECH:
+            return "speech";
+        case METRICS_OPERATION_COUNT:
+        default:
+            return "unknown";
+    }
+}
+
+uint64_t MetricsNow() {
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * METRICS_NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+static size_t MetricsBucketIndex(uint64_t value) {
+    if (value < METRICS_SUB_BUCKET_COUNT) {
+        return value;
+    }
+
+    size_t exponent = 63 - (size_t)__builtin_clzll(value);
+    size_t shift = exponent - METRICS_SUB_BUCKET_BITS;
+    size_t mantissa = (value >> shift) & (METRICS_SUB_BUCKET_COUNT - 1);
+
+    return (shift + 1) * METRICS_SUB_BUCKET_COUNT + mantissa;
+}
+
+/// Середина корзины: оценка значения с относительной ошибкой не больше половины ширины корзины
+static uint64_t MetricsBucketValue(size_t index) {
+    if (index < METRICS_SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    size_t shift = index / METRICS_SUB_BUCKET_COUNT - 1;
+    uint64_t mantissa = index % METRICS_SUB_BUCKET_COUNT;
+
+    uint64_t lower = (METRICS_SUB_BUCKET_COUNT + mantissa) << shift;
+
+    return lower + (((uint64_t)1 << shift) >> 1);
+}
+
+static MetricsThread* MetricsGetThread() {
+    if (metrics_current_thread != NULL) {
+        return metrics_current_thread;
+    }
+
+    MetricsThread* thread = new (std::nothrow) MetricsThread{};
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    thread->next = metrics_threads.load();
+    while (!metrics_threads.compare_exchange_weak(thread->next, thread)) {}
+
+    metrics_current_thread = thread;
+
+    return thread;
+}
+
+static void MetricsRelaxedAdd(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void MetricsRecord(MetricsOperation operation, uint64_t duration_ns) {
+    assert(operation < METRICS_OPERATION_COUNT);
+
+    MetricsThread* thread = MetricsGetThread();
+    if (thread == NULL) {
+        return;
+    }
+
+    MetricsHistogram* histogram = &thread->histograms[operation];
+
+    MetricsRelaxedAdd(&histogram->buckets[MetricsBucketIndex(duration_ns)], 1);
+    MetricsRelaxedAdd(&histogram->count, 1);
+    MetricsRelaxedAdd(&histogram->sum_ns, duration_ns);
+
+    if (duration_ns > histogram->max_ns.load(std::memory_order_relaxed)) {
+        histogram->max_ns.store(duration_ns, std::memory_order_relaxed);
+    }
+}
+
+static uint64_t MetricsPercentile(const uint64_t* buckets, uint64_t count, uint64_t max_ns, double percentile) {
+    assert(buckets != NULL);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile * (double)count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+
+    uint64_t seen = 0;
+    for (size_t bucket_i = 0; bucket_i < METRICS_BUCKET_COUNT; bucket_i++) {
+        seen += buckets[bucket_i];
+        if (seen > rank) {
+            uint64_t value = MetricsBucketValue(bucket_i);
+            return (value < max_ns) ? value : max_ns;
+        }
+    }
+
+    return max_ns;
+}
+
+void MetricsCollect(MetricsReport* report) {
+    assert(report != NULL);
+
+    memset(report, 0, sizeof(*report));
+
+    for (MetricsThread* thread = metrics_threads.load(); thread != NULL; thread = thread->next) {
+        report->thread_count++;
+    }
+
+    for (size_t operation_i = 0; operation_i < METRICS_OPERATION_COUNT; operation_i++) {
+        MetricsSummary* summary = &report->operations[operation_i];
+        uint64_t buckets[METRICS_BUCKET_COUNT] = {};
+        uint64_t sum_ns = 0;
+
+        for (MetricsThread* thread = metrics_threads.load(); thread != NULL; thread = thread->next) {
+            MetricsHistogram* histogram = &thread->histograms[operation_i];
+
+            for (size_t bucket_i = 0; bucket_i < METRICS_BUCKET_COUNT; bucket_i++) {
+                buckets[bucket_i] += histogram->buckets[bucket_i].load(std::memory_order_relaxed);
+            }
+
+            summary->count += histogram->count.load(std::memory_order_relaxed);
+            sum_ns += histogram->sum_ns.load(std::memory_order_relaxed);
+
+            uint64_t max_ns = histogram->max_ns.load(std::memory_order_relaxed);
+            if (max_ns > summary->max_ns) {
+                summary->max_ns = max_ns;
+            }
+        }
+
+        if (summary->count == 0) {
+            continue;
+        }
+
+        summary->mean_ns = sum_ns / summary->count;
+
+        summary->p50_ns  = MetricsPercentile(buckets, summary->count, summary->max_ns, 0.5);
+        summary->p99_ns  = MetricsPercentile(buckets, summary->count, summary->max_ns, 0.99);
+        summary->p999_ns = MetricsPercentile(buckets, summary->count, summary->max_ns, 0.999);
+    }
+}
+
+void MetricsPrint(const MetricsReport* report, FILE* stream) {
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "операция      число   среднее мс       p50 мс       p99 мс      p999 мс      макс мс\n");
+
+    for (size_t operation_i = 0; operation_i < METRICS_OPERATION_COUNT; operation_i++) {
+        const MetricsSummary* summary = &report->operations[operation_i];
+
+        fprintf(stream, "%-10s %8lu %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+                MetricsStrOperation((MetricsOperation)operation_i), summary->count,
+                (double)summary->mean_ns / METRICS_NS_PER_MS,
+                (double)summary->p50_ns  / METRICS_NS_PER_MS,
+                (double)summary->p99_ns  / METRICS_NS_PER_MS,
+                (double)summary->p999_ns / METRICS_NS_PER_MS,
+                (double)summary->max_ns  / METRICS_NS_PER_MS);
+    }
+}
+
+void MetricsPrintJson(const MetricsReport* report, FILE* stream) {
+    assert(report != NULL);
+    assert(stream != NULL);
+
+    fprintf(stream, "{\"threads\":%lu,\"operations\":{", report->thread_count);
+
+    for (size_t operation_i = 0; operation_i < METRICS_OPERATION_COUNT; operation_i++) {
+        const MetricsSummary* summary = &report->operations[operation_i];
+
+        fprintf(stream, "%s\"%s\":{\"count\":%lu,\"mean_ns\":%lu,\"p50_ns\":%lu,\"p99_ns\":%lu,\"p999_ns\":%lu,\"max_ns\":%lu}",
+                (operation_i == 0) ? "" : ",", MetricsStrOperation((MetricsOperation)operation_i),
+                summary->count, summary->mean_ns, summary->p50_ns, summary->p99_ns, summary->p999_ns, summary->max_ns);
+    }
+
+    fprintf(stream, "}}\n");
+}
+
+MetricsError MetricsDump(const char* file_name) {
+    assert(file_name != NULL);
+
+    FILE* metrics_file = fopen(file_name, "w");
+    if (metrics_file == NULL) {
+        return METRICS_FILE_OPEN_ERROR;
+    }
+
+    MetricsReport report = {};
+    MetricsCollect(&report);
+
+    const char* extension = strrchr(file_name, '.');
+    if (extension != NULL && strcmp(extension, ".json") == 0) {
+        MetricsPrintJson(&report, metrics_file);
+    }
+    else {
+        MetricsPrint(&report, metrics_file);
+    }
+
+    fclose(metrics_file);
+
+    return METRICS_OK;
+}
+
+void MetricsDestroy() {
+    MetricsThread* thread = metrics_threads.exchange(NULL);
+
+    while (thread != NULL) {
+        MetricsThread* next = thread->next;
+        delete thread;
+        thread = next;
+    }
+
+    metrics_current_thread = NULL;
+}
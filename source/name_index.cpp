@@ -0,0 +1,433 @@
+#include "name_index.hpp"
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "utils.hpp"
+
+static const uint64_t NAME_INDEX_HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+static const uint32_t NAME_INDEX_SPACE = ' ';
+
+const char* NameIndexStrError(NameIndexError error) {
+    switch (error) {
+        case NAME_INDEX_OK:
+            return "Выполнено без ошибок";
+        case NAME_INDEX_ALLOC_ERROR:
+            return "Не удалось выделить память под индекс имен";
+        default:
+            return "Непредвиденная ошибка";
+    }
+}
+
+void NameIndexPrintError(NameIndexError error, const char* file, int line) {
+    assert(file != NULL);
+    assert(line > 0);
+
+    fprintf(stderr, "Error in %s:%d:\n%s\n", file, line, NameIndexStrError(error));
+}
+
+static uint32_t NameIndexDecodeUtf8(const unsigned char** str) {
+    assert(str != NULL);
+
+    const unsigned char* s = *str;
+    uint32_t codepoint = 0;
+    size_t extra = 0;
+
+    if (s[0] < 0x80) {
+        codepoint = s[0];
+    }
+    else if ((s[0] & 0xE0) == 0xC0) {
+        codepoint = s[0] & 0x1F;
+        extra = 1;
+    }
+    else if ((s[0] & 0xF0) == 0xE0) {
+        codepoint = s[0] & 0x0F;
+        extra = 2;
+    }
+    else {
+        codepoint = s[0] & 0x07;
+        extra = 3;
+    }
+    s++;
+
+    for (size_t i = 0; i < extra && (*s & 0xC0) == 0x80; i++, s++) {
+        codepoint = (codepoint << 6) | (*s & 0x3F);
+    }
+
+    *str = s;
+
+    return codepoint;
+}
+
+static uint32_t NameIndexNormalize(uint32_t codepoint) {
+    if ('A' <= codepoint && codepoint <= 'Z') {
+        return codepoint + ('a' - 'A');
+    }
+
+    if (('a' <= codepoint && codepoint <= 'z') || ('0' <= codepoint && codepoint <= '9')) {
+        return codepoint;
+    }
+
+    if (0x0410 <= codepoint && codepoint <= 0x042F) { // А-Я
+        return codepoint + 0x20;
+    }
+
+    if (codepoint == 0x0401 || codepoint == 0x0451) { // Ё, ё
+        return 0x0435;
+    }
+
+    if (0x0430 <= codepoint && codepoint <= 0x044F) {
+        return codepoint;
+    }
+
+    return codepoint < 0x80 ? NAME_INDEX_SPACE : codepoint;
+}
+
+static int NameIndexTrigramCmp(const void* a, const void* b) {
+    name_trigram_t lhs = *(const name_trigram_t*)a;
+    name_trigram_t rhs = *(const name_trigram_t*)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+/// Раскладывает строку на уникальные триграммы с дополнением пробелами по краям, как в pg_trgm
+static size_t NameIndexGetTrigrams(const char* str, name_trigram_t* trigrams) {
+    assert(str != NULL);
+    assert(trigrams != NULL);
+
+    uint32_t window[3] = {NAME_INDEX_SPACE, NAME_INDEX_SPACE, NAME_INDEX_SPACE};
+    size_t trigram_count = 0;
+    bool prev_space = true;
+
+    const unsigned char* s = (const unsigned char*)str;
+    while (true) {
+        uint32_t codepoint = (*s == '\0') ? NAME_INDEX_SPACE : NameIndexNormalize(NameIndexDecodeUtf8(&s));
+
+        bool is_space = codepoint == NAME_INDEX_SPACE;
+        if (!(is_space && prev_space)) {
+            window[0] = window[1];
+            window[1] = window[2];
+            window[2] = codepoint;
+
+            if (trigram_count < NAME_INDEX_MAX_TRIGRAMS) {
+                trigrams[trigram_count++] = ((name_trigram_t)window[0] << 42) | ((name_trigram_t)window[1] << 21) | window[2];
+            }
+        }
+        prev_space = is_space;
+
+        if (*s == '\0' && is_space) {
+            break;
+        }
+    }
+
+    qsort(trigrams, trigram_count, sizeof(name_trigram_t), NameIndexTrigramCmp);
+
+    size_t unique_count = 0;
+    for (size_t i = 0; i < trigram_count; i++) {
+        if (unique_count == 0 || trigrams[unique_count - 1] != trigrams[i]) {
+            trigrams[unique_count++] = trigrams[i];
+        }
+    }
+
+    return unique_count;
+}
+
+static size_t NameIndexSlot(const NameIndexPosting* table, size_t capacity, name_trigram_t trigram) {
+    assert(table != NULL);
+
+    size_t slot = ((trigram * NAME_INDEX_HASH_MULTIPLIER) >> 32) & (capacity - 1);
+
+    while (table[slot].ids != NULL && table[slot].trigram != trigram) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    return slot;
+}
+
+static NameIndexError NameIndexTableGrow(NameIndex* index) {
+    assert(index != NULL);
+
+    size_t new_capacity = 2 * index->table_capacity;
+    NameIndexPosting* new_table = (NameIndexPosting*)calloc(new_capacity, sizeof(NameIndexPosting));
+    if (new_table == NULL) {
+        return NAME_INDEX_ALLOC_ERROR;
+    }
+
+    for (size_t i = 0; i < index->table_capacity; i++) {
+        if (index->table[i].ids != NULL) {
+            new_table[NameIndexSlot(new_table, new_capacity, index->table[i].trigram)] = index->table[i];
+        }
+    }
+
+    free(index->table);
+    index->table = new_table;
+    index->table_capacity = new_capacity;
+
+    return NAME_INDEX_OK;
+}
+
+static NameIndexError NameIndexPostingAdd(NameIndex* index, name_trigram_t trigram, size_t id) {
+    assert(index != NULL);
+
+    if (2 * (index->table_size + 1) > index->table_capacity) {
+        NameIndexError grow_err = NameIndexTableGrow(index);
+        if (grow_err != NAME_INDEX_OK) {
+            return grow_err;
+        }
+    }
+
+    NameIndexPosting* posting = &index->table[NameIndexSlot(index->table, index->table_capacity, trigram)];
+
+    if (posting->ids == NULL) {
+        posting->ids = (size_t*)calloc(NAME_INDEX_START_POSTING_CAPACITY, sizeof(size_t));
+        if (posting->ids == NULL) {
+            return NAME_INDEX_ALLOC_ERROR;
+        }
+
+        posting->trigram = trigram;
+        posting->size = 0;
+        posting->capacity = NAME_INDEX_START_POSTING_CAPACITY;
+        index->table_size++;
+    }
+
+    if (posting->size == posting->capacity) {
+        size_t* new_ids = (size_t*)realloc(posting->ids, 2 * posting->capacity * sizeof(size_t));
+        if (new_ids == NULL) {
+            return NAME_INDEX_ALLOC_ERROR;
+        }
+
+        posting->ids = new_ids;
+        posting->capacity *= 2;
+    }
+
+    posting->ids[posting->size++] = id;
+
+    return NAME_INDEX_OK;
+}
+
+static NameIndexError NameIndexEntriesGrow(NameIndex* index) {
+    assert(index != NULL);
+
+    size_t new_capacity = 2 * index->entries_capacity;
+
+    NameIndexEntry* new_entries = (NameIndexEntry*)realloc(index->entries, new_capacity * sizeof(NameIndexEntry));
+    if (new_entries == NULL) {
+        return NAME_INDEX_ALLOC_ERROR;
+    }
+    index->entries = new_entries;
+
+    unsigned* new_scores = (unsigned*)calloc(new_capacity, sizeof(unsigned));
+    size_t* new_touched = (size_t*)calloc(new_capacity, sizeof(size_t));
+    if (new_scores == NULL || new_touched == NULL) {
+        free(new_scores);
+        free(new_touched);
+        return NAME_INDEX_ALLOC_ERROR;
+    }
+
+    PROTECTED_FREE(index->scratch_scores);
+    PROTECTED_FREE(index->scratch_touched);
+    index->scratch_scores = new_scores;
+    index->scratch_touched = new_touched;
+
+    index->entries_capacity = new_capacity;
+
+    return NAME_INDEX_OK;
+}
+
+NameIndexError NameIndexInit(NameIndex* index) {
+    assert(index != NULL);
+
+    index->entries = (NameIndexEntry*)calloc(NAME_INDEX_START_ENTRIES_CAPACITY, sizeof(NameIndexEntry));
+    index->scratch_scores = (unsigned*)calloc(NAME_INDEX_START_ENTRIES_CAPACITY, sizeof(unsigned));
+    index->scratch_touched = (size_t*)calloc(NAME_INDEX_START_ENTRIES_CAPACITY, sizeof(size_t));
+    index->table = (NameIndexPosting*)calloc(NAME_INDEX_START_TABLE_CAPACITY, sizeof(NameIndexPosting));
+
+    index->entries_size = 0;
+    index->entries_capacity = NAME_INDEX_START_ENTRIES_CAPACITY;
+    index->table_size = 0;
+    index->table_capacity = NAME_INDEX_START_TABLE_CAPACITY;
+
+    if (index->entries == NULL || index->scratch_scores == NULL || index->scratch_touched == NULL || index->table == NULL) {
+        NameIndexDestroy(index);
+        return NAME_INDEX_ALLOC_ERROR;
+    }
+
+    return NAME_INDEX_OK;
+}
+
+NameIndexError NameIndexDestroy(NameIndex* index) {
+    assert(index != NULL);
+
+    if (index->table != NULL) {
+        for (size_t i = 0; i < index->table_capacity; i++) {
+            PROTECTED_FREE(index->table[i].ids);
+        }
+    }
+
+    PROTECTED_FREE(index->table);
+    PROTECTED_FREE(index->entries);
+    PROTECTED_FREE(index->scratch_scores);
+    PROTECTED_FREE(index->scratch_touched);
+
+    index->entries_size = 0;
+    index->entries_capacity = 0;
+    index->table_size = 0;
+    index->table_capacity = 0;
+
+    return NAME_INDEX_OK;
+}
+
+NameIndexError NameIndexBuild(NameIndex* index, TreeNode* node) {
+    assert(index != NULL);
+
+    for (TreeNode* loc_node = node; loc_node != NULL; loc_node = TreeNodeNextPreorder(loc_node, node)) {
+        if (TreeNodeGetLeft(loc_node) != NULL || TreeNodeGetRight(loc_node) != NULL) {
+            continue;
+        }
+
+        NameIndexError add_err = NameIndexAdd(index, loc_node);
+        if (add_err != NAME_INDEX_OK) {
+            return add_err;
+        }
+    }
+
+    return NAME_INDEX_OK;
+}
+
+NameIndexError NameIndexAdd(NameIndex* index, TreeNode* leaf) {
+    assert(index != NULL);
+    assert(leaf != NULL);
+
+    if (index->entries_size == index->entries_capacity) {
+        NameIndexError grow_err = NameIndexEntriesGrow(index);
+        if (grow_err != NAME_INDEX_OK) {
+            return grow_err;
+        }
+    }
+
+    name_trigram_t trigrams[NAME_INDEX_MAX_TRIGRAMS] = {};
+    size_t trigram_count = NameIndexGetTrigrams(TreeNodeGetValue(leaf), trigrams);
+
+    size_t id = index->entries_size++;
+    index->entries[id].leaf = leaf;
+    index->entries[id].trigram_count = trigram_count;
+    index->entries[id].is_removed = false;
+
+    for (size_t i = 0; i < trigram_count; i++) {
+        NameIndexError posting_err = NameIndexPostingAdd(index, trigrams[i], id);
+        if (posting_err != NAME_INDEX_OK) {
+            return posting_err;
+        }
+    }
+
+    return NAME_INDEX_OK;
+}
+
+NameIndexError NameIndexRemove(NameIndex* index, TreeNode* leaf) {
+    assert(index != NULL);
+    assert(leaf != NULL);
+
+    for (size_t id = index->entries_size; id > 0; id--) {
+        if (index->entries[id - 1].leaf == leaf && !index->entries[id - 1].is_removed) {
+            index->entries[id - 1].is_removed = true;
+            break;
+        }
+    }
+
+    return NAME_INDEX_OK;
+}
+
+static bool NameIndexIsEntryNamed(const NameIndex* index, size_t id, const char* name) {
+    assert(index != NULL);
+    assert(name != NULL);
+
+    return !index->entries[id].is_removed && strcmp(TreeNodeGetValue(index->entries[id].leaf), name) == 0;
+}
+
+TreeNode* NameIndexFind(NameIndex* index, const char* name) {
+    assert(index != NULL);
+    assert(name != NULL);
+
+    name_trigram_t trigrams[NAME_INDEX_MAX_TRIGRAMS] = {};
+    size_t trigram_count = NameIndexGetTrigrams(name, trigrams);
+
+    if (trigram_count == 0) {
+        for (size_t id = 0; id < index->entries_size; id++) {
+            if (NameIndexIsEntryNamed(index, id, name)) {
+                return index->entries[id].leaf;
+            }
+        }
+
+        return NULL;
+    }
+
+    NameIndexPosting* shortest = NULL;
+    for (size_t i = 0; i < trigram_count; i++) {
+        NameIndexPosting* posting = &index->table[NameIndexSlot(index->table, index->table_capacity, trigrams[i])];
+
+        if (shortest == NULL || posting->size < shortest->size) {
+            shortest = posting;
+        }
+    }
+
+    for (size_t i = 0; i < shortest->size; i++) {
+        if (NameIndexIsEntryNamed(index, shortest->ids[i], name)) {
+            return index->entries[shortest->ids[i]].leaf;
+        }
+    }
+
+    return NULL;
+}
+
+size_t NameIndexSearch(NameIndex* index, const char* query, NameIndexMatch* matches, size_t k) {
+    assert(index != NULL);
+    assert(query != NULL);
+    assert(matches != NULL);
+
+    name_trigram_t trigrams[NAME_INDEX_MAX_TRIGRAMS] = {};
+    size_t trigram_count = NameIndexGetTrigrams(query, trigrams);
+
+    size_t touched_count = 0;
+
+    for (size_t i = 0; i < trigram_count; i++) {
+        NameIndexPosting* posting = &index->table[NameIndexSlot(index->table, index->table_capacity, trigrams[i])];
+
+        for (size_t j = 0; j < posting->size; j++) {
+            size_t id = posting->ids[j];
+
+            if (index->scratch_scores[id]++ == 0) {
+                index->scratch_touched[touched_count++] = id;
+            }
+        }
+    }
+
+    size_t match_count = 0;
+
+    for (size_t i = 0; i < touched_count; i++) {
+        size_t id = index->scratch_touched[i];
+        unsigned shared = index->scratch_scores[id];
+        index->scratch_scores[id] = 0;
+
+        if (index->entries[id].is_removed) {
+            continue;
+        }
+
+        double score = 2.0 * shared / (double)(trigram_count + index->entries[id].trigram_count);
+
+        if (match_count == k && (k == 0 || score <= matches[k - 1].score)) {
+            continue;
+        }
+
+        size_t pos = (match_count < k) ? match_count++ : k - 1;
+        while (pos > 0 && matches[pos - 1].score < score) {
+            matches[pos] = matches[pos - 1];
+            pos--;
+        }
+
+        matches[pos].leaf = index->entries[id].leaf;
+        matches[pos].score = score;
+    }
+
+    return match_count;
+}
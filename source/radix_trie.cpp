@@ -0,0 +1,308 @@
+#include "radix_trie.hpp"
+
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+
+#include "utils.hpp"
+
+const char* RadixTrieStrError(RadixTrieError error) {
+    switch (error) {
+        case RADIX_TRIE_OK:
+            return "Выполнено без ошибок";
+        case RADIX_TRIE_ALLOC_ERROR:
+            return "Не удалось выделить память на вершину префиксного дерева";
+        default:
+            return "Непредвиденная ошибка";
+    }
+}
+
+void RadixTriePrintError(RadixTrieError error, const char* file, int line) {
+    assert(file != NULL);
+    assert(line > 0);
+
+    fprintf(stderr, "Error in %s:%d:\n%s\n", file, line, RadixTrieStrError(error));
+}
+
+static RadixTrieNode* RadixTrieNodeInit(RadixTrie* trie, const char* label, size_t label_len) {
+    assert(trie != NULL);
+    assert(label != NULL);
+
+    RadixTrieNode* node = (RadixTrieNode*)calloc(1, sizeof(RadixTrieNode) + label_len);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    memcpy(node->label, label, label_len);
+    node->label_len = label_len;
+
+    trie->node_count++;
+    trie->label_bytes += label_len;
+
+    return node;
+}
+
+static void RadixTrieSubTreeDestroy(RadixTrieNode* node) {
+    while (node != NULL) {
+        RadixTrieNode* next = node->next_sibling;
+
+        RadixTrieSubTreeDestroy(node->first_child);
+        free(node);
+
+        node = next;
+    }
+}
+
+static size_t RadixTrieCommonPrefix(const char* a, size_t a_len, const char* b) {
+    assert(a != NULL);
+    assert(b != NULL);
+
+    size_t common = 0;
+    while (common < a_len && b[common] != '\0' && a[common] == b[common]) {
+        common++;
+    }
+
+    return common;
+}
+
+/// Возвращает ссылку на место в отсортированном списке детей, где лежит или должен лежать ребенок на байт first
+static RadixTrieNode** RadixTrieFindChildLink(RadixTrieNode* node, char first) {
+    assert(node != NULL);
+
+    RadixTrieNode** link = &node->first_child;
+    while (*link != NULL && (unsigned char)(*link)->label[0] < (unsigned char)first) {
+        link = &(*link)->next_sibling;
+    }
+
+    return link;
+}
+
+static RadixTrieNode* RadixTrieFind(RadixTrie* trie, const char* key) {
+    assert(trie != NULL);
+    assert(key != NULL);
+
+    RadixTrieNode* node = trie->root;
+
+    while (*key != '\0') {
+        RadixTrieNode* child = *RadixTrieFindChildLink(node, *key);
+        if (child == NULL || child->label[0] != *key) {
+            return NULL;
+        }
+
+        size_t common = RadixTrieCommonPrefix(child->label, child->label_len, key);
+        if (common != child->label_len) {
+            return NULL;
+        }
+
+        node = child;
+        key += common;
+    }
+
+    return node;
+}
+
+RadixTrieError RadixTrieInit(RadixTrie* trie) {
+    assert(trie != NULL);
+
+    trie->key_count = 0;
+    trie->node_count = 0;
+    trie->label_bytes = 0;
+    trie->raw_bytes = 0;
+
+    trie->root = RadixTrieNodeInit(trie, "", 0);
+    if (trie->root == NULL) {
+        return RADIX_TRIE_ALLOC_ERROR;
+    }
+
+    return RADIX_TRIE_OK;
+}
+
+RadixTrieError RadixTrieDestroy(RadixTrie* trie) {
+    assert(trie != NULL);
+
+    RadixTrieSubTreeDestroy(trie->root);
+    trie->root = NULL;
+
+    trie->key_count = 0;
+    trie->node_count = 0;
+    trie->label_bytes = 0;
+    trie->raw_bytes = 0;
+
+    return RADIX_TRIE_OK;
+}
+
+RadixTrieError RadixTrieBuild(RadixTrie* trie, TreeNode* node) {
+    assert(trie != NULL);
+
+    for (TreeNode* loc_node = node; loc_node != NULL; loc_node = TreeNodeNextPreorder(loc_node, node)) {
+        RadixTrieError insert_err = RadixTrieInsert(trie, TreeNodeGetValue(loc_node));
+        if (insert_err != RADIX_TRIE_OK) {
+            return insert_err;
+        }
+    }
+
+    return RADIX_TRIE_OK;
+}
+
+RadixTrieError RadixTrieInsert(RadixTrie* trie, const char* key) {
+    assert(trie != NULL);
+    assert(key != NULL);
+
+    size_t key_len = strlen(key);
+    const char* rest = key;
+    RadixTrieNode* node = trie->root;
+
+    while (*rest != '\0') {
+        RadixTrieNode** link = RadixTrieFindChildLink(node, *rest);
+        RadixTrieNode* child = *link;
+
+        if (child == NULL || child->label[0] != *rest) {
+            RadixTrieNode* new_child = RadixTrieNodeInit(trie, rest, strlen(rest));
+            if (new_child == NULL) {
+                return RADIX_TRIE_ALLOC_ERROR;
+            }
+
+            new_child->next_sibling = child;
+            *link = new_child;
+
+            node = new_child;
+            break;
+        }
+
+        size_t common = RadixTrieCommonPrefix(child->label, child->label_len, rest);
+
+        if (common < child->label_len) {
+            RadixTrieNode* middle = RadixTrieNodeInit(trie, child->label, common);
+            if (middle == NULL) {
+                return RADIX_TRIE_ALLOC_ERROR;
+            }
+
+            middle->next_sibling = child->next_sibling;
+            middle->first_child = child;
+            *link = middle;
+
+            memmove(child->label, child->label + common, child->label_len - common);
+            child->label_len -= common;
+            child->next_sibling = NULL;
+
+            child = middle;
+        }
+
+        node = child;
+        rest += common;
+    }
+
+    if (node->count++ == 0) {
+        trie->key_count++;
+        trie->raw_bytes += key_len + 1;
+    }
+
+    return RADIX_TRIE_OK;
+}
+
+RadixTrieError RadixTrieRemove(RadixTrie* trie, const char* key) {
+    assert(trie != NULL);
+    assert(key != NULL);
+
+    RadixTrieNode* node = RadixTrieFind(trie, key);
+
+    if (node != NULL && node->count > 0 && --node->count == 0) {
+        trie->key_count--;
+        trie->raw_bytes -= strlen(key) + 1;
+    }
+
+    return RADIX_TRIE_OK;
+}
+
+size_t RadixTrieCount(RadixTrie* trie, const char* key) {
+    assert(trie != NULL);
+    assert(key != NULL);
+
+    RadixTrieNode* node = RadixTrieFind(trie, key);
+
+    return node == NULL ? 0 : node->count;
+}
+
+static void RadixTrieCollect(RadixTrieNode* node, char* buffer, size_t buffer_len,
+                             char (*completions)[1 + RADIX_TRIE_MAX_KEY_LEN], size_t limit, size_t* completion_count) {
+    assert(node != NULL);
+    assert(buffer != NULL);
+    assert(completion_count != NULL);
+
+    if (*completion_count == limit) {
+        return;
+    }
+
+    if (node->count > 0) {
+        memcpy(completions[*completion_count], buffer, buffer_len);
+        completions[*completion_count][buffer_len] = '\0';
+        (*completion_count)++;
+    }
+
+    for (RadixTrieNode* child = node->first_child; child != NULL; child = child->next_sibling) {
+        if (buffer_len + child->label_len > RADIX_TRIE_MAX_KEY_LEN) {
+            continue;
+        }
+
+        memcpy(buffer + buffer_len, child->label, child->label_len);
+        RadixTrieCollect(child, buffer, buffer_len + child->label_len, completions, limit, completion_count);
+    }
+}
+
+size_t RadixTrieComplete(RadixTrie* trie, const char* prefix, char (*completions)[1 + RADIX_TRIE_MAX_KEY_LEN], size_t limit) {
+    assert(trie != NULL);
+    assert(prefix != NULL);
+    assert(completions != NULL);
+
+    size_t prefix_len = strlen(prefix);
+    if (prefix_len > RADIX_TRIE_MAX_KEY_LEN) {
+        return 0;
+    }
+
+    char buffer[1 + RADIX_TRIE_MAX_KEY_LEN] = {};
+    size_t buffer_len = 0;
+
+    const char* rest = prefix;
+    RadixTrieNode* node = trie->root;
+
+    while (*rest != '\0') {
+        RadixTrieNode* child = *RadixTrieFindChildLink(node, *rest);
+        if (child == NULL || child->label[0] != *rest) {
+            return 0;
+        }
+
+        size_t common = RadixTrieCommonPrefix(child->label, child->label_len, rest);
+        if (common < child->label_len && rest[common] != '\0') {
+            return 0;
+        }
+
+        if (buffer_len + child->label_len > RADIX_TRIE_MAX_KEY_LEN) {
+            return 0;
+        }
+
+        memcpy(buffer + buffer_len, child->label, child->label_len);
+        buffer_len += child->label_len;
+
+        node = child;
+        rest += common;
+    }
+
+    size_t completion_count = 0;
+    RadixTrieCollect(node, buffer, buffer_len, completions, limit, &completion_count);
+
+    return completion_count;
+}
+
+RadixTrieMemoryStats RadixTrieGetMemoryStats(RadixTrie* trie) {
+    assert(trie != NULL);
+
+    RadixTrieMemoryStats stats = {};
+
+    stats.key_count = trie->key_count;
+    stats.node_count = trie->node_count;
+    stats.trie_bytes = trie->node_count * sizeof(RadixTrieNode) + trie->label_bytes;
+    stats.raw_bytes = trie->raw_bytes;
+    stats.overhead = (trie->raw_bytes == 0) ? 0 : (double)stats.trie_bytes / (double)trie->raw_bytes;
+
+    return stats;
+}
@@ -0,0 +1,129 @@
+#include "trace.hpp"
+
+#ifdef AKINATOR_TRACE
+
+#include <assert.h>
+#include <new>
+
+#include "metrics.hpp"
+
+static const double TRACE_NS_PER_US = 1e3;
+
+static std::atomic<TraceRing*> trace_rings(NULL);
+static std::atomic<size_t> trace_thread_count(0);
+static thread_local TraceRing* trace_current_ring = NULL;
+
+const char* TraceStrError(TraceError error) {
+    switch (error) {
+        case TRACE_OK:
+            return "Выполнено без ошибок";
+        case TRACE_FILE_OPEN_ERROR:
+            return "Ошибка при создании файла трассировки";
+        default:
+            return "Непредвиденная ошибка";
+    }
+}
+
+void TracePrintError(TraceError error, const char* file, int line) {
+    assert(file != NULL);
+    assert(line > 0);
+
+    fprintf(stderr, "Error in %s:%d:\n%s\n", file, line, TraceStrError(error));
+}
+
+static TraceRing* TraceGetRing() {
+    if (trace_current_ring != NULL) {
+        return trace_current_ring;
+    }
+
+    TraceRing* ring = new (std::nothrow) TraceRing{};
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->thread_id = ++trace_thread_count;
+
+    ring->next = trace_rings.load();
+    while (!trace_rings.compare_exchange_weak(ring->next, ring)) {}
+
+    trace_current_ring = ring;
+
+    return ring;
+}
+
+void TraceRecord(const char* name, const char* category, uint64_t start_ns) {
+    assert(name != NULL);
+    assert(category != NULL);
+
+    uint64_t end_ns = MetricsNow();
+
+    TraceRing* ring = TraceGetRing();
+    if (ring == NULL) {
+        return;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+    ring->events[head % TRACE_RING_CAPACITY] = {name, category, start_ns, end_ns - start_ns};
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+TraceScope::TraceScope(const char* name, const char* category) :
+    name_(name),
+    category_(category),
+    start_ns_(MetricsNow())
+{}
+
+TraceScope::~TraceScope() {
+    TraceRecord(name_, category_, start_ns_);
+}
+
+TraceError TraceFlush(const char* file_name) {
+    assert(file_name != NULL);
+
+    FILE* trace_file = fopen(file_name, "w");
+    if (trace_file == NULL) {
+        return TRACE_FILE_OPEN_ERROR;
+    }
+
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    bool is_first = true;
+
+    for (TraceRing* ring = trace_rings.load(); ring != NULL; ring = ring->next) {
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = (head > TRACE_RING_CAPACITY) ? head - TRACE_RING_CAPACITY : 0;
+
+        for (uint64_t event_i = tail; event_i < head; event_i++) {
+            const TraceEvent* event = &ring->events[event_i % TRACE_RING_CAPACITY];
+
+            fprintf(trace_file, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%lu}",
+                    is_first ? "" : ",", event->name, event->category,
+                    (double)event->start_ns / TRACE_NS_PER_US, (double)event->duration_ns / TRACE_NS_PER_US,
+                    ring->thread_id);
+
+            is_first = false;
+        }
+    }
+
+    fprintf(trace_file, "\n]}\n");
+
+    fclose(trace_file);
+
+    return TRACE_OK;
+}
+
+void TraceDestroy() {
+    TraceRing* ring = trace_rings.exchange(NULL);
+
+    while (ring != NULL) {
+        TraceRing* next = ring->next;
+        delete ring;
+        ring = next;
+    }
+
+    trace_current_ring = NULL;
+}
+
+#endif // AKINATOR_TRACE
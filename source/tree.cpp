@@ -6,6 +6,9 @@
 #include <errno.h>
 
 #include "dump_settings.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "tree_parallel.hpp"
 #include "utils.hpp"
 
 const char* TreeStrError(TreeError error) {
@@ -31,41 +34,47 @@ void TreePrintError(TreeError error, const char* file, int line) {
 }
 
 TreeNode* TreeNodeInit(const char* value) {
-    TreeNode* node = (TreeNode*)calloc(1, sizeof(TreeNode));
+    return TreeNodeInit(TreeString(value));
+}
 
-    if (node == NULL) {
-        return NULL;
-    }
+TreeNode* TreeNodeInit(TreeString&& value) {
+    std::allocator<TreeNode> allocator;
 
-    node->parent = NULL;
-    node->left = NULL;
-    node->right = NULL;
+    return TreeTNodeInit(allocator, std::move(value));
+}
 
-    if (value != ROOT_VALUE) {
-        node->value = (tree_elem_t)calloc(1, MAX_TREE_CHAR_SIZE);
-        strcpy(node->value, value);
-    }
-    else {
-        node->value = ROOT_VALUE;
-    }
+static TreeNode* tree_static_nodes = NULL;
+static size_t tree_static_node_count = 0;
+
+void TreeSetStaticNodes(TreeNode* nodes, size_t count) {
+    assert(nodes != NULL || count == 0);
 
-    return node;
+    tree_static_nodes = nodes;
+    tree_static_node_count = count;
 }
 
-TreeError TreeNodeDestroy(TreeNode** node) {
+static bool TreeNodeIsStatic(TreeNode* node) {
     assert(node != NULL);
 
-    TreeNode* loc_node = *node;
+    uintptr_t address = (uintptr_t)node;
+    uintptr_t static_begin = (uintptr_t)tree_static_nodes;
+    uintptr_t static_end = (uintptr_t)(tree_static_nodes + tree_static_node_count);
 
-    loc_node->parent = NULL;
-    loc_node->left = NULL;
-    loc_node->right = NULL;
+    return static_begin <= address && address < static_end;
+}
 
-    PROTECTED_FREE(loc_node->value);
+TreeError TreeNodeDestroy(TreeNode** node) {
+    assert(node != NULL);
+
+    if (*node != NULL && TreeNodeIsStatic(*node)) {
+        (*node)->value = TreeString();
+        *node = NULL;
+        return TREE_OK;
+    }
 
-    PROTECTED_FREE(loc_node);
+    std::allocator<TreeNode> allocator;
 
-    *node = loc_node;
+    TreeTNodeDestroy(allocator, node);
 
     return TREE_OK;
 }
@@ -85,15 +94,7 @@ TreeNode* TreeNodeGetLeft(TreeNode* node) {
 TreeError TreeNodeLinkLeft(TreeNode* node, TreeNode* new_left) {
     assert(node != NULL);
 
-    if (node->left != NULL) {
-        node->left->parent = NULL;
-    }
-
-    node->left = new_left;
-
-    if (new_left != NULL) {
-        new_left->parent = node;
-    }
+    TreeTNodeLinkLeft(node, new_left);
 
     return TREE_OK;
 }
@@ -104,18 +105,14 @@ TreeNode* TreeNodeGetRight(TreeNode* node) {
     return node->right;
 }
 
+TreeNode* TreeNodeNextPreorder(TreeNode* node, TreeNode* subtree_root) {
+    return TreeTNodeNextPreorder(node, subtree_root);
+}
+
 TreeError TreeNodeLinkRight(TreeNode* node, TreeNode* new_right) {
     assert(node != NULL);
 
-    if (node->right != NULL) {
-        node->right->parent = NULL;
-    }
-
-    node->right = new_right;
-
-    if (new_right != NULL) {
-        new_right->parent = node;
-    }
+    TreeTNodeLinkRight(node, new_right);
 
     return TREE_OK;
 }
@@ -123,21 +120,28 @@ TreeError TreeNodeLinkRight(TreeNode* node, TreeNode* new_right) {
 tree_elem_t TreeNodeGetValue(TreeNode* node) {
     assert(node != NULL);
 
-    return node->value;
+    return node->value.CStr();
 }
 
 
 TreeError TreeNodeSetValue(TreeNode* node, tree_elem_t new_value) {
     assert(node != NULL);
 
-    node->value = new_value;
+    if (new_value == ROOT_VALUE) {
+        node->value = TreeString();
+        return TREE_OK;
+    }
+
+    if (!node->value.Assign(new_value, strlen(new_value))) {
+        return TREE_NODE_ALLOC_ERROR;
+    }
 
     return TREE_OK;
 }
 
-static void TreeNodesBuildDump(FILE* build_dump_file, TreeNode* node) {
-    assert(build_dump_file != NULL);
+static void TreeNodeBuildDump(TreeNode* node, size_t, TreeParallelTask* task, void*) {
     assert(node != NULL);
+    assert(task != NULL);
 
     tree_elem_t value = TreeNodeGetValue(node);
 
@@ -148,24 +152,16 @@ static void TreeNodesBuildDump(FILE* build_dump_file, TreeNode* node) {
     TreeNode* right = TreeNodeGetRight(node);
 
     if (node->left == NULL && node->right == NULL) {
-        fprintf(build_dump_file, "    node_%p [label=\"value = %s\\nself = %p\\nparent = %p\\nleft = %p\\nright = %p\", color = \"%s\", penwidth = %lu];\n", node, value, node, parent, left, right, OBJECT_NODE_COLOR, OBJECT_NODE_PEN_WIDTH);
+        TreeParallelPrintf(task, "    node_%p [label=\"value = %s\\nself = %p\\nparent = %p\\nleft = %p\\nright = %p\", color = \"%s\", penwidth = %lu];\n", node, value, node, parent, left, right, OBJECT_NODE_COLOR, OBJECT_NODE_PEN_WIDTH);
     }
     else {
-        fprintf(build_dump_file, "    node_%p [label=\"value = %s\\nself = %p\\nparent = %p\\nleft = %p\\nright = %p\", color = \"%s\", penwidth = %lu];\n", node, value, node, parent, left, right, ATTRIBUTE_NODE_COLOR, ATTRIBUTE_NODE_PEN_WIDTH);
-    }
-
-    if (node->left != NULL) {
-        TreeNodesBuildDump(build_dump_file, node->left);
-    }
-
-    if (node->right != NULL) {
-        TreeNodesBuildDump(build_dump_file, node->right);
+        TreeParallelPrintf(task, "    node_%p [label=\"value = %s\\nself = %p\\nparent = %p\\nleft = %p\\nright = %p\", color = \"%s\", penwidth = %lu];\n", node, value, node, parent, left, right, ATTRIBUTE_NODE_COLOR, ATTRIBUTE_NODE_PEN_WIDTH);
     }
 }
 
-static void TreeEdgesBuildDump(FILE* build_dump_file, TreeNode* node) {
-    assert(build_dump_file != NULL);
+static void TreeEdgeBuildDump(TreeNode* node, size_t, TreeParallelTask* task, void*) {
     assert(node != NULL);
+    assert(task != NULL);
 
     TreeNode* parent = TreeNodeGetParent(node);
 
@@ -174,59 +170,77 @@ static void TreeEdgesBuildDump(FILE* build_dump_file, TreeNode* node) {
     TreeNode* right = TreeNodeGetRight(node);
 
     if (parent != NULL) {
-        fprintf(build_dump_file, "    node_%p -> node_%p [label = \"parent\", color = \"%s\"];\n", node, parent, PARENT_EDGE_COLOR);
+        TreeParallelPrintf(task, "    node_%p -> node_%p [label = \"parent\", color = \"%s\"];\n", node, parent, PARENT_EDGE_COLOR);
     }
 
     if (left != NULL) {
-        fprintf(build_dump_file, "    node_%p -> node_%p [label = \"left\", color = \"%s\"];\n", node, left, LEFT_EDGE_COLOR);
+        TreeParallelPrintf(task, "    node_%p -> node_%p [label = \"left\", color = \"%s\"];\n", node, left, LEFT_EDGE_COLOR);
     }
 
     if (right != NULL) {
-        fprintf(build_dump_file, "    node_%p -> node_%p [label = \"right\", color = \"%s\"];\n", node, right, RIGHT_EDGE_COLOR);
+        TreeParallelPrintf(task, "    node_%p -> node_%p [label = \"right\", color = \"%s\"];\n", node, right, RIGHT_EDGE_COLOR);
     }
+}
 
-    if (node->left != NULL) {
-        TreeEdgesBuildDump(build_dump_file, node->left);
-    }
+/// Счетчики разнесены по кэш-линиям, чтобы потоки не мешали друг другу
+struct alignas(64) TreeGraphCounter {
+    size_t edge_count;
+};
 
-    if (node->right != NULL) {
-        TreeEdgesBuildDump(build_dump_file, node->right);
-    }
-}
+struct TreeGraphCheck {
+    std::atomic<bool> is_ok;
 
-static bool IsTreeGraphOk(TreeNode* node, size_t* true_size) {
-    assert(true_size != NULL);
+    TreeGraphCounter counters[TREE_PARALLEL_MAX_THREADS];
+};
 
-    if (node == NULL) {
-        return true;
-    }
+static void TreeGraphCheckVisit(TreeNode* node, size_t, TreeParallelTask* task, void* context) {
+    assert(node != NULL);
+    assert(task != NULL);
+    assert(context != NULL);
+
+    TreeGraphCheck* check = (TreeGraphCheck*)context;
+
+    check->counters[task->worker_i].edge_count += (size_t)(node->left != NULL) + (size_t)(node->right != NULL);
 
-    *true_size += (node->left != NULL);
-    *true_size += (node->right != NULL);
-    
     bool is_node_left_ok = (node->left == NULL || node->left->parent == node);
     bool is_node_right_ok = (node->right == NULL || node->right->parent == node);
-    
-    bool is_node_ok = is_node_left_ok && is_node_right_ok;
+    bool is_children_distinct = (node->left == NULL || node->left != node->right);
 
-    return is_node_ok
-           && IsTreeGraphOk(node->left, true_size)
-           && IsTreeGraphOk(node->right, true_size);
+    if (!is_node_left_ok || !is_node_right_ok || !is_children_distinct) {
+        check->is_ok.store(false, std::memory_order_relaxed);
+    }
+}
+
+static void TreeNodeDestroyVisit(TreeNode* node, size_t, TreeParallelTask*, void*) {
+    TreeNodeDestroy(&node);
 }
 
 TreeError TreeVerefy(Tree* tree) {
     assert(tree != NULL);
 
-    size_t true_size = 0;
-
     if (tree->last_error != TREE_OK) {
         return tree->last_error;
     }
-    
-    if (!IsTreeGraphOk(tree->root, &true_size)) {
+
+    TreeGraphCheck check = {};
+    check.is_ok = true;
+
+    TreeParallelVisitor visitor = {TreeGraphCheckVisit, NULL, &check};
+
+    TreeError walk_err = TreeParallelWalk(tree->root, &visitor, NULL);
+    if (walk_err != TREE_OK) {
+        return tree->last_error = walk_err;
+    }
+
+    if (!check.is_ok) {
         return tree->last_error = TREE_GRAPH_ERROR;
     }
 
+    size_t true_size = 0;
+    for (size_t worker_i = 0; worker_i < TREE_PARALLEL_MAX_THREADS; worker_i++) {
+        true_size += check.counters[worker_i].edge_count;
+    }
+
     if (true_size != tree->size) {
         return tree->last_error = TREE_LOST_NODES;
     }
@@ -239,6 +253,10 @@ void TreeDump(Tree* tree, const char* file, int line) {
     assert(file != NULL);
     assert(line > 0);
 
+    TRACE_SCOPE("TreeDump", TRACE_WORK);
+
+    uint64_t start_ns = MetricsNow();
+
     FILE* build_dump_file = fopen(BUILD_DUMP_FILE_NAME, "w");
 
     if (build_dump_file == NULL) {
@@ -248,11 +266,13 @@ void TreeDump(Tree* tree, const char* file, int line) {
 
     fprintf(build_dump_file, "digraph G {\n    rankdir=TB;\n    node [shape=record];\n\n");
 
-    TreeNodesBuildDump(build_dump_file, tree->root);
+    TreeParallelVisitor nodes_visitor = {TreeNodeBuildDump, NULL, NULL};
+    TreeParallelWalk(tree->root, &nodes_visitor, build_dump_file);
 
     fprintf(build_dump_file, "\n");
 
-    TreeEdgesBuildDump(build_dump_file, tree->root);
+    TreeParallelVisitor edges_visitor = {TreeEdgeBuildDump, NULL, NULL};
+    TreeParallelWalk(tree->root, &edges_visitor, build_dump_file);
 
     fprintf(build_dump_file, "    node_%p [color = %s, penwidth = %lu]\n", tree->root, ROOT_NODE_COLOR, ROOT_NODE_PEN_WIDTH);
 
@@ -265,7 +285,7 @@ void TreeDump(Tree* tree, const char* file, int line) {
 
     snprintf(command, BUILD_DUMP_COMMAND_SIZE, "dot -Tsvg %s -o %s", BUILD_DUMP_FILE_NAME, DUMP_FILE_NAME);
 
-    system(command);
+    TRACE_CALL("dot", TRACE_PROCESS, system(command));
 
     FILE* dump_file = fopen(DUMP_FILE_NAME, "a");
 
@@ -279,50 +299,38 @@ void TreeDump(Tree* tree, const char* file, int line) {
     fprintf(dump_file, "<p style=\"font-size: %upx;\">\n    ERROR in %s:%d: %s</p>", DUMP_FONT_SIZE, file, line, TreeStrError(tree->last_error));
 
     fclose(dump_file);
+
+    MetricsRecord(METRICS_DUMP, MetricsNow() - start_ns);
 }
 
 TreeError TreeInit(Tree* tree) {
     assert(tree != NULL);
 
-    tree->root = TreeNodeInit(ROOT_VALUE);
-
-    tree->size = 0;
-
-    tree->last_error = TREE_OK;
-
-    return TREE_OK;
+    return TreeTInit(tree, TreeString());
 }
 
 TreeError TreeSubTreeDestroy(TreeNode** node) {
     assert(node != NULL);
 
-    TreeNode* loc_node = *node;
-
-    if (loc_node->left != NULL) {
-        TreeSubTreeDestroy(&loc_node->left);
-    }
-
-    if (loc_node->right != NULL) {
-        TreeSubTreeDestroy(&loc_node->right);
-    }
+    TreeParallelVisitor visitor = {TreeNodeDestroyVisit, NULL, NULL};
 
-    TreeNodeDestroy(&loc_node);
+    TreeError walk_err = TreeParallelWalk(*node, &visitor, NULL);
 
-    *node = loc_node;
+    *node = NULL;
 
-    return TREE_OK;
+    return walk_err;
 }
 
 TreeError TreeDestroy(Tree* tree) {
     assert(tree != NULL);
 
-    TreeSubTreeDestroy(&tree->root);
+    TreeError destroy_err = TreeSubTreeDestroy(&tree->root);
 
     tree->size = 0;
 
     tree->last_error = TREE_OK;
 
-    return TREE_OK;
+    return destroy_err;
 }
 
 TreeNode* TreeGetRoot(Tree* tree) {
@@ -0,0 +1,112 @@
+#include "tree_hash.hpp"
+
+#include <assert.h>
+
+#include "utils.hpp"
+
+static const uint64_t TREE_HASH_FNV_OFFSET = 0xCBF29CE484222325ull;
+static const uint64_t TREE_HASH_FNV_PRIME = 0x100000001B3ull;
+static const uint64_t TREE_HASH_LEFT_SEED = 0x9E3779B97F4A7C15ull;
+static const uint64_t TREE_HASH_RIGHT_SEED = 0xC2B2AE3D27D4EB4Full;
+
+/// Финальное перемешивание splitmix64
+static uint64_t TreeHashMix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+
+    return value;
+}
+
+static uint64_t TreeHashText(const TreeString* text) {
+    assert(text != NULL);
+
+    const unsigned char* bytes = (const unsigned char*)text->CStr();
+    size_t size = text->Size();
+
+    uint64_t hash = TREE_HASH_FNV_OFFSET;
+    for (size_t byte_i = 0; byte_i < size; byte_i++) {
+        hash ^= bytes[byte_i];
+        hash *= TREE_HASH_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+uint64_t TreeHashGet(TreeNode* node) {
+    return (node == NULL) ? TREE_HASH_NIL : node->hash;
+}
+
+uint64_t TreeHashNode(TreeNode* node) {
+    assert(node != NULL);
+
+    uint64_t hash = TreeHashMix(TreeHashText(&node->value));
+    hash = TreeHashMix(hash ^ TreeHashMix(TreeHashGet(node->left) + TREE_HASH_LEFT_SEED));
+    hash = TreeHashMix(hash ^ TreeHashMix(TreeHashGet(node->right) + TREE_HASH_RIGHT_SEED));
+
+    return hash;
+}
+
+TreeError TreeHashSubTree(TreeNode* node) {
+    if (node == NULL) {
+        return TREE_OK;
+    }
+
+    TreeNode** stack = (TreeNode**)calloc(TREE_HASH_START_STACK_CAPACITY, sizeof(TreeNode*));
+    if (stack == NULL) {
+        return TREE_NODE_ALLOC_ERROR;
+    }
+
+    size_t stack_size = 0;
+    size_t stack_capacity = TREE_HASH_START_STACK_CAPACITY;
+
+    TreeNode* last_done = NULL;
+    stack[stack_size++] = node;
+
+    while (stack_size > 0) {
+        TreeNode* top = stack[stack_size - 1];
+
+        bool is_right_done = (top->right == NULL || last_done == top->right);
+        bool is_left_done = (top->left == NULL || last_done == top->left || (top->right != NULL && is_right_done));
+
+        TreeNode* next = NULL;
+        if (!is_left_done) {
+            next = top->left;
+        }
+        else if (!is_right_done) {
+            next = top->right;
+        }
+
+        if (next == NULL) {
+            top->hash = TreeHashNode(top);
+            last_done = top;
+            stack_size--;
+            continue;
+        }
+
+        if (stack_size == stack_capacity) {
+            TreeNode** new_stack = (TreeNode**)realloc(stack, 2 * stack_capacity * sizeof(TreeNode*));
+            if (new_stack == NULL) {
+                PROTECTED_FREE(stack);
+                return TREE_NODE_ALLOC_ERROR;
+            }
+
+            stack = new_stack;
+            stack_capacity *= 2;
+        }
+
+        stack[stack_size++] = next;
+    }
+
+    PROTECTED_FREE(stack);
+
+    return TREE_OK;
+}
+
+void TreeHashUpdatePath(TreeNode* node) {
+    for (; node != NULL; node = node->parent) {
+        node->hash = TreeHashNode(node);
+    }
+}
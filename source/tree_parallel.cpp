@@ -0,0 +1,480 @@
+#include "tree_parallel.hpp"
+
+#include <assert.h>
+#include <stdarg.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#include "utils.hpp"
+
+/// Отложенный шаг обхода: вход в вершину или, если is_post, выход из нее
+struct TreeParallelEntry {
+    TreeNode* node;
+    size_t depth;
+
+    bool is_post;
+};
+
+/// Отданный на кражу шаг; children - задачи, отданные из него самого, в порядке отдачи
+struct TreeParallelJob {
+    TreeParallelTask task;
+
+    TreeParallelEntry entry;
+
+    TreeParallelJob** children;
+    size_t children_size;
+    size_t children_capacity;
+};
+
+/// Хозяин берет задачи с конца, воры - с начала, где лежат самые большие поддеревья
+struct TreeParallelDeque {
+    std::mutex mutex {};
+
+    TreeParallelJob** jobs = NULL;
+    size_t begin = 0;
+    size_t end = 0;
+    size_t capacity = 0;
+};
+
+struct TreeParallelWorker {
+    TreeParallelDeque deque {};
+
+    TreeParallelEntry* stack = NULL;
+    size_t stack_begin = 0;
+    size_t stack_end = 0;
+    size_t stack_capacity = 0;
+
+    size_t processed = 0;
+};
+
+struct TreeParallelState {
+    const TreeParallelVisitor* visitor;
+    bool is_ordered;
+
+    TreeParallelWorker* workers;
+    size_t worker_count;
+
+    std::thread* helpers;
+    bool is_spawned;
+
+    std::atomic<size_t> pending;
+    std::atomic<bool> is_failed;
+
+    std::mutex jobs_mutex;
+    TreeParallelJob** jobs;
+    size_t jobs_size;
+    size_t jobs_capacity;
+};
+
+static bool TreeParallelGrow(void** array, size_t* capacity, size_t elem_size) {
+    assert(array != NULL);
+    assert(capacity != NULL);
+
+    size_t new_capacity = (*capacity == 0) ? TREE_PARALLEL_START_CAPACITY : 2 * *capacity;
+
+    void* new_array = realloc(*array, new_capacity * elem_size);
+    if (new_array == NULL) {
+        return false;
+    }
+
+    *array = new_array;
+    *capacity = new_capacity;
+
+    return true;
+}
+
+size_t TreeParallelThreadCount() {
+    size_t thread_count = std::thread::hardware_concurrency();
+
+    if (thread_count == 0) {
+        return 1;
+    }
+
+    return (thread_count < TREE_PARALLEL_MAX_THREADS) ? thread_count : TREE_PARALLEL_MAX_THREADS;
+}
+
+TreeError TreeParallelPrintf(TreeParallelTask* task, const char* format, ...) {
+    assert(task != NULL);
+    assert(format != NULL);
+
+    va_list args;
+    va_start(args, format);
+
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    size_t free_size = task->output_capacity - task->output_size;
+    char* output_end = (task->output == NULL) ? NULL : task->output + task->output_size;
+    int printed = vsnprintf(output_end, free_size, format, args_copy);
+
+    va_end(args_copy);
+
+    if (printed < 0) {
+        va_end(args);
+        task->is_alloc_failed = true;
+        return TREE_NODE_ALLOC_ERROR;
+    }
+
+    if ((size_t)printed >= free_size) {
+        size_t new_capacity = (task->output_capacity == 0) ? TREE_PARALLEL_START_OUTPUT_CAPACITY : 2 * task->output_capacity;
+        while (new_capacity - task->output_size <= (size_t)printed) {
+            new_capacity *= 2;
+        }
+
+        char* new_output = (char*)realloc(task->output, new_capacity);
+        if (new_output == NULL) {
+            va_end(args);
+            task->is_alloc_failed = true;
+            return TREE_NODE_ALLOC_ERROR;
+        }
+
+        task->output = new_output;
+        task->output_capacity = new_capacity;
+
+        vsnprintf(task->output + task->output_size, new_capacity - task->output_size, format, args);
+    }
+
+    va_end(args);
+
+    task->output_size += (size_t)printed;
+
+    return TREE_OK;
+}
+
+static TreeParallelJob* TreeParallelJobCreate(TreeParallelState* state, TreeParallelEntry entry) {
+    assert(state != NULL);
+
+    TreeParallelJob* job = (TreeParallelJob*)calloc(1, sizeof(TreeParallelJob));
+    if (job == NULL) {
+        return NULL;
+    }
+
+    job->entry = entry;
+
+    std::lock_guard<std::mutex> lock(state->jobs_mutex);
+
+    if (state->jobs_size == state->jobs_capacity
+        && !TreeParallelGrow((void**)&state->jobs, &state->jobs_capacity, sizeof(TreeParallelJob*))) {
+        free(job);
+        return NULL;
+    }
+
+    state->jobs[state->jobs_size++] = job;
+
+    return job;
+}
+
+static bool TreeParallelDequePush(TreeParallelDeque* deque, TreeParallelJob* job) {
+    assert(deque != NULL);
+    assert(job != NULL);
+
+    std::lock_guard<std::mutex> lock(deque->mutex);
+
+    if (deque->end == deque->capacity) {
+        if (deque->begin > 0) {
+            memmove(deque->jobs, deque->jobs + deque->begin, (deque->end - deque->begin) * sizeof(TreeParallelJob*));
+            deque->end -= deque->begin;
+            deque->begin = 0;
+        }
+        else if (!TreeParallelGrow((void**)&deque->jobs, &deque->capacity, sizeof(TreeParallelJob*))) {
+            return false;
+        }
+    }
+
+    deque->jobs[deque->end++] = job;
+
+    return true;
+}
+
+static TreeParallelJob* TreeParallelDequePop(TreeParallelDeque* deque, bool is_steal) {
+    assert(deque != NULL);
+
+    std::lock_guard<std::mutex> lock(deque->mutex);
+
+    if (deque->begin == deque->end) {
+        return NULL;
+    }
+
+    TreeParallelJob* job = is_steal ? deque->jobs[deque->begin++] : deque->jobs[--deque->end];
+
+    if (deque->begin == deque->end) {
+        deque->begin = 0;
+        deque->end = 0;
+    }
+
+    return job;
+}
+
+static bool TreeParallelDequeIsEmpty(TreeParallelDeque* deque) {
+    assert(deque != NULL);
+
+    std::lock_guard<std::mutex> lock(deque->mutex);
+
+    return deque->begin == deque->end;
+}
+
+static bool TreeParallelStackPush(TreeParallelWorker* worker, TreeParallelEntry entry) {
+    assert(worker != NULL);
+
+    if (worker->stack_end == worker->stack_capacity) {
+        if (worker->stack_begin > 0) {
+            memmove(worker->stack, worker->stack + worker->stack_begin, (worker->stack_end - worker->stack_begin) * sizeof(TreeParallelEntry));
+            worker->stack_end -= worker->stack_begin;
+            worker->stack_begin = 0;
+        }
+        else if (!TreeParallelGrow((void**)&worker->stack, &worker->stack_capacity, sizeof(TreeParallelEntry))) {
+            return false;
+        }
+    }
+
+    worker->stack[worker->stack_end++] = entry;
+
+    return true;
+}
+
+/// Отдает на кражу самый нижний шаг стека: его вывод идет после всего, что останется в стеке
+static void TreeParallelPublish(TreeParallelState* state, TreeParallelWorker* worker, TreeParallelJob* job) {
+    assert(state != NULL);
+    assert(worker != NULL);
+    assert(job != NULL);
+
+    if (job->children_size == job->children_capacity
+        && !TreeParallelGrow((void**)&job->children, &job->children_capacity, sizeof(TreeParallelJob*))) {
+        return;
+    }
+
+    TreeParallelJob* new_job = TreeParallelJobCreate(state, worker->stack[worker->stack_begin]);
+    if (new_job == NULL) {
+        return;
+    }
+
+    state->pending++;
+
+    if (!TreeParallelDequePush(&worker->deque, new_job)) {
+        state->pending--;
+        return;
+    }
+
+    job->children[job->children_size++] = new_job;
+    worker->stack_begin++;
+}
+
+static void TreeParallelWorkerRun(TreeParallelState* state, size_t worker_i);
+
+static void TreeParallelSpawn(TreeParallelState* state) {
+    assert(state != NULL);
+
+    state->is_spawned = true;
+
+    if (state->worker_count == 1) {
+        return;
+    }
+
+    state->helpers = new (std::nothrow) std::thread[state->worker_count];
+    if (state->helpers == NULL) {
+        return;
+    }
+
+    for (size_t worker_i = 1; worker_i < state->worker_count; worker_i++) {
+        try {
+            state->helpers[worker_i] = std::thread(TreeParallelWorkerRun, state, worker_i);
+        }
+        catch (const std::system_error&) {
+            break;
+        }
+    }
+}
+
+static void TreeParallelJobRun(TreeParallelState* state, size_t worker_i, TreeParallelJob* job) {
+    assert(state != NULL);
+    assert(job != NULL);
+
+    const TreeParallelVisitor* visitor = state->visitor;
+    TreeParallelWorker* worker = &state->workers[worker_i];
+
+    job->task.worker_i = worker_i;
+
+    worker->stack_begin = 0;
+    worker->stack_end = 0;
+    TreeParallelStackPush(worker, job->entry);
+
+    while (worker->stack_begin < worker->stack_end) {
+        if (state->is_failed) {
+            return;
+        }
+
+        worker->processed++;
+
+        if (worker_i == 0 && !state->is_spawned && worker->processed >= TREE_PARALLEL_SPAWN_THRESHOLD) {
+            TreeParallelSpawn(state);
+        }
+
+        if (state->is_spawned && worker->processed % TREE_PARALLEL_CUTOFF == 0
+            && worker->stack_end - worker->stack_begin >= 2 && TreeParallelDequeIsEmpty(&worker->deque)) {
+            TreeParallelPublish(state, worker, job);
+        }
+
+        TreeParallelEntry entry = worker->stack[--worker->stack_end];
+
+        if (entry.is_post) {
+            visitor->post(entry.node, entry.depth, &job->task, visitor->context);
+            continue;
+        }
+
+        TreeNode* left = entry.node->left;
+        TreeNode* right = entry.node->right;
+
+        bool is_pushed = (visitor->post == NULL || TreeParallelStackPush(worker, {entry.node, entry.depth, true}))
+                         && (right == NULL || TreeParallelStackPush(worker, {right, entry.depth + 1, false}))
+                         && (left == NULL || TreeParallelStackPush(worker, {left, entry.depth + 1, false}));
+
+        if (!is_pushed) {
+            state->is_failed = true;
+            return;
+        }
+
+        visitor->pre(entry.node, entry.depth, &job->task, visitor->context);
+    }
+}
+
+static void TreeParallelWorkerRun(TreeParallelState* state, size_t worker_i) {
+    assert(state != NULL);
+
+    while (true) {
+        TreeParallelJob* job = TreeParallelDequePop(&state->workers[worker_i].deque, false);
+
+        for (size_t victim_i = 1; job == NULL && victim_i < state->worker_count; victim_i++) {
+            job = TreeParallelDequePop(&state->workers[(worker_i + victim_i) % state->worker_count].deque, true);
+        }
+
+        if (job != NULL) {
+            TreeParallelJobRun(state, worker_i, job);
+            state->pending--;
+        }
+        else if (state->pending == 0) {
+            return;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/// Склеивает вывод: сначала собственный вывод задачи, затем отданные из нее задачи в обратном порядке отдачи
+static TreeError TreeParallelMerge(TreeParallelJob* root_job, FILE* output) {
+    assert(root_job != NULL);
+    assert(output != NULL);
+
+    TreeParallelJob** stack = NULL;
+    size_t stack_size = 0;
+    size_t stack_capacity = 0;
+
+    if (!TreeParallelGrow((void**)&stack, &stack_capacity, sizeof(TreeParallelJob*))) {
+        return TREE_NODE_ALLOC_ERROR;
+    }
+
+    stack[stack_size++] = root_job;
+
+    while (stack_size > 0) {
+        TreeParallelJob* job = stack[--stack_size];
+
+        if (job->task.is_alloc_failed) {
+            PROTECTED_FREE(stack);
+            return TREE_NODE_ALLOC_ERROR;
+        }
+
+        if (job->task.output_size > 0) {
+            fwrite(job->task.output, 1, job->task.output_size, output);
+        }
+
+        for (size_t child_i = 0; child_i < job->children_size; child_i++) {
+            if (stack_size == stack_capacity
+                && !TreeParallelGrow((void**)&stack, &stack_capacity, sizeof(TreeParallelJob*))) {
+                PROTECTED_FREE(stack);
+                return TREE_NODE_ALLOC_ERROR;
+            }
+
+            stack[stack_size++] = job->children[child_i];
+        }
+    }
+
+    PROTECTED_FREE(stack);
+
+    return TREE_OK;
+}
+
+static void TreeParallelStateDestroy(TreeParallelState* state) {
+    assert(state != NULL);
+
+    for (size_t job_i = 0; job_i < state->jobs_size; job_i++) {
+        PROTECTED_FREE(state->jobs[job_i]->task.output);
+        PROTECTED_FREE(state->jobs[job_i]->children);
+        PROTECTED_FREE(state->jobs[job_i]);
+    }
+    PROTECTED_FREE(state->jobs);
+
+    for (size_t worker_i = 0; worker_i < state->worker_count; worker_i++) {
+        PROTECTED_FREE(state->workers[worker_i].deque.jobs);
+        PROTECTED_FREE(state->workers[worker_i].stack);
+    }
+
+    delete[] state->workers;
+    state->workers = NULL;
+
+    delete[] state->helpers;
+    state->helpers = NULL;
+}
+
+TreeError TreeParallelWalk(TreeNode* root, const TreeParallelVisitor* visitor, FILE* output) {
+    assert(visitor != NULL);
+    assert(visitor->pre != NULL);
+
+    if (root == NULL) {
+        return TREE_OK;
+    }
+
+    TreeParallelState state = {};
+    state.visitor = visitor;
+    state.is_ordered = (output != NULL);
+    state.worker_count = TreeParallelThreadCount();
+    state.pending = 1;
+    state.is_failed = false;
+
+    state.workers = new (std::nothrow) TreeParallelWorker[state.worker_count]();
+    if (state.workers == NULL) {
+        return TREE_NODE_ALLOC_ERROR;
+    }
+
+    TreeParallelJob* root_job = TreeParallelJobCreate(&state, {root, 0, false});
+    if (root_job == NULL) {
+        TreeParallelStateDestroy(&state);
+        return TREE_NODE_ALLOC_ERROR;
+    }
+
+    TreeParallelJobRun(&state, 0, root_job);
+    state.pending--;
+
+    TreeParallelWorkerRun(&state, 0);
+
+    if (state.helpers != NULL) {
+        for (size_t worker_i = 1; worker_i < state.worker_count; worker_i++) {
+            if (state.helpers[worker_i].joinable()) {
+                state.helpers[worker_i].join();
+            }
+        }
+    }
+
+    TreeError walk_err = state.is_failed ? TREE_NODE_ALLOC_ERROR : TREE_OK;
+
+    if (walk_err == TREE_OK && state.is_ordered) {
+        walk_err = TreeParallelMerge(root_job, output);
+    }
+
+    TreeParallelStateDestroy(&state);
+
+    return walk_err;
+}
@@ -0,0 +1,90 @@
+#include "tree_string.hpp"
+
+#include <string.h>
+
+TreeString::TreeString(const char* str) : TreeString() {
+    if (str != NULL) {
+        Assign(str, strlen(str));
+    }
+}
+
+TreeString::TreeString(const char* str, size_t size) : TreeString() {
+    Assign(str, size);
+}
+
+TreeString::TreeString(TreeString&& other) noexcept : size_(other.size_), inline_() {
+    if (other.IsInline()) {
+        memcpy(inline_, other.inline_, size_ + 1);
+    }
+    else if (other.IsBorrowed()) {
+        borrowed_ = other.borrowed_;
+    }
+    else {
+        heap_ = other.heap_;
+    }
+
+    other.size_ = 0;
+    other.inline_[0] = '\0';
+}
+
+TreeString& TreeString::operator=(TreeString&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (IsHeap()) {
+        free(heap_);
+    }
+
+    size_ = other.size_;
+    if (other.IsInline()) {
+        memcpy(inline_, other.inline_, size_ + 1);
+    }
+    else if (other.IsBorrowed()) {
+        borrowed_ = other.borrowed_;
+    }
+    else {
+        heap_ = other.heap_;
+    }
+
+    other.size_ = 0;
+    other.inline_[0] = '\0';
+
+    return *this;
+}
+
+TreeString::~TreeString() {
+    if (IsHeap()) {
+        free(heap_);
+    }
+}
+
+bool TreeString::Assign(const char* str, size_t size) {
+    if (size <= INLINE_CAPACITY) {
+        char* old_heap = IsHeap() ? heap_ : NULL;
+
+        memmove(inline_, str, size);
+        inline_[size] = '\0';
+
+        free(old_heap);
+    }
+    else {
+        char* new_heap = (char*)malloc(size + 1);
+        if (new_heap == NULL) {
+            return false;
+        }
+
+        memcpy(new_heap, str, size);
+        new_heap[size] = '\0';
+
+        if (IsHeap()) {
+            free(heap_);
+        }
+
+        heap_ = new_heap;
+    }
+
+    size_ = size;
+
+    return true;
+}